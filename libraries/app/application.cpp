@@ -530,6 +530,66 @@ void application_impl::open_chain_database() const
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   if( _options->count("enable-parallel-transaction-checks") > 0 )
+      _chain_db->enable_parallel_transaction_checks(
+            _options->at("enable-parallel-transaction-checks").as<bool>() );
+
+   if( _options->count("enable-parallel-vote-tally") > 0 )
+      _chain_db->enable_parallel_vote_tally( _options->at("enable-parallel-vote-tally").as<bool>() );
+
+   if( _options->count("authority-cache-size") > 0 )
+      _chain_db->set_authority_cache_size( _options->at("authority-cache-size").as<uint32_t>() );
+
+   if( _options->count("mempool-max-size") > 0 || _options->count("mempool-max-per-account") > 0 )
+   {
+      const uint64_t max_mib = _options->count("mempool-max-size") > 0
+                               ? _options->at("mempool-max-size").as<uint64_t>() : 0;
+      const uint32_t max_per_account = _options->count("mempool-max-per-account") > 0
+                                       ? _options->at("mempool-max-per-account").as<uint32_t>() : 0;
+      _chain_db->set_mempool_limits( max_mib * 1024 * 1024, max_per_account );
+   }
+
+   if( _options->count("pending-reapply-limit") > 0 )
+      _chain_db->set_pending_reapply_limit( _options->at("pending-reapply-limit").as<uint32_t>() );
+
+   if( _options->count("block-cache-size") > 0 )
+      _chain_db->set_block_cache_size( _options->at("block-cache-size").as<uint32_t>() );
+
+   if( _options->count("block-trace-size") > 0 || _options->count("slow-block-threshold") > 0 )
+   {
+      const uint32_t trace_size = _options->count("block-trace-size") > 0
+                                  ? _options->at("block-trace-size").as<uint32_t>()
+                                  : chain::block_tracer::default_capacity;
+      const uint32_t slow_block_ms = _options->count("slow-block-threshold") > 0
+                                     ? _options->at("slow-block-threshold").as<uint32_t>()
+                                     : chain::block_tracer::default_slow_block_ms;
+      _chain_db->set_block_trace_options( trace_size, slow_block_ms );
+   }
+
+   if( _options->count("replay-queue-depth") > 0 || _options->count("replay-decode-threads") > 0 )
+   {
+      const uint32_t queue_depth = _options->count("replay-queue-depth") > 0
+                                   ? _options->at("replay-queue-depth").as<uint32_t>()
+                                   : chain::block_replay_pipeline::default_queue_depth;
+      const uint32_t decode_threads = _options->count("replay-decode-threads") > 0
+                                      ? _options->at("replay-decode-threads").as<uint32_t>() : 0;
+      _chain_db->set_replay_pipeline( queue_depth, decode_threads );
+   }
+
+   if( _options->count("replay-trust-checkpoints") > 0 )
+      _chain_db->set_trusted_replay( _options->at("replay-trust-checkpoints").as<bool>() );
+
+   if( _options->count("block-log-keep-blocks") > 0 || _options->count("block-log-keep-days") > 0 )
+   {
+      uint32_t keep_blocks = 0;
+      uint32_t keep_days = 0;
+      if( _options->count("block-log-keep-blocks") > 0 )
+         keep_blocks = _options->at("block-log-keep-blocks").as<uint32_t>();
+      if( _options->count("block-log-keep-days") > 0 )
+         keep_days = _options->at("block-log-keep-days").as<uint32_t>();
+      _chain_db->set_block_log_pruning( keep_blocks, keep_days );
+   }
+
    if( _options->count("replay-blockchain") > 0 || _options->count("revalidate-blockchain") > 0 )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
@@ -670,6 +730,11 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
          return _chain_db->push_block( blk_msg.block, skip );
       });
 
+      if( _chain_db->get_mempool_stats().deferred > 0
+            && !( _deferred_reapply_done.valid() && !_deferred_reapply_done.ready() ) )
+         _deferred_reapply_done = fc::async( [this] () { reapply_deferred_transactions(); },
+                                             "reapply_deferred_transactions" );
+
       // the block was accepted, so we now know all of the transactions contained in the block
       if (!sync_mode)
       {
@@ -722,6 +787,14 @@ void application_impl::handle_transaction(const graphene::net::trx_message& tran
    _chain_db->push_transaction( transaction_message.trx );
 } FC_CAPTURE_AND_RETHROW( (transaction_message) ) } // GCOVR_EXCL_LINE
 
+void application_impl::reapply_deferred_transactions()
+{
+   // a batch at a time, so that blocks and transactions received in between are not held up
+   const size_t batch_size = std::max<uint32_t>( _chain_db->get_pending_reapply_limit() / 4, 100 );
+   while( _chain_db->reapply_deferred_transactions( batch_size ) > 0 )
+      fc::yield();
+}
+
 void application_impl::handle_message(const message& message_to_process)
 {
    // not a transaction, not a block
@@ -780,6 +853,13 @@ std::vector<item_hash_t> application_impl::get_block_ids(const std::vector<item_
        FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
                            "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis" );
    }
+   // a pruned block log can not provide blocks the peer is missing
+   const uint32_t first_retained = _chain_db->first_retained_block_num();
+   if( block_header::num_from_id(last_known_block_id) + 1 < first_retained )
+      FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
+                          "Unable to provide blocks before ${first}, the block log has been pruned",
+                          ("first", first_retained) );
+
    for( uint32_t num = block_header::num_from_id(last_known_block_id);
         num <= _chain_db->head_block_num() && result.size() < limit;
         ++num )
@@ -800,13 +880,13 @@ message application_impl::get_item(const item_id& id)
   // ilog("Request for item ${id}", ("id", id));
    if( id.item_type == graphene::net::block_message_type )
    {
-      auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
+      auto opt_block = _chain_db->fetch_shared_block_by_id(id.item_hash);
       if( !opt_block )
          elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
               ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-      FC_ASSERT( opt_block.valid() );
+      FC_ASSERT( opt_block );
       // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-      return block_message(std::move(*opt_block));
+      return block_message(*opt_block);
    }
    return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
 } FC_CAPTURE_AND_RETHROW( (id) ) } // GCOVR_EXCL_LINE
@@ -1025,8 +1105,8 @@ uint32_t application_impl::get_block_number(const item_hash_t& block_id)
  */
 fc::time_point_sec application_impl::get_block_time(const item_hash_t& block_id)
 { try {
-   auto opt_block = _chain_db->fetch_block_by_id( block_id );
-   if( opt_block.valid() ) return opt_block->timestamp;
+   auto opt_block = _chain_db->fetch_shared_block_by_id( block_id );
+   if( opt_block ) return opt_block->timestamp;
    return fc::time_point_sec::min();
 } FC_CAPTURE_AND_RETHROW( (block_id) ) } // GCOVR_EXCL_LINE
 
@@ -1051,6 +1131,12 @@ uint8_t application_impl::get_current_block_interval_in_seconds() const
    return _chain_db->get_global_properties().parameters.block_interval;
 }
 
+uint32_t application_impl::get_first_retained_block_number() const
+{
+   FC_ASSERT( _chain_db, "Chain database is not operational" );
+   return _chain_db->first_retained_block_num();
+}
+
 void application_impl::shutdown()
 {
    ilog( "Shutting down application" );
@@ -1060,6 +1146,12 @@ void application_impl::shutdown()
       _websocket_server.reset();
    // TODO wait until all connections are closed and messages handled?
 
+   if( _deferred_reapply_done.valid() && !_deferred_reapply_done.ready() )
+   {
+      ilog( "Stopping to apply deferred pending transactions" );
+      _deferred_reapply_done.cancel_and_wait( "application shutdown" );
+   }
+
    // plugins E.G. witness_plugin may send data to p2p network, so shutdown them first
    ilog( "Shutting down plugins" );
    shutdown_plugins();
@@ -1202,6 +1294,49 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("enable-parallel-transaction-checks", bpo::value<bool>()->implicit_value(true),
+          "Whether to validate transactions of received blocks and verify their authorities in parallel, "
+          "in runs that end at transactions which change authorities. The resulting state is unchanged.")
+         ("enable-parallel-vote-tally", bpo::value<bool>()->implicit_value(true),
+          "Whether to tally the votes of all accounts in parallel during chain maintenance. "
+          "The resulting state is unchanged.")
+         ("authority-cache-size",
+          bpo::value<uint32_t>()->default_value(chain::authority_cache::default_capacity),
+          "Maximum number of transactions whose verified authorities are remembered, so that they are not verified "
+          "again when included in a block, 0 to disable the cache")
+         ("mempool-max-size", bpo::value<uint64_t>()->default_value(0),
+          "Maximum total size of pending transactions in MiB. When it is reached, transactions paying the lowest "
+          "fees per byte are evicted in favor of new ones paying more. 0 (the default) means unlimited")
+         ("mempool-max-per-account", bpo::value<uint32_t>()->default_value(0),
+          "Maximum number of pending transactions whose first operation is paid by the same account, 0 (the "
+          "default) means unlimited")
+         ("pending-reapply-limit", bpo::value<uint32_t>()->default_value(0),
+          "Maximum number of pending transactions applied again right after a block is pushed, before the block is "
+          "relayed. The others are applied in the background and are not included in blocks produced meanwhile. "
+          "0 (the default) means unlimited")
+         ("block-cache-size", bpo::value<uint32_t>()->default_value(chain::block_cache::default_capacity),
+          "Maximum number of recently stored or fetched blocks to keep decoded in memory, 0 to disable the cache")
+         ("block-trace-size", bpo::value<uint32_t>()->default_value(chain::block_tracer::default_capacity),
+          "Number of recently applied blocks whose timing breakdown is kept for the get_block_traces API, "
+          "0 to disable block tracing")
+         ("slow-block-threshold", bpo::value<uint32_t>()->default_value(chain::block_tracer::default_slow_block_ms),
+          "Log the timing breakdown of blocks taking at least this many milliseconds to apply, 0 to disable")
+         ("replay-queue-depth",
+          bpo::value<uint32_t>()->default_value(chain::block_replay_pipeline::default_queue_depth),
+          "Maximum number of blocks read and decoded ahead of the block being applied while replaying the chain")
+         ("replay-decode-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads decoding blocks and recovering their signing keys while replaying the chain, "
+          "0 for one per hardware thread")
+         ("replay-trust-checkpoints", bpo::value<bool>()->implicit_value(true),
+          "Whether to trust the last checkpoint when replaying the chain: the blocks up to it are only checked to "
+          "link to each other and to match their merkle roots, their signatures are not recovered. Off by default")
+         ("block-log-keep-blocks", bpo::value<uint32_t>(),
+          "Prune the block log, keeping the contents of this many most recent blocks. "
+          "IDs of pruned blocks are kept. A pruned node can not replay and does not serve old blocks to peers. "
+          "Blocks within the maximum transaction expiration time are always kept")
+         ("block-log-keep-days", bpo::value<uint32_t>(),
+          "Prune the block log, keeping the contents of blocks of this many most recent days. "
+          "If both block-log-keep-blocks and block-log-keep-days are set, the larger range is kept")
          ("api-limit-get-account-history-operations",
           bpo::value<uint32_t>()->default_value(default_opts.api_limit_get_account_history_operations),
           "For history_api::get_account_history_operations to set max limit value")
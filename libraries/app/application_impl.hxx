@@ -185,6 +185,8 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
 
       uint8_t get_current_block_interval_in_seconds() const override;
 
+      uint32_t get_first_retained_block_number() const override;
+
       /// Add an available plugin
       void add_available_plugin( std::shared_ptr<abstract_plugin> p );
 
@@ -201,6 +203,9 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
       void startup_plugins() const;
       void shutdown_plugins() const;
 
+      /// Applies pending transactions that were deferred after a block again, yielding between batches
+      void reapply_deferred_transactions();
+
       /// Initialize genesis state. Called by open_chain_database().
       graphene::chain::genesis_state_type initialize_genesis_state() const;
       /// Open the chain database. Called by @ref startup.
@@ -228,6 +233,9 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
       string _node_info;
 
       fc::serial_valve valve;
+
+      /// Completes when the deferred pending transactions have been applied again
+      fc::future<void> _deferred_reapply_done;
    };
 
 }}} // namespace graphene namespace app namespace detail
@@ -69,20 +69,24 @@ database_api_impl::database_api_impl( graphene::chain::database& db, const appli
 :database_api_helper( db, app_options )
 {
    dlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids,
-                                                    const flat_set<account_id_type>& impacted_accounts) {
+   _new_connection = _db.new_objects.connect( _db.traced_handler( "database_api",
+                             [this](const vector<object_id_type>& ids,
+                                    const flat_set<account_id_type>& impacted_accounts) {
                                 on_objects_new(ids, impacted_accounts);
-                                });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids,
-                                                           const flat_set<account_id_type>& impacted_accounts) {
+                                }) );
+   _change_connection = _db.changed_objects.connect( _db.traced_handler( "database_api",
+                             [this](const vector<object_id_type>& ids,
+                                    const flat_set<account_id_type>& impacted_accounts) {
                                 on_objects_changed(ids, impacted_accounts);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids,
-                                                            const vector<const object*>& objs,
-                                                            const flat_set<account_id_type>& impacted_accounts) {
+                                }) );
+   _removed_connection = _db.removed_objects.connect( _db.traced_handler( "database_api",
+                             [this](const vector<object_id_type>& ids,
+                                    const vector<const object*>& objs,
+                                    const flat_set<account_id_type>& impacted_accounts) {
                                 on_objects_removed(ids, objs, impacted_accounts);
-                                });
-   _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
+                                }) );
+   _applied_block_connection = _db.applied_block.connect( _db.traced_handler( "database_api",
+                                  [this](const signed_block&){ on_applied_block(); } ) );
 
    _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
                                 if( _pending_trx_callback )
@@ -237,7 +241,7 @@ optional<maybe_signed_block_header> database_api::get_block_header(
 optional<maybe_signed_block_header> database_api_impl::get_block_header(
             uint32_t block_num, bool with_witness_signature )const
 {
-   auto result = _db.fetch_block_by_number(block_num);
+   auto result = _db.fetch_shared_block_by_number(block_num);
    if(result)
       return maybe_signed_block_header( *result, with_witness_signature );
    return {};
@@ -285,9 +289,34 @@ optional<signed_transaction> database_api::get_recent_transaction_by_id( const t
    }
 }
 
+block_cache_stats database_api::get_block_cache_stats()const
+{
+   return my->_db.get_block_cache_stats();
+}
+
+mempool_stats database_api::get_mempool_stats()const
+{
+   return my->_db.get_mempool_stats();
+}
+
+authority_cache_stats database_api::get_authority_cache_stats()const
+{
+   return my->_db.get_authority_cache_stats();
+}
+
+vector<block_trace> database_api::get_block_traces( uint32_t limit )const
+{
+   return my->_db.get_block_traces( limit );
+}
+
+margin_call_stats database_api::get_margin_call_stats()const
+{
+   return my->_db.get_margin_call_stats();
+}
+
 processed_transaction database_api_impl::get_transaction(uint32_t block_num, uint32_t trx_num)const
 {
-   auto opt_block = _db.fetch_block_by_number(block_num);
+   auto opt_block = _db.fetch_shared_block_by_number(block_num);
    FC_ASSERT( opt_block );
    FC_ASSERT( opt_block->transactions.size() > trx_num );
    return opt_block->transactions[trx_num];
@@ -2621,8 +2650,8 @@ vector<limit_order_object> database_api_impl::get_limit_orders( const asset_id_t
               "limit can not be greater than ${configured_limit}",
               ("configured_limit", configured_limit) );
 
-   const auto& limit_order_idx = _db.get_index_type<limit_order_index>();
-   const auto& limit_price_idx = limit_order_idx.indices().get<by_price>();
+   const auto& limit_price_idx = _db.get_index_type< primary_index< limit_order_index > >()
+                                    .get_secondary_index<limit_order_book_index>();
 
    vector<limit_order_object> result;
    result.reserve(limit*2);
@@ -194,6 +194,43 @@ class database_api
        */
       optional<signed_transaction> get_recent_transaction_by_id( const transaction_id_type& txid )const;
 
+      /**
+       * @brief Get statistics of the in-memory cache of decoded blocks
+       * @return hit and miss counters since startup, current number of cached blocks and the configured capacity
+       */
+      block_cache_stats get_block_cache_stats()const;
+
+      /**
+       * @brief Get statistics of the pending transactions of the node
+       * @return the number and size of pending transactions, their range of fees per kilobyte, the configured
+       *         limits and counters of accepted, rejected, evicted and expired transactions since startup
+       */
+      mempool_stats get_mempool_stats()const;
+
+      /**
+       * @brief Get statistics of the cache of transactions whose authorities have been verified
+       * @return the number of lookups that skipped the verification, that verified again because an authority
+       *         changed and that missed since startup, the current number of cached transactions and the capacity
+       */
+      authority_cache_stats get_authority_cache_stats()const;
+
+      /**
+       * @brief Get the timing breakdown of recently applied blocks
+       * @param limit maximum number of blocks to return, at most the number of traces kept by the node, which is
+       *        configured with the block-trace-size option
+       * @return the traces of the most recently applied blocks, the most recent first, with the time spent in
+       *         each phase of applying them, in each type of operation and in each plugin, and their undo sizes
+       */
+      vector<block_trace> get_block_traces( uint32_t limit )const;
+
+      /**
+       * @brief Get statistics of the checks for margin calls
+       * @return the number of checks of the call orders of market issued assets since startup, how many of them
+       *         were skipped because nothing changed in the market since a check found no margin call, and the
+       *         number of markets currently known to need no margin call
+       */
+      margin_call_stats get_margin_call_stats()const;
+
       /////////////
       // Globals //
       /////////////
@@ -990,6 +1027,11 @@ FC_API(graphene::app::database_api,
    (get_block)
    (get_transaction)
    (get_recent_transaction_by_id)
+   (get_block_cache_stats)
+   (get_mempool_stats)
+   (get_authority_cache_stats)
+   (get_block_traces)
+   (get_margin_call_stats)
 
    // Globals
    (get_chain_properties)
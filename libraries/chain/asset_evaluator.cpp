@@ -988,7 +988,7 @@ void_result asset_publish_feeds_evaluator::do_apply(const asset_publish_feed_ope
    auto old_feed =  bad.current_feed;
    // Store medians for this asset
    d.modify( bad , [&o,head_time,next_maint_time](asset_bitasset_data_object& a) {
-      a.feeds[o.publisher] = make_pair( head_time, o.feed );
+      a.set_feed( o.publisher, head_time, o.feed );
       a.update_median_feeds( head_time, next_maint_time );
    });
 
@@ -44,25 +44,56 @@ share_type asset_bitasset_data_object::max_force_settlement_volume(share_type cu
    return static_cast<uint64_t>(volume);
 }
 
-void graphene::chain::asset_bitasset_data_object::update_median_feeds( time_point_sec current_time,
-                                                                       time_point_sec next_maintenance_time )
+namespace {
+
+/// Selects the median of each field among the feeds that are alive at @p current_time
+price_feed select_median_feed( const asset_bitasset_data_object& o, time_point_sec current_time )
 {
-   bool after_core_hardfork_1270 = ( next_maintenance_time > HARDFORK_CORE_1270_TIME ); // call price caching issue
-   current_feed_publication_time = current_time;
    vector<std::reference_wrapper<const price_feed>> current_feeds;
    // find feeds that were alive at current_time
-   for( const pair<account_id_type, pair<time_point_sec,price_feed>>& f : feeds )
+   for( const pair<account_id_type, pair<time_point_sec,price_feed>>& f : o.feeds )
    {
-      if( (current_time - f.second.first).to_seconds() < options.feed_lifetime_sec &&
+      if( (current_time - f.second.first).to_seconds() < o.options.feed_lifetime_sec &&
           f.second.first != time_point_sec() )
       {
          current_feeds.emplace_back(f.second.second);
-         current_feed_publication_time = std::min(current_feed_publication_time, f.second.first);
       }
    }
 
+   price_feed median_feed;
+   const auto median_itr = current_feeds.begin() + current_feeds.size() / 2;
+#define CALCULATE_MEDIAN_VALUE(r, data, field_name) \
+   std::nth_element( current_feeds.begin(), median_itr, current_feeds.end(), \
+                     [](const price_feed& a, const price_feed& b) { \
+      return a.field_name < b.field_name; \
+   }); \
+   median_feed.field_name = median_itr->get().field_name;
+
+   BOOST_PP_SEQ_FOR_EACH( CALCULATE_MEDIAN_VALUE, ~, GRAPHENE_PRICE_FEED_FIELDS )
+#undef CALCULATE_MEDIAN_VALUE
+   return median_feed;
+}
+
+}
+
+void graphene::chain::asset_bitasset_data_object::update_median_feeds( time_point_sec current_time,
+                                                                       time_point_sec next_maintenance_time )
+{
+   bool after_core_hardfork_1270 = ( next_maintenance_time > HARDFORK_CORE_1270_TIME ); // call price caching issue
+   // track the feeds that are alive at current_time, a tracker that another copy changed is left to that copy
+   const bool tracked = tracks_median_feeds();
+   if( !tracked && ( !_median_feeds || _median_feeds.use_count() > 1 ) )
+      _median_feeds = std::make_shared<median_feed_tracker>();
+   median_feed_tracker& tracker = *_median_feeds;
+   // feeds that were changed other than by set_feed are not the tracked ones
+   if( tracked && tracker.is_valid_for( current_time, options.feed_lifetime_sec ) && tracker.matches( feeds ) )
+      tracker.expire( current_time );
+   else
+      tracker.rebuild( feeds, current_time, options.feed_lifetime_sec );
+   _median_feeds_stamp = tracker.restamp();
+
    // If there are no valid feeds, or the number available is less than the minimum to calculate a median...
-   if( current_feeds.size() < options.minimum_feeds )
+   if( tracker.size() < options.minimum_feeds )
    {
       //... don't calculate a median, and set a null feed
       feed_cer_updated = false; // new median cer is null, won't update asset_object anyway, set to false for better performance
@@ -70,13 +101,21 @@ void graphene::chain::asset_bitasset_data_object::update_median_feeds( time_poin
       current_feed = price_feed();
       if( after_core_hardfork_1270 )
          current_maintenance_collateralization = price();
+      tracker.set_median_current( false );
       return;
    }
-   if( current_feeds.size() == 1 )
+   current_feed_publication_time = std::min( current_time, tracker.oldest_publication_time() );
+   // current_feed was selected from the same values, e.g. when a feed is republished unchanged,
+   // current_maintenance_collateralization is calculated since hard fork core-1270, even if the median is kept
+   if( tracker.is_median_current()
+         && ( !after_core_hardfork_1270 || !current_maintenance_collateralization.is_null() ) )
+      return;
+   tracker.set_median_current( true );
+   if( tracker.size() == 1 )
    {
-      if( current_feed.core_exchange_rate != current_feeds.front().get().core_exchange_rate )
+      if( current_feed.core_exchange_rate != tracker.only_feed().core_exchange_rate )
          feed_cer_updated = true;
-      current_feed = current_feeds.front();
+      current_feed = tracker.only_feed();
       // Note: perhaps can defer updating current_maintenance_collateralization for better performance
       if( after_core_hardfork_1270 )
          current_maintenance_collateralization = current_feed.maintenance_collateralization();
@@ -85,16 +124,9 @@ void graphene::chain::asset_bitasset_data_object::update_median_feeds( time_poin
 
    // *** Begin Median Calculations ***
    price_feed median_feed;
-   const auto median_itr = current_feeds.begin() + current_feeds.size() / 2;
-#define CALCULATE_MEDIAN_VALUE(r, data, field_name) \
-   std::nth_element( current_feeds.begin(), median_itr, current_feeds.end(), \
-                     [](const price_feed& a, const price_feed& b) { \
-      return a.field_name < b.field_name; \
-   }); \
-   median_feed.field_name = median_itr->get().field_name;
-
-   BOOST_PP_SEQ_FOR_EACH( CALCULATE_MEDIAN_VALUE, ~, GRAPHENE_PRICE_FEED_FIELDS )
-#undef CALCULATE_MEDIAN_VALUE
+   // equivalent prices with different amounts can be the median, select it the same way as before
+   if( !tracker.get_median( median_feed ) )
+      median_feed = select_median_feed( *this, current_time );
    // *** End Median Calculations ***
 
    if( current_feed.core_exchange_rate != median_feed.core_exchange_rate )
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/authority_cache.hpp>
+
+namespace graphene { namespace chain {
+
+void account_authority_version_index::object_removed( const object& obj )
+{
+   changed( account_id_type( obj.id ) );
+}
+
+void account_authority_version_index::about_to_modify( const object& before )
+{
+   const account_object& a = static_cast<const account_object&>(before);
+   _before_owner = a.owner;
+   _before_active = a.active;
+}
+
+void account_authority_version_index::object_modified( const object& after )
+{
+   const account_object& a = static_cast<const account_object&>(after);
+   if( !( a.owner == _before_owner ) || !( a.active == _before_active ) )
+      changed( a.get_id() );
+}
+
+void account_authority_version_index::changed( account_id_type account )
+{
+   _last_change[ account.instance.value ] = ++_version;
+}
+
+bool account_authority_version_index::unchanged_since( const flat_set<account_id_type>& accounts,
+                                                       uint64_t version )const
+{
+   if( _version == version )
+      return true;
+   for( const account_id_type& account : accounts )
+   {
+      auto itr = _last_change.find( account.instance.value );
+      if( itr != _last_change.end() && itr->second > version )
+         return false;
+   }
+   return true;
+}
+
+constexpr uint32_t authority_cache::default_capacity;
+
+authority_cache::lookup_result authority_cache::find( const signed_transaction& trx, bool allow_non_immediate_owner,
+                                                      uint32_t max_recursion,
+                                                      const account_authority_version_index& versions )
+{
+   lookup_result result;
+   const transaction_id_type& id = trx.id();
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _entries.find( id );
+   if( itr == _entries.end() || itr->second.signatures != trx.signatures )
+   {
+      ++_stats.misses;
+      return result;
+   }
+   const entry& e = itr->second;
+   result.verified = e.allow_non_immediate_owner == allow_non_immediate_owner
+                     && e.max_recursion == max_recursion
+                     && versions.unchanged_since( e.accounts, e.version );
+   if( result.verified )
+      ++_stats.hits;
+   else
+   {
+      ++_stats.stale_hits;
+      result.keys = e.keys;
+   }
+   return result;
+}
+
+bool authority_cache::contains( const signed_transaction& trx )const
+{
+   const transaction_id_type& id = trx.id();
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _entries.find( id );
+   return itr != _entries.end() && itr->second.signatures == trx.signatures;
+}
+
+void authority_cache::insert( const signed_transaction& trx, const flat_set<public_key_type>& keys,
+                              flat_set<account_id_type>&& accounts, uint64_t version,
+                              bool allow_non_immediate_owner, uint32_t max_recursion )
+{
+   const transaction_id_type& id = trx.id();
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _capacity == 0 )
+      return;
+   auto itr = _entries.find( id );
+   if( itr == _entries.end() )
+   {
+      itr = _entries.emplace( id, entry() ).first;
+      _order.push_back( id );
+   }
+   entry& e = itr->second;
+   e.signatures = trx.signatures;
+   e.keys = keys;
+   e.accounts = std::move( accounts );
+   e.version = version;
+   e.allow_non_immediate_owner = allow_non_immediate_owner;
+   e.max_recursion = max_recursion;
+   evict();
+}
+
+void authority_cache::clear()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _entries.clear();
+   _order.clear();
+}
+
+void authority_cache::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _capacity = capacity;
+   evict();
+}
+
+authority_cache_stats authority_cache::get_stats()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   authority_cache_stats result = _stats;
+   result.size = _entries.size();
+   result.capacity = _capacity;
+   return result;
+}
+
+void authority_cache::evict()
+{
+   while( _order.size() > _capacity )
+   {
+      _entries.erase( _order.front() );
+      _order.pop_front();
+   }
+}
+
+} } // graphene::chain
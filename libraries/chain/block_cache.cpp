@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_cache.hpp>
+
+namespace graphene { namespace chain {
+
+void block_cache::set_capacity( uint32_t capacity )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _capacity = capacity;
+   while( _lru.size() > _capacity.load() )
+   {
+      _by_num.erase( _lru.back().first );
+      _lru.pop_back();
+   }
+}
+
+block_cache::block_ptr block_cache::find( uint32_t block_num )const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _by_num.find( block_num );
+   if( itr == _by_num.end() )
+      return block_ptr();
+   _lru.splice( _lru.begin(), _lru, itr->second );
+   return itr->second->second;
+}
+
+block_cache::block_ptr block_cache::get( uint32_t block_num )const
+{
+   block_ptr result = find( block_num );
+   if( result )
+      ++_hits;
+   else
+      ++_misses;
+   return result;
+}
+
+block_cache::block_ptr block_cache::get( const block_id_type& id )const
+{
+   block_ptr result = find( block_header::num_from_id( id ) );
+   if( result && result->id() == id )
+   {
+      ++_hits;
+      return result;
+   }
+   ++_misses;
+   return block_ptr();
+}
+
+void block_cache::put( const block_id_type& id, const signed_block& b )
+{
+   if( _capacity == 0 )
+      return;
+
+   auto cached = std::make_shared<signed_block>( b );
+   // compute the ID now, readers must never write to a shared block
+   FC_ASSERT( cached->id() == id, "Refusing to cache a block under a wrong ID" );
+   put( id, block_ptr( std::move( cached ) ) );
+}
+
+void block_cache::put( const block_id_type& id, block_ptr cached )
+{
+   if( _capacity == 0 )
+      return;
+
+   const uint32_t block_num = block_header::num_from_id( id );
+
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _by_num.find( block_num );
+   if( itr != _by_num.end() )
+   {
+      itr->second->second = std::move( cached );
+      _lru.splice( _lru.begin(), _lru, itr->second );
+      return;
+   }
+   _lru.emplace_front( block_num, std::move( cached ) );
+   _by_num[block_num] = _lru.begin();
+   while( _lru.size() > _capacity.load() )
+   {
+      _by_num.erase( _lru.back().first );
+      _lru.pop_back();
+   }
+}
+
+void block_cache::erase( const block_id_type& id )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _by_num.find( block_header::num_from_id( id ) );
+   if( itr != _by_num.end() && itr->second->second->id() == id )
+   {
+      _lru.erase( itr->second );
+      _by_num.erase( itr );
+   }
+}
+
+void block_cache::erase_before( uint32_t block_num )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   for( auto itr = _lru.begin(); itr != _lru.end(); )
+   {
+      if( itr->first < block_num )
+      {
+         _by_num.erase( itr->first );
+         itr = _lru.erase( itr );
+      }
+      else
+         ++itr;
+   }
+}
+
+void block_cache::clear()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _lru.clear();
+   _by_num.clear();
+}
+
+block_cache_stats block_cache::get_stats()const
+{
+   block_cache_stats result;
+   result.hits = _hits.load();
+   result.misses = _misses.load();
+   std::lock_guard<std::mutex> guard( _mutex );
+   result.size = _lru.size();
+   result.capacity = _capacity.load();
+   return result;
+}
+
+} }
@@ -23,8 +23,18 @@
  */
 #include <graphene/chain/block_database.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
+#include <fc/interprocess/file_mapping.hpp>
+#include <fc/io/fstream.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/thread/parallel.hpp>
 #include <boost/endian/buffers.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
 
 namespace graphene { namespace chain {
 
@@ -34,7 +44,7 @@ struct index_entry
       block_pos = 0;
       block_size = 0;
    };
-   boost::endian::little_uint64_buf_t block_pos;
+   boost::endian::little_uint64_buf_t block_pos;  ///< position in the uncompressed contents of the block's segment
    boost::endian::little_uint32_buf_t block_size;
    block_id_type                      block_id;
 };
@@ -43,42 +53,731 @@ FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
+namespace detail {
+
+   static const uint32_t segment_magic      = 0x47534c42; // "BLSG"
+   static const uint32_t segment_version    = 1;
+   static const uint32_t default_frame_size = 256 * 1024;
+   static const uint32_t layout_version     = 1;
+
+   /// Header of a sealed segment, followed by the frame table and the compressed frames
+   struct segment_header
+   {
+      boost::endian::little_uint32_buf_t magic;
+      boost::endian::little_uint32_buf_t version;
+      boost::endian::little_uint32_buf_t frame_size;  ///< uncompressed size of every frame except the last one
+      boost::endian::little_uint32_buf_t frame_count;
+      boost::endian::little_uint64_buf_t raw_size;    ///< size of the uncompressed segment
+   };
+
+   struct frame_entry
+   {
+      boost::endian::little_uint64_buf_t file_pos;
+      boost::endian::little_uint32_buf_t raw_size;
+      boost::endian::little_uint32_buf_t packed_size;
+   };
+
+   /** A read-only mapping of the first @c size bytes of a file. Instances are immutable and shared by readers,
+    *  a mapping that is replaced by a bigger one stays valid until the last reader releases it. */
+   class mapped_file
+   {
+      public:
+         mapped_file( const fc::path& file, uint64_t size )
+         : _mapping( file.generic_string().c_str(), fc::read_only ),
+           _region( _mapping, fc::read_only, 0, size )
+         {}
+
+         const char* data()const { return static_cast<const char*>( _region.get_address() ); }
+         uint64_t    size()const { return _region.get_size(); }
+
+      private:
+         fc::file_mapping  _mapping;
+         fc::mapped_region _region;
+   };
+
+   /// Source of the serial numbers that identify sealed segments in the frame caches of reading threads
+   static std::atomic<uint64_t> next_segment_serial{1};
+
+   /** A compressed segment. Frames are inflated independently, so reading a block only inflates the frames that
+    *  overlap it. Each reading thread keeps its most recently inflated frames, so sequential readers do not need
+    *  to inflate a frame per block, and concurrent readers neither contend for a lock nor evict each other's
+    *  frames. */
+   class sealed_segment
+   {
+      public:
+         explicit sealed_segment( const fc::path& file )
+         : _file( file, fc::file_size( file ) ), _serial( next_segment_serial++ )
+         {
+            FC_ASSERT( _file.size() >= sizeof(segment_header), "Truncated block log segment ${f}", ("f",file) );
+            const auto* header = reinterpret_cast<const segment_header*>( _file.data() );
+            FC_ASSERT( header->magic.value() == segment_magic && header->version.value() == segment_version,
+                       "Unknown format of block log segment ${f}", ("f",file) );
+            _frame_size  = header->frame_size.value();
+            _frame_count = header->frame_count.value();
+            _raw_size    = header->raw_size.value();
+            FC_ASSERT( _frame_size > 0 && uint64_t(_frame_count) * _frame_size >= _raw_size
+                       && _file.size() >= sizeof(segment_header) + uint64_t(_frame_count) * sizeof(frame_entry),
+                       "Corrupt block log segment ${f}", ("f",file) );
+            _frames = reinterpret_cast<const frame_entry*>( _file.data() + sizeof(segment_header) );
+            // read() locates positions by the frame size, so only the last frame may be shorter
+            uint64_t total_size = 0;
+            for( uint32_t frame = 0; frame < _frame_count; ++frame )
+            {
+               const uint32_t frame_raw_size = _frames[frame].raw_size.value();
+               FC_ASSERT( frame_raw_size == _frame_size
+                          || ( frame + 1 == _frame_count && frame_raw_size > 0 && frame_raw_size < _frame_size ),
+                          "Corrupt frame table in block log segment ${f}", ("f",file) );
+               total_size += frame_raw_size;
+            }
+            FC_ASSERT( total_size == _raw_size, "Corrupt frame table in block log segment ${f}", ("f",file) );
+         }
+
+         uint64_t raw_size()const  { return _raw_size; }
+         uint64_t disk_size()const { return _file.size(); }
+
+         /** @return the on-disk position of the frame containing uncompressed position @p raw_pos */
+         uint64_t disk_position( uint64_t raw_pos )const
+         {
+            const uint64_t frame = raw_pos / _frame_size;
+            return frame < _frame_count ? _frames[frame].file_pos.value() : _file.size();
+         }
+
+         void read( uint64_t raw_pos, uint64_t size, char* out )const
+         {
+            FC_ASSERT( raw_pos + size <= _raw_size, "Read beyond the end of a block log segment" );
+            uint32_t frame = raw_pos / _frame_size;
+            while( size > 0 )
+            {
+               const frame_data data = inflate( frame );
+               const uint64_t offset = raw_pos - uint64_t(frame) * _frame_size;
+               const uint64_t count = std::min<uint64_t>( size, data->size() - offset );
+               std::memcpy( out, data->data() + offset, count );
+               out += count;
+               raw_pos += count;
+               size -= count;
+               ++frame;
+            }
+         }
+
+         void read_all( std::ostream& out )const
+         {
+            for( uint32_t frame = 0; frame < _frame_count; ++frame )
+            {
+               const frame_data data = inflate( frame );
+               out.write( data->data(), data->size() );
+            }
+         }
+
+      private:
+         using frame_data = std::shared_ptr<const std::vector<char>>;
+
+         struct cached_frame
+         {
+            uint64_t   segment = 0; ///< serial number of the segment, 0 if unused
+            uint32_t   frame = 0;
+            frame_data data;
+         };
+         static const uint32_t cached_frames_per_thread = 2;
+
+         frame_data inflate( uint32_t frame )const
+         {
+            static thread_local std::array<cached_frame, cached_frames_per_thread> cache;
+            static thread_local uint32_t next_cache_slot = 0;
+            for( const cached_frame& item : cache )
+               if( item.segment == _serial && item.frame == frame )
+                  return item.data;
+
+            FC_ASSERT( frame < _frame_count, "Read beyond the end of a block log segment" );
+            const frame_entry& entry = _frames[frame];
+            FC_ASSERT( entry.file_pos.value() + entry.packed_size.value() <= _file.size(),
+                       "Corrupt frame ${n} in block log segment", ("n",frame) );
+            auto result = std::make_shared<std::vector<char>>( entry.raw_size.value() );
+            uLongf raw_size = entry.raw_size.value();
+            const int status = uncompress( reinterpret_cast<Bytef*>( result->data() ), &raw_size,
+                                           reinterpret_cast<const Bytef*>( _file.data() + entry.file_pos.value() ),
+                                           entry.packed_size.value() );
+            FC_ASSERT( status == Z_OK && raw_size == entry.raw_size.value(),
+                       "Corrupt frame ${n} in block log segment", ("n",frame) );
+            cached_frame& slot = cache[next_cache_slot];
+            next_cache_slot = ( next_cache_slot + 1 ) % cached_frames_per_thread;
+            slot.segment = _serial;
+            slot.frame = frame;
+            slot.data = result;
+            return result;
+         }
+
+         mapped_file         _file;
+         const uint64_t      _serial;
+         const frame_entry*  _frames = nullptr;
+         uint32_t            _frame_size = 0;
+         uint32_t            _frame_count = 0;
+         uint64_t            _raw_size = 0;
+   };
+
+   /** Compresses the raw segment @p raw_file into @p sealed_file. The result is written to a temporary file
+    *  first and renamed when complete. */
+   static void write_sealed_segment( const fc::path& raw_file, const fc::path& sealed_file )
+   {
+      const uint64_t raw_size = fc::exists( raw_file ) ? fc::file_size( raw_file ) : 0;
+      std::unique_ptr<mapped_file> raw;
+      if( raw_size > 0 )
+         raw = std::make_unique<mapped_file>( raw_file, raw_size );
+
+      const uint32_t frame_count = ( raw_size + default_frame_size - 1 ) / default_frame_size;
+      segment_header header;
+      header.magic       = segment_magic;
+      header.version     = segment_version;
+      header.frame_size  = default_frame_size;
+      header.frame_count = frame_count;
+      header.raw_size    = raw_size;
+      std::vector<frame_entry> frames( frame_count );
+
+      const fc::path tmp_file( sealed_file.generic_string() + ".tmp" );
+      std::ofstream out( tmp_file.generic_string().c_str(),
+                         std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      out.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      uint64_t file_pos = sizeof(header) + frames.size() * sizeof(frame_entry);
+      const std::vector<char> placeholder( file_pos, 0 );
+      out.write( placeholder.data(), placeholder.size() );
+
+      std::vector<char> packed;
+      for( uint32_t i = 0; i < frame_count; ++i )
+      {
+         const uint64_t raw_pos = uint64_t(i) * default_frame_size;
+         const uint32_t size = std::min<uint64_t>( default_frame_size, raw_size - raw_pos );
+         uLongf packed_size = compressBound( size );
+         packed.resize( packed_size );
+         const int status = compress2( reinterpret_cast<Bytef*>( packed.data() ), &packed_size,
+                                       reinterpret_cast<const Bytef*>( raw->data() + raw_pos ), size,
+                                       Z_BEST_SPEED );
+         FC_ASSERT( status == Z_OK, "Failed to compress block log segment ${f}", ("f",raw_file)("status",status) );
+         frames[i].file_pos    = file_pos;
+         frames[i].raw_size    = size;
+         frames[i].packed_size = packed_size;
+         out.write( packed.data(), packed_size );
+         file_pos += packed_size;
+      }
+
+      out.seekp( 0 );
+      out.write( (const char*)&header, sizeof(header) );
+      if( !frames.empty() )
+         out.write( (const char*)frames.data(), frames.size() * sizeof(frame_entry) );
+      out.close();
+      fc::rename( tmp_file, sealed_file );
+   }
+
+   static fc::path sibling_path( const fc::path& dir, const std::string& suffix )
+   {
+      return fc::path( dir.generic_string() + suffix );
+   }
+
+   static void write_layout( const fc::path& file, uint32_t blocks_per_segment )
+   {
+      std::ofstream out( file.generic_string().c_str(),
+                         std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      fc::raw::pack( out, layout_version );
+      fc::raw::pack( out, blocks_per_segment );
+      FC_ASSERT( out, "Unable to write ${f}", ("f",file) );
+   }
+
+   static uint32_t read_layout( const fc::path& file )
+   {
+      std::string data;
+      fc::read_file_contents( file, data );
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      uint32_t version;
+      uint32_t blocks_per_segment;
+      fc::raw::unpack( ds, version );
+      fc::raw::unpack( ds, blocks_per_segment );
+      FC_ASSERT( version == layout_version && blocks_per_segment > 0,
+                 "Unsupported block log layout in ${f}", ("f",file) );
+      return blocks_per_segment;
+   }
+
+} // detail
+
+block_database::block_database( uint32_t blocks_per_segment, uint32_t seal_distance )
+: _blocks_per_segment( blocks_per_segment ), _seal_distance( seal_distance )
+{
+   FC_ASSERT( blocks_per_segment > 0 );
+}
+
+block_database::~block_database()
+{
+   wait_for_sealing();
+   wait_for_pruning();
+}
+
 void block_database::open( const fc::path& dbdir )
 { try {
+   // finish or discard an interrupted conversion
+   const fc::path tmp_dir = detail::sibling_path( dbdir, ".tmp" );
+   const fc::path old_dir = detail::sibling_path( dbdir, ".old" );
+   if( fc::exists( tmp_dir ) )
+   {
+      if( !fc::exists( dbdir ) && !fc::exists( tmp_dir / "lock" ) )
+         fc::rename( tmp_dir, dbdir );
+      else
+         fc::remove_all( tmp_dir );
+   }
+   if( fc::exists( old_dir ) )
+      fc::remove_all( old_dir );
+
+   if( fc::exists( dbdir / "blocks" ) && !fc::is_directory( dbdir / "blocks" ) )
+      convert_legacy_log( dbdir, _blocks_per_segment, _seal_distance );
+
    fc::create_directories(dbdir);
    _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
    _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
+   reset_index_mapping();
    _index_filename = dbdir / "index";
+   _segments_dir = dbdir / "segments";
+   fc::create_directories( _segments_dir );
+   const fc::path layout_file = dbdir / "layout";
+   if( fc::exists( layout_file ) )
+      _blocks_per_segment = detail::read_layout( layout_file );
+   else
+      detail::write_layout( layout_file, _blocks_per_segment );
+
    if( !fc::exists( _index_filename ) )
-   {
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-   }
    else
-   {
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-   }
+
+   load_segments();
+   truncate_index();
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) } // GCOVR_EXCL_LINE
 
+void block_database::truncate_index()
+{
+   // no reader holds a mapping of the index while the database is being opened, so it can be shrunk safely
+   const optional<index_entry> last = last_index_entry();
+   const uint64_t keep = last.valid() ? ( uint64_t( block_header::num_from_id( last->block_id ) ) + 1 )
+                                        * sizeof(index_entry)
+                                      : 0;
+   const uint64_t index_size = fc::file_size( _index_filename );
+   if( index_size <= keep )
+      return;
+   wlog( "Dropping ${n} trailing bytes of block log index entries of blocks that are not on file",
+         ("n",index_size - keep) );
+   reset_index_mapping();
+   fc::resize_file( _index_filename, keep );
+}
+
+void block_database::load_segments()
+{
+   auto segments = std::make_shared<segment_map>();
+   for( fc::directory_iterator itr( _segments_dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      const fc::path file = *itr;
+      const std::string extension = file.extension().generic_string();
+      if( extension == ".tmp" )
+      {
+         fc::remove( file );
+         continue;
+      }
+      if( extension != ".raw" && extension != ".seg" )
+         continue;
+      uint32_t segment;
+      try
+      {
+         segment = boost::lexical_cast<uint32_t>( file.stem().generic_string() );
+      }
+      catch( const boost::bad_lexical_cast& )
+      {
+         wlog( "Ignoring unexpected file ${f} in block log", ("f",file) );
+         continue;
+      }
+      segment_slot_ptr& slot = (*segments)[segment];
+      if( !slot )
+         slot = std::make_shared<segment_slot>();
+      if( extension == ".seg" )
+         slot->sealed = std::make_shared<detail::sealed_segment>( file );
+   }
+
+   // a seal may have been interrupted after the sealed segment was complete
+   for( const auto& item : *segments )
+      if( item.second->sealed && fc::exists( raw_segment_file( item.first ) ) )
+         fc::remove( raw_segment_file( item.first ) );
+
+   _pruned_below_segment = 0;
+   _next_unsealed = 0;
+   for( const auto& item : *segments )
+   {
+      if( !item.second->sealed )
+         break;
+      _next_unsealed = item.first + 1;
+   }
+   std::lock_guard<std::mutex> guard( _mutex );
+   std::atomic_store( &_segments, segment_map_ptr( std::move( segments ) ) );
+}
+
+template<typename Update>
+void block_database::update_segments( Update&& update )const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto segments = std::make_shared<segment_map>( *std::atomic_load( &_segments ) );
+   update( *segments );
+   std::atomic_store( &_segments, segment_map_ptr( std::move( segments ) ) );
+}
+
+block_database::segment_slot_ptr block_database::find_segment( uint32_t segment )const
+{
+   const segment_map_ptr segments = std::atomic_load( &_segments );
+   auto itr = segments->find( segment );
+   return itr != segments->end() ? itr->second : segment_slot_ptr();
+}
+
 bool block_database::is_open()const
 {
-  return _blocks.is_open();
+  return _block_num_to_pos.is_open();
 }
 
 void block_database::close()
 {
-  _blocks.close();
+  wait_for_sealing();
+  wait_for_pruning();
+  _cache.clear();
+  reset_index_mapping();
+  update_segments( []( segment_map& segments ) { segments.clear(); } );
+  if( _blocks.is_open() )
+     _blocks.close();
+  _write_segment.reset();
   _block_num_to_pos.close();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
+  if( _blocks.is_open() )
+     _blocks.flush();
   _block_num_to_pos.flush();
 }
 
+void block_database::wait_for_sealing()
+{
+   if( !_sealing.valid() )
+      return;
+   fc::future<void> sealing = _sealing;
+   _sealing = fc::future<void>();
+   _sealing_segment.reset();
+   try
+   {
+      sealing.wait();
+   }
+   catch( const fc::exception& e )
+   {
+      // the segment stays unsealed, sealing is retried after the next open()
+      elog( "Failed to seal block log segment: ${e}", ("e",e.to_detail_string()) );
+   }
+}
+
+fc::path block_database::raw_segment_file( uint32_t segment )const
+{
+   return _segments_dir / ( fc::to_string( segment ) + ".raw" );
+}
+
+fc::path block_database::sealed_segment_file( uint32_t segment )const
+{
+   return _segments_dir / ( fc::to_string( segment ) + ".seg" );
+}
+
+void block_database::open_segment_for_write( uint32_t segment )
+{
+   if( _write_segment.valid() && *_write_segment == segment )
+      return;
+
+   if( _sealing_segment.valid() && *_sealing_segment == segment )
+      wait_for_sealing();
+
+   if( _blocks.is_open() )
+      _blocks.close();
+   _write_segment.reset();
+
+   const segment_slot_ptr slot = find_segment( segment );
+   if( slot && slot->sealed )
+      unseal_segment( segment );
+
+   const fc::path file = raw_segment_file( segment );
+   if( !fc::exists( file ) )
+      _blocks.open( file.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc );
+   else
+      _blocks.open( file.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   _write_segment = segment;
+
+   if( !find_segment( segment ) )
+      update_segments( [segment]( segment_map& segments ) {
+         segments[segment] = std::make_shared<segment_slot>();
+      } );
+   if( segment < _next_unsealed )
+      _next_unsealed = segment;
+}
+
+void block_database::unseal_segment( uint32_t segment )
+{
+   wlog( "Block log segment ${s} has to be modified, decompressing it", ("s",segment) );
+   const sealed_segment_ptr sealed = find_segment( segment )->sealed;
+   const fc::path raw_file = raw_segment_file( segment );
+   const fc::path tmp_file( raw_file.generic_string() + ".tmp" );
+   {
+      std::ofstream out( tmp_file.generic_string().c_str(),
+                         std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      out.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      sealed->read_all( out );
+   }
+   fc::rename( tmp_file, raw_file );
+   update_segments( [segment]( segment_map& segments ) {
+      segments[segment] = std::make_shared<segment_slot>();
+   } );
+   fc::remove( sealed_segment_file( segment ) );
+}
+
+void block_database::seal_segment( uint32_t segment )
+{ try {
+   const fc::path raw_file = raw_segment_file( segment );
+   const fc::path sealed_file = sealed_segment_file( segment );
+   detail::write_sealed_segment( raw_file, sealed_file );
+   auto slot = std::make_shared<segment_slot>();
+   slot->sealed = std::make_shared<detail::sealed_segment>( sealed_file );
+   const sealed_segment_ptr sealed = slot->sealed;
+   update_segments( [segment,&slot]( segment_map& segments ) { segments[segment] = slot; } );
+   // readers that still hold a mapping of the raw file keep it valid until they release it
+   try
+   {
+      fc::remove( raw_file );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to remove ${f} after sealing, will retry on next open: ${e}", ("f",raw_file)("e",e.to_string()) );
+   }
+   ilog( "Sealed block log segment ${s}: ${raw} bytes compressed to ${packed}",
+         ("s",segment)("raw",sealed->raw_size())("packed",sealed->disk_size()) );
+} FC_CAPTURE_AND_RETHROW( (segment) ) } // GCOVR_EXCL_LINE
+
+void block_database::maybe_seal_segments( uint32_t head_block_num )
+{
+   if( _sealing.valid() )
+   {
+      if( !_sealing.ready() )
+         return;
+      wait_for_sealing();
+   }
+
+   while( uint64_t(_next_unsealed + 1) * _blocks_per_segment + _seal_distance <= head_block_num )
+   {
+      const uint32_t segment = _next_unsealed;
+      const segment_slot_ptr slot = find_segment( segment );
+      if( slot && !slot->sealed )
+      {
+         // a segment that is written to again, e.g. after a fork switch, is sealed once writing has moved on
+         if( _write_segment.valid() && *_write_segment == segment )
+            break;
+         ++_next_unsealed;
+         _sealing_segment = segment;
+         _sealing = fc::do_parallel( [this,segment] () { seal_segment( segment ); } );
+         break;
+      }
+      ++_next_unsealed;
+   }
+}
+
+void block_database::prune( uint32_t first_block_to_keep )
+{
+   // called for every block, there is nothing to do until the first block to keep moves to another segment
+   if( segment_of( first_block_to_keep ) <= _pruned_below_segment )
+      return;
+
+   if( _pruning.valid() )
+   {
+      if( !_pruning.ready() )
+         return;
+      wait_for_pruning();
+   }
+
+   // the segment holding the head is kept even if it is not open for writing
+   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+   const uint64_t index_entries = uint64_t( _block_num_to_pos.tellg() ) / sizeof(index_entry);
+   if( index_entries == 0 )
+      return;
+   const uint32_t first_segment_to_keep = std::min( segment_of( first_block_to_keep ),
+                                                    segment_of( uint32_t( index_entries - 1 ) ) );
+   std::vector<fc::path> files;
+   uint32_t dropped = 0;
+   uint32_t end_of_dropped = 0;
+   bool blocked = false;
+   update_segments( [&]( segment_map& segments ) {
+      auto itr = segments.begin();
+      while( itr != segments.end() && itr->first < first_segment_to_keep )
+      {
+         const uint32_t segment = itr->first;
+         if( ( _write_segment.valid() && *_write_segment == segment )
+               || ( _sealing_segment.valid() && *_sealing_segment == segment ) )
+         {
+            blocked = true;
+            break;
+         }
+         // readers that still hold a mapping of a dropped segment keep it valid until they release it
+         files.push_back( raw_segment_file( segment ) );
+         files.push_back( sealed_segment_file( segment ) );
+         itr = segments.erase( itr );
+         ++dropped;
+         end_of_dropped = ( segment + 1 ) * _blocks_per_segment;
+      }
+   } );
+   // segments that could not be dropped yet are retried with the next block
+   if( !blocked && first_segment_to_keep == segment_of( first_block_to_keep ) )
+      _pruned_below_segment = first_segment_to_keep;
+   if( dropped == 0 )
+      return;
+   _cache.erase_before( end_of_dropped );
+
+   ilog( "Pruning ${n} block log segment(s) below block ${b}", ("n",dropped)("b",end_of_dropped) );
+   _pruning = fc::do_parallel( [files] () {
+      for( const fc::path& file : files )
+      {
+         try
+         {
+            if( fc::exists( file ) )
+               fc::remove( file );
+         }
+         catch( const fc::exception& e )
+         {
+            // the segment reappears on next open() and is dropped again by the next prune()
+            wlog( "Unable to remove pruned block log file ${f}: ${e}", ("f",file)("e",e.to_string()) );
+         }
+      }
+   } );
+}
+
+uint32_t block_database::first_retained_block_num()const
+{
+   const segment_map_ptr segments = std::atomic_load( &_segments );
+   if( segments->empty() )
+      return 1;
+   return std::max<uint32_t>( 1, segments->begin()->first * _blocks_per_segment );
+}
+
+void block_database::wait_for_pruning()
+{
+   if( !_pruning.valid() )
+      return;
+   fc::future<void> pruning = _pruning;
+   _pruning = fc::future<void>();
+   pruning.wait();
+}
+
+void block_database::reset_index_mapping()const
+{
+   std::atomic_store( &_index_map, mapped_file_ptr() );
+}
+
+block_database::mapped_file_ptr block_database::map_at_least( mapped_file_ptr& current, const fc::path& file,
+                                                              uint64_t min_size )const
+{
+   mapped_file_ptr result = std::atomic_load( &current );
+   if( result && result->size() >= min_size )
+      return result;
+
+   // concurrent readers may map the file at the same time, the biggest mapping is kept
+   const uint64_t file_size = fc::exists( file ) ? fc::file_size( file ) : 0;
+   if( file_size < min_size || file_size == 0 )
+      return mapped_file_ptr();
+
+   const mapped_file_ptr mapped = std::make_shared<detail::mapped_file>( file, file_size );
+   while( !( result && result->size() >= mapped->size() )
+          && !std::atomic_compare_exchange_weak( &current, &result, mapped ) )
+   {
+   }
+   return mapped;
+}
+
+bool block_database::read_index_entry( uint32_t block_num, index_entry& e )const
+{
+   const uint64_t index_pos = sizeof(e) * uint64_t(block_num);
+   const mapped_file_ptr index_map = map_at_least( _index_map, _index_filename, index_pos + sizeof(e) );
+   if( !index_map )
+      return false;
+   // an entry that is being written may be read torn, read_block() rejects data that does not match its ID
+   std::memcpy( (char*)&e, index_map->data() + index_pos, sizeof(e) );
+   return true;
+}
+
+bool block_database::find_block_data( uint32_t block_num, const index_entry& e, mapped_file_ptr& raw,
+                                      sealed_segment_ptr& sealed )const
+{
+   if( e.block_size.value() == 0 )
+      return false;
+
+   const uint32_t segment = segment_of( block_num );
+   const segment_slot_ptr slot = find_segment( segment );
+   if( !slot )
+      return false;
+   sealed = slot->sealed;
+   if( !sealed )
+   {
+      raw = map_at_least( slot->raw, raw_segment_file( segment ), e.block_pos.value() + e.block_size.value() );
+      if( !raw )
+         return false;
+   }
+   return true;
+}
+
+block_cache::block_ptr block_database::read_block( uint32_t block_num, const index_entry& e )const
+{
+   mapped_file_ptr raw;
+   sealed_segment_ptr sealed;
+   if( !find_block_data( block_num, e, raw, sealed ) )
+      return block_cache::block_ptr();
+
+   auto result = std::make_shared<signed_block>();
+   if( sealed )
+   {
+      vector<char> data( e.block_size.value() );
+      sealed->read( e.block_pos.value(), data.size(), data.data() );
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      fc::raw::unpack( ds, *result );
+   }
+   else
+   {
+      fc::datastream<const char*> ds( raw->data() + e.block_pos.value(), e.block_size.value() );
+      fc::raw::unpack( ds, *result );
+   }
+   // also computes the ID before the block is shared
+   FC_ASSERT( result->id() == e.block_id );
+   _last_read_num.store( block_num, std::memory_order_relaxed );
+   _last_read_end.store( e.block_pos.value() + e.block_size.value(), std::memory_order_relaxed );
+   return result;
+}
+
+bool block_database::fetch_packed_by_number( uint32_t block_num, block_id_type& id, vector<char>& data )const
+{
+   try
+   {
+      index_entry e;
+      mapped_file_ptr raw;
+      sealed_segment_ptr sealed;
+      if( !read_index_entry( block_num, e ) || !find_block_data( block_num, e, raw, sealed ) )
+         return false;
+
+      data.resize( e.block_size.value() );
+      if( sealed )
+         sealed->read( e.block_pos.value(), data.size(), data.data() );
+      else
+         std::memcpy( data.data(), raw->data() + e.block_pos.value(), data.size() );
+      id = e.block_id;
+      _last_read_num.store( block_num, std::memory_order_relaxed );
+      _last_read_end.store( e.block_pos.value() + e.block_size.value(), std::memory_order_relaxed );
+      return true;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return false;
+}
+
 void block_database::store( const block_id_type& _id, const signed_block& b )
 {
    block_id_type id = _id;
@@ -87,7 +786,9 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
-   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
+   const uint32_t block_num = block_header::num_from_id(id);
+   open_segment_for_write( segment_of( block_num ) );
+   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_num) );
    index_entry e;
    _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
@@ -95,7 +796,13 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
    e.block_size = vec.size();
    e.block_id   = id;
    _blocks.write( vec.data(), vec.size() );
+   // the block must be on file before its index entry becomes visible to mapped readers
+   _blocks.flush();
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   _block_num_to_pos.flush();
+   _cache.put( id, b );
+
+   maybe_seal_segments( block_num );
 }
 
 void block_database::remove( const block_id_type& id )
@@ -109,11 +816,13 @@ void block_database::remove( const block_id_type& id )
    _block_num_to_pos.seekg( index_pos );
    _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
+   _cache.erase( id );
    if( e.block_id == id )
    {
       e.block_size = 0;
       _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
       _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      _block_num_to_pos.flush();
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) } // GCOVR_EXCL_LINE
 
@@ -122,13 +831,14 @@ bool block_database::contains( const block_id_type& id )const
    if( id == block_id_type() )
       return false;
 
+   // the index entries of pruned blocks are kept, but their contents can not be served
+   const uint32_t block_num = block_header::num_from_id(id);
+   if( block_num < first_retained_block_num() )
+      return false;
+
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+   if( !read_index_entry( block_num, e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size.value() > 0;
 }
@@ -137,39 +847,31 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
 
-optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
+block_cache::block_ptr block_database::fetch_shared( const block_id_type& id )const
 {
    try
    {
+      block_cache::block_ptr result = _cache.get( id );
+      if( result )
+         return result;
+
+      const uint32_t block_num = block_header::num_from_id(id);
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      if( e.block_id != id ) return {};
 
-      if( e.block_id != id ) return optional<signed_block>();
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      if (e.block_size.value())
-         _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
+      result = read_block( block_num, e );
+      if( result )
+         _cache.put( id, result );
       return result;
    }
    catch (const fc::exception&)
@@ -178,27 +880,24 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
    catch (const std::exception&)
    {
    }
-   return optional<signed_block>();
+   return block_cache::block_ptr();
 }
 
-optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+block_cache::block_ptr block_database::fetch_shared_by_number( uint32_t block_num )const
 {
    try
    {
+      block_cache::block_ptr result = _cache.get( block_num );
+      if( result )
+         return result;
+
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
+      result = read_block( block_num, e );
+      if( result )
+         _cache.put( e.block_id, result );
       return result;
    }
    catch (const fc::exception&)
@@ -207,6 +906,22 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    catch (const std::exception&)
    {
    }
+   return block_cache::block_ptr();
+}
+
+optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
+{
+   const block_cache::block_ptr block = fetch_shared( id );
+   if( block )
+      return *block;
+   return optional<signed_block>();
+}
+
+optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+{
+   const block_cache::block_ptr block = fetch_shared_by_number( block_num );
+   if( block )
+      return *block;
    return optional<signed_block>();
 }
 
@@ -216,32 +931,16 @@ optional<index_entry> block_database::last_index_entry()const {
       index_entry e;
 
       _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      std::streampos pos = _block_num_to_pos.tellg();
-      if( pos < long(sizeof(index_entry)) )
-         return optional<index_entry>();
-
-      pos -= pos % sizeof(index_entry);
+      const uint64_t entries = uint64_t( _block_num_to_pos.tellg() ) / sizeof(index_entry);
 
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
-      while( pos > 0 )
+      // entries of removed blocks are skipped, the index is only truncated by open() where it is not shared
+      for( uint64_t block_num = entries; block_num > 0; --block_num )
       {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size.value() > 0
-                && int64_t(e.block_pos.value() + e.block_size.value()) <= blocks_size )
+         if( read_index_entry( block_num - 1, e ) && e.block_size.value() > 0 )
             try
             {
-               vector<char> data( e.block_size.value() );
-               _blocks.seekg( e.block_pos.value() );
-               _blocks.read( data.data(), e.block_size.value() );
-               if( _blocks.gcount() == long(e.block_size.value()) )
-               {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
-                     return e;
-               }
+               if( read_block( block_num - 1, e ) )
+                  return e;
             }
             catch (const fc::exception&)
             {
@@ -249,7 +948,6 @@ optional<index_entry> block_database::last_index_entry()const {
             catch (const std::exception&)
             {
             }
-         fc::resize_file( _index_filename, pos );
       }
    }
    catch (const fc::exception&)
@@ -277,13 +975,125 @@ optional<block_id_type> block_database::last_id()const
 
 size_t block_database::blocks_current_position()const
 {
-   return (size_t)_blocks.tellg();
+   const uint32_t segment = segment_of( _last_read_num.load( std::memory_order_relaxed ) );
+   const uint64_t raw_pos = _last_read_end.load( std::memory_order_relaxed );
+   uint64_t result = 0;
+   const segment_map_ptr segments = std::atomic_load( &_segments );
+   for( const auto& item : *segments )
+   {
+      if( item.first > segment )
+         break;
+      const fc::path raw_file = raw_segment_file( item.first );
+      const sealed_segment_ptr& sealed = item.second->sealed;
+      if( item.first == segment )
+         result += sealed ? sealed->disk_position( raw_pos ) : raw_pos;
+      else
+         result += sealed ? sealed->disk_size() : fc::exists( raw_file ) ? fc::file_size( raw_file ) : 0;
+   }
+   return result;
 }
 
 size_t block_database::total_block_size()const
 {
-   _blocks.seekg( 0, _blocks.end );
-   return (size_t)_blocks.tellg();
+   uint64_t result = 0;
+   const segment_map_ptr segments = std::atomic_load( &_segments );
+   for( const auto& item : *segments )
+   {
+      const fc::path raw_file = raw_segment_file( item.first );
+      const sealed_segment_ptr& sealed = item.second->sealed;
+      result += sealed ? sealed->disk_size() : fc::exists( raw_file ) ? fc::file_size( raw_file ) : 0;
+   }
+   return result;
 }
 
+void block_database::convert_legacy_log( const fc::path& dbdir, uint32_t blocks_per_segment, uint32_t seal_distance )
+{ try {
+   FC_ASSERT( blocks_per_segment > 0 );
+   const fc::path legacy_index = dbdir / "index";
+   const fc::path legacy_blocks = dbdir / "blocks";
+   const fc::path tmp_dir = detail::sibling_path( dbdir, ".tmp" );
+   const fc::path old_dir = detail::sibling_path( dbdir, ".old" );
+
+   ilog( "Converting block log in ${d} to the segmented format, please DO NOT kill the program", ("d",dbdir) );
+   if( fc::exists( tmp_dir ) )
+      fc::remove_all( tmp_dir );
+   fc::create_directories( tmp_dir / "lock" );
+   fc::create_directories( tmp_dir / "segments" );
+
+   const uint64_t index_size = fc::exists( legacy_index ) ? fc::file_size( legacy_index ) : 0;
+   const uint64_t blocks_size = fc::file_size( legacy_blocks );
+   std::unique_ptr<detail::mapped_file> index_map;
+   std::unique_ptr<detail::mapped_file> blocks_map;
+   if( index_size >= sizeof(index_entry) )
+      index_map = std::make_unique<detail::mapped_file>( legacy_index, index_size );
+   if( blocks_size > 0 )
+      blocks_map = std::make_unique<detail::mapped_file>( legacy_blocks, blocks_size );
+
+   std::ofstream new_index( ( tmp_dir / "index" ).generic_string().c_str(),
+                            std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   new_index.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   std::ofstream segment_out;
+   segment_out.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   optional<uint32_t> current_segment;
+   uint64_t segment_pos = 0;
+   uint32_t last_block_num = 0;
+
+   const uint64_t entries = index_map ? index_size / sizeof(index_entry) : 0;
+   for( uint64_t block_num = 0; block_num < entries; ++block_num )
+   {
+      index_entry e;
+      std::memcpy( (char*)&e, index_map->data() + block_num * sizeof(e), sizeof(e) );
+      if( e.block_size.value() > 0 && e.block_pos.value() + e.block_size.value() <= blocks_size )
+      {
+         const uint32_t segment = block_num / blocks_per_segment;
+         if( !current_segment.valid() || *current_segment != segment )
+         {
+            if( segment_out.is_open() )
+               segment_out.close();
+            const fc::path file = tmp_dir / "segments" / ( fc::to_string( segment ) + ".raw" );
+            segment_out.open( file.generic_string().c_str(),
+                              std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+            current_segment = segment;
+            segment_pos = 0;
+         }
+         segment_out.write( blocks_map->data() + e.block_pos.value(), e.block_size.value() );
+         e.block_pos = segment_pos;
+         segment_pos += e.block_size.value();
+         last_block_num = block_num;
+      }
+      else
+      {
+         // either removed or beyond the end of the blocks file, open() drops such entries from the end
+         e.block_pos = 0;
+         e.block_size = 0;
+      }
+      new_index.write( (const char*)&e, sizeof(e) );
+      if( block_num % 1000000 == 0 && block_num > 0 )
+         ilog( "   converted ${n} of ${total} blocks", ("n",block_num)("total",entries - 1) );
+   }
+   if( segment_out.is_open() )
+      segment_out.close();
+   new_index.close();
+   index_map.reset();
+   blocks_map.reset();
+   detail::write_layout( tmp_dir / "layout", blocks_per_segment );
+
+   for( uint32_t segment = 0; uint64_t(segment + 1) * blocks_per_segment + seal_distance <= last_block_num; ++segment )
+   {
+      const fc::path raw_file = tmp_dir / "segments" / ( fc::to_string( segment ) + ".raw" );
+      if( !fc::exists( raw_file ) )
+         continue;
+      detail::write_sealed_segment( raw_file, tmp_dir / "segments" / ( fc::to_string( segment ) + ".seg" ) );
+      fc::remove( raw_file );
+   }
+
+   fc::remove_all( tmp_dir / "lock" );
+   if( fc::exists( old_dir ) )
+      fc::remove_all( old_dir );
+   fc::rename( dbdir, old_dir );
+   fc::rename( tmp_dir, dbdir );
+   fc::remove_all( old_dir );
+   ilog( "Done converting block log" );
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) } // GCOVR_EXCL_LINE
+
 } }
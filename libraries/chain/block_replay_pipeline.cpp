@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_replay_pipeline.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace graphene { namespace chain {
+
+namespace {
+   /// Waits for another stage of the pipeline, yielding first and sleeping when the wait gets longer
+   class backoff
+   {
+      public:
+         void operator()()
+         {
+            if( _spins < 64 )
+            {
+               ++_spins;
+               std::this_thread::yield();
+            }
+            else
+               std::this_thread::sleep_for( std::chrono::microseconds( 50 ) );
+         }
+
+      private:
+         uint32_t _spins = 0;
+   };
+}
+
+struct block_replay_pipeline::packed_block
+{
+   uint32_t      block_num = 0;
+   bool          found = false;
+   block_id_type id;
+   vector<char>  data;
+};
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue. Each cell carries a sequence number that tells producers
+ * and consumers at a given position whether the cell is free or filled for them.
+ */
+struct block_replay_pipeline::packed_queue
+{
+   struct cell
+   {
+      std::atomic<size_t> sequence;
+      packed_block*       data = nullptr;
+   };
+
+   explicit packed_queue( size_t capacity ) : _cells( new cell[capacity] ), _capacity( capacity )
+   {
+      for( size_t i = 0; i < capacity; ++i )
+         _cells[i].sequence.store( i, std::memory_order_relaxed );
+   }
+
+   /// @return false if the queue is full
+   bool push( packed_block* data )
+   {
+      size_t pos = _enqueue_pos.load( std::memory_order_relaxed );
+      while( true )
+      {
+         cell& c = _cells[ pos % _capacity ];
+         const size_t sequence = c.sequence.load( std::memory_order_acquire );
+         if( sequence == pos )
+         {
+            if( _enqueue_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+            {
+               c.data = data;
+               c.sequence.store( pos + 1, std::memory_order_release );
+               return true;
+            }
+         }
+         else if( sequence < pos )
+            return false;
+         else
+            pos = _enqueue_pos.load( std::memory_order_relaxed );
+      }
+   }
+
+   /// @return false if the queue is empty or the next element is still being pushed
+   bool pop( packed_block*& data )
+   {
+      size_t pos = _dequeue_pos.load( std::memory_order_relaxed );
+      while( true )
+      {
+         cell& c = _cells[ pos % _capacity ];
+         const size_t sequence = c.sequence.load( std::memory_order_acquire );
+         if( sequence == pos + 1 )
+         {
+            if( _dequeue_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+            {
+               data = c.data;
+               c.sequence.store( pos + _capacity, std::memory_order_release );
+               return true;
+            }
+         }
+         else if( sequence < pos + 1 )
+            return false;
+         else
+            pos = _dequeue_pos.load( std::memory_order_relaxed );
+      }
+   }
+
+private:
+   std::unique_ptr<cell[]> _cells;
+   const size_t            _capacity;
+   std::atomic<size_t>     _enqueue_pos{0};
+   std::atomic<size_t>     _dequeue_pos{0};
+};
+
+struct block_replay_pipeline::slot
+{
+   std::atomic<uint32_t>  block_num{0}; ///< number of the block that has been put here, 0 if none
+   optional<signed_block> block;
+};
+
+block_replay_pipeline::block_replay_pipeline( const block_database& blocks, uint32_t first_block_num,
+                                              uint32_t last_block_num, uint32_t queue_depth,
+                                              uint32_t decode_threads, precompute_function precompute )
+   : _blocks( blocks ), _first_block_num( first_block_num ), _last_block_num( last_block_num ),
+     _queue_depth( queue_depth ), _precompute( std::move( precompute ) ), _next_block_num( first_block_num )
+{
+   FC_ASSERT( queue_depth > 0, "The replay queue depth must be positive" );
+   FC_ASSERT( first_block_num > 0 && first_block_num <= last_block_num );
+   if( decode_threads == 0 )
+      decode_threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+   _packed.reset( new packed_queue( queue_depth ) );
+   _slots.reset( new slot[queue_depth] );
+   try
+   {
+      _reader = std::thread( [this] () { read_loop(); } );
+      _decoders.reserve( decode_threads );
+      for( uint32_t i = 0; i < decode_threads; ++i )
+         _decoders.emplace_back( [this] () { decode_loop(); } );
+   }
+   catch( ... )
+   {
+      stop();
+      throw;
+   }
+}
+
+block_replay_pipeline::~block_replay_pipeline()
+{
+   stop();
+}
+
+void block_replay_pipeline::stop()
+{
+   _stopping = true;
+   if( _reader.joinable() )
+      _reader.join();
+   for( std::thread& decoder : _decoders )
+      decoder.join();
+   _decoders.clear();
+
+   packed_block* packed = nullptr;
+   while( _packed->pop( packed ) )
+      delete packed;
+}
+
+void block_replay_pipeline::read_loop()
+{
+   for( uint32_t block_num = _first_block_num; block_num <= _last_block_num; ++block_num )
+   {
+      // the slot of this block is free once the block a queue depth before it has been taken
+      backoff wait;
+      while( block_num - _next_block_num.load( std::memory_order_acquire ) >= _queue_depth && !_stopping )
+         wait();
+      if( _stopping )
+         break;
+
+      const fc::time_point start = fc::time_point::now();
+      std::unique_ptr<packed_block> packed( new packed_block() );
+      packed->block_num = block_num;
+      packed->found = _blocks.fetch_packed_by_number( block_num, packed->id, packed->data );
+      const bool found = packed->found;
+      _read_bytes += packed->data.size();
+      ++_read_blocks;
+      _read_us += ( fc::time_point::now() - start ).count();
+
+      while( !_packed->push( packed.get() ) && !_stopping )
+         wait();
+      if( _stopping )
+         break;
+      packed.release();
+      if( !found )
+         break;
+   }
+   _reading_done = true;
+}
+
+void block_replay_pipeline::decode_loop()
+{
+   backoff wait;
+   while( !_stopping )
+   {
+      // once reading is done, all blocks have been pushed completely and a failed pop means the queue is empty
+      const bool reading_done = _reading_done;
+      packed_block* popped = nullptr;
+      if( !_packed->pop( popped ) )
+      {
+         if( reading_done )
+            break;
+         wait();
+         continue;
+      }
+      wait = backoff();
+      std::unique_ptr<packed_block> packed( popped );
+
+      const fc::time_point start = fc::time_point::now();
+      optional<signed_block> block;
+      if( packed->found )
+      {
+         try
+         {
+            signed_block decoded;
+            fc::datastream<const char*> ds( packed->data.data(), packed->data.size() );
+            fc::raw::unpack( ds, decoded );
+            FC_ASSERT( decoded.id() == packed->id );
+            block = std::move( decoded );
+         }
+         catch( const fc::exception& )
+         {
+         }
+         catch( const std::exception& )
+         {
+         }
+      }
+      if( block.valid() )
+      {
+         // precomputations are repeated when the block is applied if they fail here
+         try
+         {
+            _precompute( *block );
+         }
+         catch( const fc::exception& )
+         {
+         }
+         catch( const std::exception& )
+         {
+         }
+      }
+      _decoded_bytes += packed->data.size();
+      ++_decoded_blocks;
+      _decode_us += ( fc::time_point::now() - start ).count();
+
+      slot& s = _slots[ packed->block_num % _queue_depth ];
+      s.block = std::move( block );
+      s.block_num.store( packed->block_num, std::memory_order_release );
+   }
+}
+
+optional<signed_block> block_replay_pipeline::next()
+{
+   const uint32_t block_num = _next_block_num.load( std::memory_order_relaxed );
+   FC_ASSERT( block_num <= _last_block_num, "No more blocks to replay" );
+
+   slot& s = _slots[ block_num % _queue_depth ];
+   if( s.block_num.load( std::memory_order_acquire ) != block_num )
+   {
+      const fc::time_point start = fc::time_point::now();
+      backoff wait;
+      while( s.block_num.load( std::memory_order_acquire ) != block_num )
+         wait();
+      _wait_us += ( fc::time_point::now() - start ).count();
+   }
+
+   // the pipeline ends at a block that could not be read, it is returned again by further calls
+   if( !s.block.valid() )
+      return optional<signed_block>();
+
+   optional<signed_block> result = std::move( s.block );
+   s.block.reset();
+   s.block_num.store( 0, std::memory_order_relaxed );
+   _next_block_num.store( block_num + 1, std::memory_order_release );
+   return result;
+}
+
+replay_stage_stats block_replay_pipeline::read_stats()const
+{
+   replay_stage_stats result;
+   result.blocks = _read_blocks.load();
+   result.bytes = _read_bytes.load();
+   result.busy = fc::microseconds( _read_us.load() );
+   return result;
+}
+
+replay_stage_stats block_replay_pipeline::decode_stats()const
+{
+   replay_stage_stats result;
+   result.blocks = _decoded_blocks.load();
+   result.bytes = _decoded_bytes.load();
+   result.busy = fc::microseconds( _decode_us.load() );
+   return result;
+}
+
+} } // graphene::chain
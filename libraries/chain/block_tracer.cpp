@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_tracer.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+void block_tracer::operation_timer::record()
+{
+   if( !_tracer._active || _type < 0 )
+      return;
+   auto& ops = _tracer._operations;
+   if( ops.size() <= uint64_t(_type) )
+      ops.resize( _type + 1 );
+   auto& op = ops[_type];
+   ++op.count;
+   op.time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - _start ).count();
+}
+
+void block_tracer::handler_timer::record()
+{
+   if( _tracer._active )
+      _tracer._current.handler_us[_name] += elapsed_us( _start );
+}
+
+void block_tracer::set_options( uint32_t capacity, uint32_t slow_block_ms )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _capacity = capacity;
+   _slow_block_us = uint64_t(slow_block_ms) * 1000;
+   while( _traces.size() > _capacity.load() )
+      _traces.pop_front();
+}
+
+void block_tracer::begin( const signed_block& block )
+{
+   _active = false;
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _capacity == 0 )
+      return;
+
+   _current = block_trace();
+   _current.block_num = block.block_num();
+   _current.block_id = block.id();
+   _current.transactions = block.transactions.size();
+   if( _precomputed_id == _current.block_id )
+      _current.precompute_us = _precompute_us;
+   _operations.clear();
+   _active = true;
+}
+
+void block_tracer::end()
+{
+   if( !_active )
+      return;
+   _active = false;
+
+   for( size_t type = 0; type < _operations.size(); ++type )
+   {
+      if( _operations[type].count == 0 )
+         continue;
+      _operations[type].type = type;
+      _current.operations.push_back( _operations[type] );
+   }
+
+   const uint64_t slow_block_us = _slow_block_us.load();
+   if( slow_block_us > 0 && _current.apply_us >= slow_block_us )
+   {
+      std::string handlers;
+      for( const auto& h : _current.handler_us )
+         handlers += " " + h.first + "=" + std::to_string( h.second / 1000 );
+      wlog( "Slow block #${n} ${id} with ${t} transactions took ${ms} ms to apply: header ${h}, "
+            "transactions ${trx}, updates ${u}, maintenance ${m}, expirations ${e}, applied_block ${ab}, "
+            "changed_objects ${co} ms, handlers (ms):${hs}",
+            ("n",_current.block_num)("id",_current.block_id)("t",_current.transactions)
+            ("ms",_current.apply_us / 1000)("h",_current.header_us / 1000)("trx",_current.transactions_us / 1000)
+            ("u",_current.updates_us / 1000)("m",_current.maintenance_us / 1000)
+            ("e",_current.expirations_us / 1000)("ab",_current.applied_block_us / 1000)
+            ("co",_current.changed_objects_us / 1000)("hs",handlers) );
+   }
+
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _capacity == 0 )
+      return;
+   while( _traces.size() >= _capacity.load() )
+      _traces.pop_front();
+   _traces.push_back( std::move( _current ) );
+}
+
+void block_tracer::record_precompute( const block_id_type& id, uint64_t us )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _precomputed_id = id;
+   _precompute_us = us;
+}
+
+void block_tracer::record_push( const block_id_type& id, uint64_t us )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( !_traces.empty() && _traces.back().block_id == id )
+      _traces.back().push_us = us;
+}
+
+std::vector<block_trace> block_tracer::get_traces( uint32_t limit )const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   std::vector<block_trace> result;
+   result.reserve( std::min<size_t>( limit, _traces.size() ) );
+   for( auto itr = _traces.rbegin(); itr != _traces.rend() && result.size() < limit; ++itr )
+      result.push_back( *itr );
+   return result;
+}
+
+} }
@@ -32,6 +32,7 @@
 
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/transaction_history_object.hpp>
+#include <graphene/chain/transaction_scheduler.hpp>
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/evaluator.hpp>
@@ -81,12 +82,96 @@ optional<signed_block> database::fetch_block_by_number( uint32_t num )const
       return _block_id_to_block.fetch_by_number(num);
 }
 
-const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
+block_cache::block_ptr database::fetch_shared_block_by_id( const block_id_type& id )const
+{
+   auto b = _fork_db.fetch_block( id );
+   if( !b )
+      return _block_id_to_block.fetch_shared(id);
+   return block_cache::block_ptr( b, &b->data );
+}
+
+block_cache::block_ptr database::fetch_shared_block_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return block_cache::block_ptr( results[0], &results[0]->data );
+   else
+      return _block_id_to_block.fetch_shared_by_number(num);
+}
+
+signed_transaction database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
    auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
    auto itr = index.find(trx_id);
    FC_ASSERT(itr != index.end());
-   return itr->trx;
+   optional<signed_transaction> result = find_recorded_transaction( *itr );
+   FC_ASSERT( result.valid(), "Transaction ${id} in block ${n} is not available any more",
+              ("id",trx_id)("n",itr->block_num) );
+   return std::move( *result );
+}
+
+optional<signed_transaction> database::find_recorded_transaction( const transaction_history_object& entry )const
+{
+   if( 0 == entry.block_num )
+   {
+      const processed_transaction* pending = _pending_tx.find( entry.trx_id );
+      if( pending == nullptr )
+         return optional<signed_transaction>();
+      return signed_transaction( *pending );
+   }
+   // blocks of competing forks may have the same number, the transaction ID tells which one is meant
+   for( const auto& item : _fork_db.fetch_block_by_number( entry.block_num ) )
+   {
+      const auto& trxs = item->data.transactions;
+      if( entry.trx_in_block < trxs.size() && trxs[entry.trx_in_block].id() == entry.trx_id )
+         return signed_transaction( trxs[entry.trx_in_block] );
+   }
+   const block_cache::block_ptr block = _block_id_to_block.fetch_shared_by_number( entry.block_num );
+   if( !block || entry.trx_in_block >= block->transactions.size()
+         || block->transactions[entry.trx_in_block].id() != entry.trx_id )
+      return optional<signed_transaction>();
+   return signed_transaction( block->transactions[entry.trx_in_block] );
+}
+
+void database::set_block_cache_size( uint32_t max_blocks )
+{
+   _block_id_to_block.set_cache_size( max_blocks );
+}
+
+block_cache_stats database::get_block_cache_stats()const
+{
+   return _block_id_to_block.get_cache_stats();
+}
+
+void database::set_block_log_pruning( uint32_t keep_blocks, uint32_t keep_days )
+{
+   _prune_keep_blocks = keep_blocks;
+   _prune_keep_days = keep_days;
+}
+
+uint32_t database::first_retained_block_num()const
+{
+   return _block_id_to_block.first_retained_block_num();
+}
+
+void database::prune_block_log()
+{
+   if( _prune_keep_blocks == 0 && _prune_keep_days == 0 )
+      return;
+
+   uint64_t keep = _prune_keep_blocks;
+   if( _prune_keep_days > 0 )
+      keep = std::max<uint64_t>( keep, uint64_t(_prune_keep_days) * 86400 / block_interval() );
+   // transactions that have not expired yet are looked up in the blocks that include them
+   keep = std::max<uint64_t>( keep, get_global_properties().parameters.maximum_time_until_expiration
+                                    / block_interval() + 1 );
+   const uint32_t head = head_block_num();
+   if( keep >= head )
+      return;
+   // never drop blocks that may still be popped
+   const uint32_t first_to_keep = std::min<uint32_t>( head - keep + 1,
+                                                      get_dynamic_global_properties().last_irreversible_block_num );
+   _block_id_to_block.prune( first_to_keep );
 }
 
 std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of_fork) const
@@ -120,18 +205,20 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
-      detail::without_pending_transactions( *this, std::move(_pending_tx),
+      detail::without_pending_transactions( *this, _pending_tx.release(),
       [&]()
       {
          result = _push_block(new_block);
       });
    });
+   prune_block_log();
    return result;
 }
 
 bool database::_push_block(const signed_block& new_block)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
+   const auto push_start = block_tracer::clock::now();
 
    const auto now = fc::time_point::now().sec_since_epoch();
    if( _fork_db.head() && new_block.timestamp.sec_since_epoch() > now - 86400 )
@@ -207,6 +294,7 @@ bool database::_push_block(const signed_block& new_block)
                   throw *except;
                }
          }
+         _block_tracer.record_push( new_block.id(), block_tracer::elapsed_us( push_start ) );
          return true;
       }
       else return false;
@@ -219,6 +307,7 @@ bool database::_push_block(const signed_block& new_block)
          update_witnesses( *new_head );
       _block_id_to_block.store(new_block.id(), new_block);
       session.commit();
+      _block_tracer.record_push( new_block.id(), block_tracer::elapsed_us( push_start ) );
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
       _fork_db.remove( new_block.id() );
@@ -257,6 +346,22 @@ void database::update_witnesses( fork_item& fork_entry )const
    }
 }
 
+namespace {
+   /// @return the packed size of a transaction in a block, i.e. without operation results
+   uint64_t block_transaction_size( uint64_t packed_size, const vector<signature_type>& signatures )
+   {
+      return packed_size + fc::raw::pack_size( signatures ) + 1; // + the size of empty operation results
+   }
+
+   struct fee_visitor
+   {
+      typedef std::pair<account_id_type,asset> result_type;
+
+      template<typename Op>
+      result_type operator()( const Op& op )const { return std::make_pair( op.fee_payer(), op.fee ); }
+   };
+}
+
 /**
  * Attempts to push the transaction into the pending queue
  *
@@ -270,6 +375,10 @@ processed_transaction database::push_transaction( const precomputable_transactio
 { try {
    // see https://github.com/bitshares/bitshares-core/issues/1573
    FC_ASSERT( fc::raw::pack_size( trx ) < (1024 * 1024), "Transaction exceeds maximum transaction size." );
+   // The new transaction may depend on deferred transactions of its fee payer, those are applied first. The others
+   // are left to reapply_deferred_transactions(), so that a transaction is not held up by all of them.
+   if( !_deferred_tx.empty() && !trx.operations.empty() )
+      reapply_deferred_transactions_of( trx.operations.front().visit( fee_visitor() ).first );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -283,7 +392,19 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
    if( !_pending_tx_session.valid() )
+   {
       _pending_tx_session = _undo_db.start_undo_session();
+      reset_candidate_block();
+      // transactions left without a pending state, e.g. by pop_block(), have not been applied to this one
+      _candidate_valid = _pending_tx.empty();
+   }
+
+   // Whether the transaction is admitted and which pending transactions it evicts is decided before applying it,
+   // so that nothing is evicted for a transaction that is not admitted.
+   const auto fee = get_core_fee( trx );
+   const uint64_t trx_size = block_transaction_size( trx.get_packed_size(), trx.signatures );
+   const uint64_t fee_per_kb = mempool::fee_per_kb( fee.second, trx_size );
+   const std::vector<uint64_t> evicted = _pending_tx.check_admission( fee.first, trx_size, fee_per_kb );
 
    // Create a temporary undo session as a child of _pending_tx_session.
    // The temporary session will be discarded by the destructor if
@@ -292,17 +413,160 @@ processed_transaction database::_push_transaction( const precomputable_transacti
 
    auto temp_session = _undo_db.start_undo_session();
    auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+
+   if( !evicted.empty() )
+   {
+      // The transaction has to apply without the transactions it evicts as well, if it does not they are kept.
+      temp_session.undo();
+      std::vector<transaction_id_type> failed = rebuild_pending_state( evicted );
+      temp_session = _undo_db.start_undo_session();
+      try {
+         processed_trx = _apply_transaction( trx );
+      } catch( const fc::exception& ) {
+         temp_session.undo();
+         failed = rebuild_pending_state();
+         for( const auto& id : failed )
+            _pending_tx.remove( id );
+         throw;
+      }
+      // the transactions that depend on the evicted ones are dropped with them
+      _pending_tx.evict( evicted );
+      for( const auto& id : failed )
+         _pending_tx.remove( id );
+   }
+   _pending_tx.insert( processed_trx, fee.first, trx_size, fee_per_kb );
 
    // notify_changed_objects();
-   // The transaction applied successfully. Merge its changes into the pending block session.
+   // Merge its changes into the pending block session.
    temp_session.merge();
+   _candidate_size += trx_size;
+   _candidate_skip |= get_node_properties().skip_flags;
 
    // notify anyone listening to pending transactions
    notify_on_pending_transaction( trx );
    return processed_trx;
 }
 
+std::pair<account_id_type,share_type> database::get_core_fee( const transaction& trx )const
+{
+   std::pair<account_id_type,share_type> result( account_id_type(), 0 );
+   for( auto itr = trx.operations.begin(); itr != trx.operations.end(); ++itr )
+   {
+      const auto fee = itr->visit( fee_visitor() );
+      if( itr == trx.operations.begin() )
+         result.first = fee.first;
+      share_type core_fee;
+      if( fee.second.asset_id == asset_id_type() )
+         core_fee = fee.second.amount;
+      else
+      {
+         // a fee whose conversion overflows counts as nothing, i.e. the lowest priority,
+         // whether it can be paid is checked when the transaction is applied
+         try {
+            core_fee = ( fee.second * fee.second.asset_id(*this).options.core_exchange_rate ).amount;
+         } catch( const fc::exception& ) {
+            core_fee = 0;
+         }
+      }
+      // saturated, so that the sum of many large fees does not overflow either
+      result.second = std::min<int64_t>( result.second.value + std::max<int64_t>( core_fee.value, 0 ),
+                                         GRAPHENE_MAX_SHARE_SUPPLY );
+   }
+   return result;
+}
+
+size_t database::reapply_deferred_transactions( size_t max_count )
+{
+   size_t expired = 0;
+   for( size_t count = 0; !_deferred_tx.empty() && ( max_count == 0 || count < max_count ); ++count )
+   {
+      const processed_transaction tx = std::move( _deferred_tx.front() );
+      _deferred_tx.pop_front();
+      reapply_deferred_transaction( tx, expired );
+   }
+   _pending_tx.record_expired( expired );
+   return _deferred_tx.size();
+}
+
+void database::reapply_deferred_transactions_of( account_id_type payer )
+{
+   size_t expired = 0;
+   for( auto itr = _deferred_tx.begin(); itr != _deferred_tx.end(); )
+   {
+      if( itr->operations.empty() || itr->operations.front().visit( fee_visitor() ).first != payer )
+      {
+         ++itr;
+         continue;
+      }
+      const processed_transaction tx = std::move( *itr );
+      itr = _deferred_tx.erase( itr );
+      reapply_deferred_transaction( tx, expired );
+   }
+   _pending_tx.record_expired( expired );
+}
+
+void database::reapply_deferred_transaction( const processed_transaction& tx, size_t& expired )
+{
+   if( is_known_transaction( tx.id() ) )
+      return;
+   if( tx.expiration < head_block_time() && head_block_num() > 0 )
+   {
+      ++expired;
+      return;
+   }
+   try {
+      _push_transaction( tx );
+   } catch( const fc::exception& ) { // ignore invalid transactions
+   }
+}
+
+mempool_stats database::get_mempool_stats()const
+{
+   mempool_stats result = _pending_tx.get_stats();
+   result.deferred = _deferred_tx.size();
+   return result;
+}
+
+std::vector<transaction_id_type> database::rebuild_pending_state( const std::vector<uint64_t>& excluded )
+{
+   _pending_tx_session.reset();
+   _pending_tx_session = _undo_db.start_undo_session();
+   reset_candidate_block();
+
+   std::vector<transaction_id_type> failed;
+   auto next_excluded = excluded.begin();
+   for( const auto& pending : _pending_tx.entries().get<mempool::by_arrival>() )
+   {
+      while( next_excluded != excluded.end() && *next_excluded < pending.seq )
+         ++next_excluded;
+      if( next_excluded != excluded.end() && *next_excluded == pending.seq )
+         continue;
+      try {
+         auto temp_session = _undo_db.start_undo_session();
+         _apply_transaction( pending.trx );
+         temp_session.merge();
+         _candidate_size += pending.size;
+      } catch( const fc::exception& ) {
+         failed.push_back( pending.id );
+      }
+   }
+   return failed;
+}
+
+void database::reset_candidate_block()
+{
+   _candidate_head = head_block_id();
+   _candidate_size = 0;
+   _candidate_skip = get_node_properties().skip_flags;
+   _candidate_valid = true;
+}
+
+bool database::use_candidate_block( uint32_t skip )const
+{
+   return _candidate_valid && _pending_tx_session.valid() && _candidate_head == head_block_id()
+          && ( _candidate_skip & ~skip ) == 0;
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
    auto session = _undo_db.start_undo_session();
@@ -402,6 +666,59 @@ signed_block database::_generate_block(
    witness_id_type scheduled_witness = get_scheduled_witness( slot_num );
    FC_ASSERT( scheduled_witness == witness_id );
 
+   static const size_t max_partial_block_header_size = ( fc::raw::pack_size( signed_block_header() )
+                                                       - fc::raw::pack_size( witness_id_type() ) ) // witness_id
+                                                       + 3; // max space to store size of transactions
+                                                            // (out of block header),
+                                                            // +3 means 3*7=21 bits so it's practically safe
+   const size_t max_block_header_size = max_partial_block_header_size + fc::raw::pack_size( witness_id );
+   auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
+   size_t total_block_size = max_block_header_size;
+
+   // Check witness signing key
+   if( 0 == (skip & skip_witness_signature) )
+      FC_ASSERT( witness_id(*this).signing_key == block_signing_private_key.get_public_key() );
+
+   auto finalize_and_push = [&]( signed_block& pending_block ) {
+      pending_block.previous = head_block_id();
+      pending_block.timestamp = when;
+      pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+      pending_block.witness = witness_id;
+
+      if( 0 == (skip & skip_witness_signature) )
+         pending_block.sign( block_signing_private_key );
+
+      push_block( pending_block, skip | skip_transaction_signatures ); // skip authority check when pushing
+                                                                       // self-generated blocks
+   };
+
+   //
+   // The pending state is built on top of the head block by applying the pending transactions as they arrive,
+   // with the same time-based semantics as in the next block. If all of them fit into the block, it only needs
+   // to be finalized. Otherwise, or if pushing it fails, the block is assembled below.
+   //
+   if( use_candidate_block( skip ) && total_block_size + _candidate_size <= maximum_block_size )
+   {
+      signed_block pending_block;
+      pending_block.transactions.reserve( _pending_tx.size() );
+      for( const auto& pending : _pending_tx.entries().get<mempool::by_arrival>() )
+      {
+         pending_block.transactions.push_back( pending.trx );
+         // Clear results to save disk space and network bandwidth.
+         pending_block.transactions.back().operation_results.clear();
+      }
+      try
+      {
+         finalize_and_push( pending_block );
+         return pending_block;
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Failed to push block built from the pending state, assembling it again: ${e}",
+               ("e", e.to_detail_string()) );
+      }
+   }
+
    //
    // The following code throws away existing pending_tx_session and
    // rebuilds it by re-applying pending transactions.
@@ -417,33 +734,19 @@ signed_block database::_generate_block(
    // pop pending state (reset to head block state)
    _pending_tx_session.reset();
 
-   // Check witness signing key
-   if( 0 == (skip & skip_witness_signature) )
-   {
-      // Note: if this check failed (which won't happen in normal situations),
-      // we would have temporarily broken the invariant that
-      // _pending_tx_session is the result of applying _pending_tx.
-      // In this case, when the node received a new block,
-      // the push_block() call will re-create the _pending_tx_session.
-      FC_ASSERT( witness_id(*this).signing_key == block_signing_private_key.get_public_key() );
-   }
-
-   static const size_t max_partial_block_header_size = ( fc::raw::pack_size( signed_block_header() )
-                                                       - fc::raw::pack_size( witness_id_type() ) ) // witness_id
-                                                       + 3; // max space to store size of transactions
-                                                            // (out of block header),
-                                                            // +3 means 3*7=21 bits so it's practically safe
-   const size_t max_block_header_size = max_partial_block_header_size + fc::raw::pack_size( witness_id );
-   auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
-   size_t total_block_size = max_block_header_size;
-
    signed_block pending_block;
 
    _pending_tx_session = _undo_db.start_undo_session();
 
-   uint64_t postponed_tx_count = 0;
-   for( const processed_transaction& tx : _pending_tx )
+   if( head_block_num() > 0 ) // transactions are applied at the time of the head block
+      _pending_tx.remove_expired( head_block_time() );
+   // If the pending transactions do not all fit into the block, those paying the highest fees per byte are
+   // selected. The selected transactions are applied in the order of their arrival.
+   const auto selected_tx = _pending_tx.select( maximum_block_size - max_block_header_size );
+   uint64_t postponed_tx_count = _pending_tx.size() - selected_tx.size();
+   for( const processed_transaction* selected : selected_tx )
    {
+      const processed_transaction& tx = *selected;
       size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
       // postpone transaction if it would make block too big
@@ -497,16 +800,7 @@ signed_block database::_generate_block(
    // However, the push_block() call below will re-create the
    // _pending_tx_session.
 
-   pending_block.previous = head_block_id();
-   pending_block.timestamp = when;
-   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
-   pending_block.witness = witness_id;
-
-   if( 0 == (skip & skip_witness_signature) )
-      pending_block.sign( block_signing_private_key );
-
-   push_block( pending_block, skip | skip_transaction_signatures ); // skip authority check when pushing
-                                                                    // self-generated blocks
+   finalize_and_push( pending_block );
 
    return pending_block;
 } FC_CAPTURE_AND_RETHROW( (witness_id) ) } // GCOVR_EXCL_LINE
@@ -528,6 +822,7 @@ void database::pop_block()
       FC_ASSERT( fork_db_head, "Trying to pop() block that's not in fork database!?" );
    }
    pop_undo();
+   _block_id_to_block.evict( fork_db_head->id );
    _popped_tx.insert( _popped_tx.begin(),
                       fork_db_head->data.transactions.begin(),
                       fork_db_head->data.transactions.end() );
@@ -535,8 +830,9 @@ void database::pop_block()
 
 void database::clear_pending()
 { try {
-   assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
+   assert( _pending_tx.empty() || _pending_tx_session.valid() );
    _pending_tx.clear();
+   _deferred_tx.clear();
    _pending_tx_session.reset();
 } FC_CAPTURE_AND_RETHROW() } // GCOVR_EXCL_LINE
 
@@ -592,6 +888,18 @@ void database::_apply_block( const signed_block& next_block )
    uint32_t skip = get_node_properties().skip_flags;
    _applied_ops.clear();
 
+   _block_tracer.begin( next_block );
+   // the trace is discarded if the block fails to apply
+   struct trace_guard
+   {
+      block_tracer& tracer;
+      ~trace_guard() { tracer.abort(); }
+   } guard{ _block_tracer };
+   block_trace discarded;
+   block_trace& trace = _block_tracer.current() ? *_block_tracer.current() : discarded;
+   const auto apply_start = block_tracer::clock::now();
+   block_tracer::phase_timer phases;
+
    if( 0 == (skip & skip_block_size_check) )
    {
       FC_ASSERT( fc::raw::pack_size(next_block) <= get_global_properties().parameters.maximum_block_size );
@@ -607,6 +915,7 @@ void database::_apply_block( const signed_block& next_block )
    const witness_object& signing_witness = validate_block_header(skip, next_block);
    const auto& dynamic_global_props = get_dynamic_global_properties();
    bool maint_needed = (dynamic_global_props.next_maintenance_time <= next_block.timestamp);
+   trace.maintenance = maint_needed;
 
    // trx_in_block starts from 0.
    // For real operations which are explicitly included in a transaction, op_in_trx starts from 0, virtual_op is 0.
@@ -621,30 +930,51 @@ void database::_apply_block( const signed_block& next_block )
 
    _issue_453_affected_assets.clear();
 
+   phases.end_phase( trace.header_us );
    signed_block processed_block( next_block ); // make a copy
-   for( auto& trx : processed_block.transactions )
+   auto& trxs = processed_block.transactions;
+   // The checks of the transactions of a run only read state that none of them writes before, so they can be done
+   // for a whole run before it is applied serially
+   const bool parallel_checks = _parallel_transaction_checks && trxs.size() > 1;
+   const std::vector<size_t> runs = parallel_checks ? schedule_check_runs( trxs ) : std::vector<size_t>();
+   std::vector<char> prechecked( trxs.size(), 0 );
+   size_t next_run = 0;
+   for( size_t i = 0; i < trxs.size(); ++i )
    {
+      if( next_run < runs.size() && runs[next_run] == i )
+      {
+         const size_t run_end = ( next_run + 1 < runs.size() ) ? runs[next_run + 1] : trxs.size();
+         if( run_end - i > 1 )
+            precheck_transactions( &trxs[i], &prechecked[i], run_end - i, skip );
+         ++next_run;
+      }
       /* We do not need to push the undo state for each transaction
        * because they either all apply and are valid or the
        * entire block fails to apply.  We only need an "undo" state
        * for transactions when validating broadcast transactions or
        * when building a block.
        */
-      trx.operation_results = apply_transaction( trx, skip ).operation_results;
+      trxs[i].operation_results = _apply_transaction( trxs[i], 0 != prechecked[i], true ).operation_results;
       ++_current_trx_in_block;
    }
 
    _current_op_in_trx    = 0;
    _current_virtual_op   = 0;
 
+   phases.end_phase( trace.transactions_us );
    const uint32_t missed = update_witness_missed_blocks( next_block );
    update_global_dynamic_data( next_block, missed );
    update_signing_witness(signing_witness, next_block);
    update_last_irreversible_block();
 
+   phases.end_phase( trace.updates_us );
+
    // Are we at the maintenance interval?
    if( maint_needed )
+   {
       perform_chain_maintenance( next_block );
+      phases.end_phase( trace.maintenance_us );
+   }
 
    create_block_summary(next_block);
    clear_expired_transactions();
@@ -655,6 +985,7 @@ void database::_apply_block( const signed_block& next_block )
    update_expired_feeds();       // this will update expired feeds and some core exchange rates
    update_core_exchange_rates(); // this will update remaining core exchange rates
    update_withdraw_permissions();
+   phases.end_phase( trace.expirations_us );
 
    // n.b., update_maintenance_flag() happens this late
    // because get_slot_time() / get_slot_at_time() is needed above
@@ -666,11 +997,26 @@ void database::_apply_block( const signed_block& next_block )
    if( !_node_property_object.debug_updates.empty() )
       apply_debug_updates();
 
+   if( _undo_db.enabled() && _undo_db.size() > 0 )
+   {
+      const auto& undo_state = _undo_db.head();
+      trace.undo_new = undo_state.new_ids.size();
+      trace.undo_modified = undo_state.old_values.size();
+      trace.undo_removed = undo_state.removed.size();
+   }
+
+   phases.end_phase( trace.updates_us );
+
    // notify observers that the block has been applied
    notify_applied_block( processed_block ); //emit
    _applied_ops.clear();
+   phases.end_phase( trace.applied_block_us );
 
    notify_changed_objects();
+   phases.end_phase( trace.changed_objects_us );
+
+   trace.apply_us = block_tracer::elapsed_us( apply_start );
+   _block_tracer.end();
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  } // GCOVR_EXCL_LINE
 
 /**
@@ -688,14 +1034,14 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+processed_transaction database::_apply_transaction( const signed_transaction& trx, bool prechecked, bool in_block )
 { try {
    uint32_t skip = get_node_properties().skip_flags;
 
-   trx.validate();
+   if( !prechecked )
+      trx.validate();
 
    auto& trx_idx = get_mutable_index_type<transaction_index>();
-   const chain_id_type& chain_id = get_chain_id();
    if( 0 == (skip & skip_transaction_dupe_check) )
    {
       GRAPHENE_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx.id()) == trx_idx.indices().get<by_trx_id>().end(),
@@ -707,14 +1053,8 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
 
-   if( 0 == (skip & skip_transaction_signatures) )
-   {
-      bool allow_non_immediate_owner = ( head_block_time() >= HARDFORK_CORE_584_TIME );
-      auto get_active = [this]( account_id_type id ) { return &id(*this).active; };
-      auto get_owner  = [this]( account_id_type id ) { return &id(*this).owner;  };
-      trx.verify_authority(chain_id, get_active, get_owner, allow_non_immediate_owner,
-                           get_global_properties().parameters.max_authority_depth);
-   }
+   if( !prechecked && 0 == (skip & skip_transaction_signatures) )
+      verify_transaction_authority( trx );
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
    //expired, and TaPoS makes no sense as no blocks exist.
@@ -740,11 +1080,17 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    }
 
    //Insert transaction into unique transactions database.
-   if( 0 == (skip & skip_transaction_dupe_check) )
+   if( 0 == (skip & skip_transaction_dupe_check)
+       || ( _dedupe_history_start.valid() && trx.expiration >= *_dedupe_history_start ) )
    {
-      create<transaction_history_object>([&trx](transaction_history_object& transaction) {
+      create<transaction_history_object>([this,&trx,in_block](transaction_history_object& transaction) {
          transaction.trx_id = trx.id();
-         transaction.trx = trx;
+         transaction.expiration = trx.expiration;
+         if( in_block )
+         {
+            transaction.block_num = _current_block_num;
+            transaction.trx_in_block = _current_trx_in_block;
+         }
       });
    }
 
@@ -764,6 +1110,63 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    return ptrx;
 } FC_CAPTURE_AND_RETHROW( (trx) ) } // GCOVR_EXCL_LINE
 
+void database::verify_transaction_authority( const signed_transaction& trx )const
+{
+   bool allow_non_immediate_owner = ( head_block_time() >= HARDFORK_CORE_584_TIME );
+   const uint32_t max_depth = get_global_properties().parameters.max_authority_depth;
+   auto cached = _authority_cache.find( trx, allow_non_immediate_owner, max_depth, *_authority_versions );
+   if( cached.verified )
+      return;
+
+   // remember the accounts whose authorities are involved, the result holds until one of them changes
+   flat_set<account_id_type> accounts;
+   auto get_active = [this,&accounts]( account_id_type id ) { accounts.insert( id ); return &id(*this).active; };
+   auto get_owner  = [this,&accounts]( account_id_type id ) { accounts.insert( id ); return &id(*this).owner;  };
+   if( cached.keys.valid() )
+   {
+      try {
+         graphene::protocol::verify_authority( trx.operations, *cached.keys, get_active, get_owner,
+                                               allow_non_immediate_owner, max_depth );
+      } FC_CAPTURE_AND_RETHROW( (trx) ) // GCOVR_EXCL_LINE
+   }
+   else
+      trx.verify_authority( get_chain_id(), get_active, get_owner, allow_non_immediate_owner, max_depth );
+   _authority_cache.insert( trx, cached.keys.valid() ? *cached.keys : trx.get_signature_keys( get_chain_id() ),
+                            std::move( accounts ), _authority_versions->current_version(),
+                            allow_non_immediate_owner, max_depth );
+}
+
+void database::precheck_transactions( const processed_transaction* trxs, char* prechecked, size_t count,
+                                      uint32_t skip )const
+{
+   auto check = [this,trxs,prechecked,skip]( size_t first, size_t last ) {
+      for( size_t i = first; i < last; ++i )
+      {
+         try {
+            trxs[i].validate();
+            if( 0 == (skip & skip_transaction_signatures) )
+               verify_transaction_authority( trxs[i] );
+            prechecked[i] = 1;
+         } catch( const fc::exception& ) {
+            // checked again when applied
+         } catch( const std::exception& ) {
+         }
+      }
+   };
+
+   const size_t chunks = std::min<size_t>( count, fc::asio::default_io_service_scope::get_num_threads() );
+   const size_t chunk_size = ( count + chunks - 1 ) / chunks;
+   std::vector<fc::future<void>> workers;
+   workers.reserve( chunks );
+   for( size_t first = chunk_size; first < count; first += chunk_size )
+      workers.push_back( fc::do_parallel( [&check,first,chunk_size,count] () {
+         check( first, std::min( first + chunk_size, count ) );
+      }) );
+   check( 0, std::min( chunk_size, count ) );
+   for( auto& worker : workers )
+      worker.wait();
+}
+
 operation_result database::apply_operation( transaction_evaluation_state& eval_state, const operation& op,
                                             bool is_virtual /* = true */ )
 { try {
@@ -774,6 +1177,7 @@ operation_result database::apply_operation( transaction_evaluation_state& eval_s
    unique_ptr<op_evaluator>& eval = _operation_evaluators[ u_which ];
    FC_ASSERT( eval, "No registered evaluator for operation ${op}", ("op",op) );
    auto op_id = push_applied_operation( op, is_virtual );
+   block_tracer::operation_timer timer( _block_tracer, i_which );
    auto result = eval->evaluate( eval_state, op, true );
    set_applied_operation_result( op_id, result );
    return result;
@@ -835,14 +1239,47 @@ void database::_precompute_parallel( const Trx* trx, const size_t count, const u
          trx->get_packed_size();
       if( 0 == (skip&skip_transaction_dupe_check) )
          trx->id();
-      if( 0 == (skip&skip_transaction_signatures) )
+      if( 0 == (skip&skip_transaction_signatures) && !_authority_cache.contains( *trx ) )
          trx->get_signature_keys( get_chain_id() );
    }
 }
 
+void database::precompute_block( const signed_block& block, const uint32_t skip )const
+{
+   if( !block.transactions.empty() )
+      _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+   if( 0 == (skip&skip_witness_signature) )
+      block.signee();
+   if( 0 == (skip&skip_merkle_check) )
+      block.calculate_merkle_root();
+   block.id();
+}
+
 fc::future<void> database::precompute_parallel( const signed_block& block, const uint32_t skip )const
 { try {
+   // The precomputations take until the last of their parts is done, on whichever thread that is. That part
+   // records how long they took, unless tracing is disabled.
+   struct precompute_timing
+   {
+      const block_tracer::clock::time_point start = block_tracer::clock::now();
+      std::atomic<size_t>                   pending{ 1 }; // the part done on this thread
+   };
+   const block_id_type block_id = block.id();
+   const auto timing = _block_tracer.enabled() ? std::make_shared<precompute_timing>() : nullptr;
+   auto part_done = [this,block_id,timing] () {
+      if( timing && --timing->pending == 0 )
+         _block_tracer.record_precompute( block_id, block_tracer::elapsed_us( timing->start ) );
+   };
    std::vector<fc::future<void>> workers;
+   auto spawn = [&workers,&timing,&part_done] ( std::function<void()> work ) {
+      if( timing )
+         ++timing->pending;
+      workers.push_back( fc::do_parallel( [work,part_done] () {
+         work();
+         part_done();
+      }) );
+   };
+
    if( !block.transactions.empty() )
    {
       if( (skip & skip_expensive) == skip_expensive )
@@ -853,20 +1290,20 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
          uint32_t chunk_size = ( block.transactions.size() + chunks - 1 ) / chunks;
          workers.reserve( chunks + 1 );
          for( size_t base = 0; base < block.transactions.size(); base += chunk_size )
-            workers.push_back( fc::do_parallel( [this,&block,base,chunk_size,skip] () {
+            spawn( [this,&block,base,chunk_size,skip] () {
                _precompute_parallel( &block.transactions[base],
                                      ( ( base + chunk_size ) < block.transactions.size() ) ? chunk_size
                                                  : ( block.transactions.size() - base ),
                                      skip );
-            }) );
+            } );
       }
    }
 
    if( 0 == (skip&skip_witness_signature) )
-      workers.push_back( fc::do_parallel( [&block] () { block.signee(); } ) );
+      spawn( [&block] () { block.signee(); } );
    if( 0 == (skip&skip_merkle_check) )
       block.calculate_merkle_root();
-   block.id();
+   part_done();
 
    if( workers.empty() )
       return fc::future< void >( fc::promise< void >::create( true ) );
@@ -126,42 +126,64 @@ void database::initialize_evaluators()
 void database::initialize_indexes()
 {
    reset_indexes();
+   _expiration_scheduler.clear();
+   _margin_call_watcher.clear();
+   // verdicts may depend on changes that are undone
+   _undo_db.set_undo_callback( [this]() { _margin_call_watcher.clear(); } );
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
 
    //Protocol object indexes
-   add_index< primary_index<asset_index, 13> >(); // 8192 assets per chunk
+   add_index< primary_index<asset_index> >();
    add_index< primary_index<force_settlement_index> >();
 
-   auto acnt_index = add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
+   auto acnt_index = add_index< primary_index<account_index> >();
    acnt_index->add_secondary_index<account_member_index>();
    acnt_index->add_secondary_index<account_referrer_index>();
+   _authority_versions = acnt_index->add_secondary_index<account_authority_version_index>();
+   _authority_cache.clear();
 
    add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
    add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
-   add_index< primary_index<limit_order_index > >();
-   add_index< primary_index<call_order_index > >();
+   auto limit_index = add_index< primary_index<limit_order_index > >();
+   limit_index->add_secondary_index< expiration_schedule_index< limit_order_object,
+         member< limit_order_object, time_point_sec, &limit_order_object::expiration > > >( &_expiration_scheduler );
+   _limit_order_books = limit_index->add_secondary_index<limit_order_book_index>();
+   limit_index->add_secondary_index<margin_call_limit_order_index>( &_margin_call_watcher );
+   auto call_index = add_index< primary_index<call_order_index > >();
+   call_index->add_secondary_index<margin_call_call_order_index>( &_margin_call_watcher );
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
+   prop_index->add_secondary_index< expiration_schedule_index< proposal_object,
+         member< proposal_object, time_point_sec, &proposal_object::expiration_time > > >( &_expiration_scheduler );
 
-   add_index< primary_index<withdraw_permission_index > >();
+   auto permit_index = add_index< primary_index<withdraw_permission_index > >();
+   permit_index->add_secondary_index< expiration_schedule_index< withdraw_permission_object,
+         member< withdraw_permission_object, time_point_sec, &withdraw_permission_object::expiration > > >(
+               &_expiration_scheduler );
    add_index< primary_index<vesting_balance_index> >();
    add_index< primary_index<worker_index> >();
    add_index< primary_index<balance_index> >();
    add_index< primary_index<blinded_balance_index> >();
-   add_index< primary_index< htlc_index> >();
+   auto htlc_idx = add_index< primary_index< htlc_index> >();
+   htlc_idx->add_secondary_index< expiration_schedule_index< htlc_object, htlc_object::timelock_extractor > >(
+         &_expiration_scheduler );
 
    //Implementation object indexes
-   add_index< primary_index<transaction_index                             > >();
+   auto trx_index = add_index< primary_index<transaction_index                             > >();
+   trx_index->add_secondary_index< expiration_schedule_index< transaction_history_object,
+         member< transaction_history_object, time_point_sec, &transaction_history_object::expiration > > >(
+               &_expiration_scheduler );
 
    auto bal_idx = add_index< primary_index<account_balance_index          > >();
    bal_idx->add_secondary_index<balances_by_account_index>();
 
-   add_index< primary_index<asset_bitasset_data_index,                 13 > >(); // 8192
+   auto bitasset_index = add_index< primary_index<asset_bitasset_data_index, 13 > >(); // 8192
+   bitasset_index->add_secondary_index<margin_call_bitasset_index>( &_margin_call_watcher );
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<account_stats_index,                       20 > >(); // 1 Mi
-   add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
+   add_index< primary_index<account_stats_index                           > >();
+   add_index< primary_index<asset_dynamic_data_index                      > >();
    add_index< primary_index<simple_index<block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
    add_index< primary_index<simple_index<witness_schedule_object        > > >();
@@ -23,6 +23,7 @@
  */
 
 #include <fc/uint128.hpp>
+#include <fc/thread/parallel.hpp>
 
 #include <graphene/protocol/market.hpp>
 
@@ -963,6 +964,7 @@ void database::process_bitassets()
             if( feed_time < calculated )
                o.feeds.erase( itr.base() ); // delete expired feed
          }
+         // Note: the deleted feeds are not alive, the next update compares the tracked median feeds with the feeds
          // Note: we don't update current_feed here, and the update_expired_feeds() call is a bit too late,
          //       so theoretically there could be an inconsistency between active feeds and current_feed.
          //       And note that the next step "process_bids()" is based on current_feed.
@@ -1182,6 +1184,42 @@ void process_hf_935( database& db )
    }
 }
 
+/// Adds @p voting_stake to the votes of the objects @p opinion_account votes for
+static void add_votes( const account_object& opinion_account, uint64_t voting_stake, vector<uint64_t>& tally )
+{
+   for( vote_id_type id : opinion_account.options.votes )
+   {
+      uint32_t offset = id.instance();
+      // if they somehow managed to specify an illegal offset, ignore it.
+      if( offset < tally.size() )
+         tally[offset] += voting_stake;
+   }
+}
+
+void database::tally_votes( const vector<std::pair<const account_object*, uint64_t>>& voters )
+{
+   // Each chunk of voters is tallied by a thread into a partial tally of its own. Once all chunks are done, the
+   // partial tallies are added in the order of the chunks, so the result does not depend on thread scheduling.
+   const size_t chunks = std::max<size_t>( 1, std::min<size_t>( voters.size() / min_voters_per_tally_chunk,
+                                                  fc::asio::default_io_service_scope::get_num_threads() ) );
+   const size_t chunk_size = ( voters.size() + chunks - 1 ) / chunks;
+   vector<vector<uint64_t>> partial_tallies( chunks, vector<uint64_t>( _vote_tally_buffer.size() ) );
+   std::vector<fc::future<void>> workers;
+   workers.reserve( chunks );
+   for( size_t c = 0; c < chunks; ++c )
+      workers.push_back( fc::do_parallel( [&voters,&partial_tallies,c,chunk_size] () {
+         const size_t last = std::min( ( c + 1 ) * chunk_size, voters.size() );
+         for( size_t i = c * chunk_size; i < last; ++i )
+            add_votes( *voters[i].first, voters[i].second, partial_tallies[c] );
+      }) );
+   for( auto& worker : workers )
+      worker.wait();
+
+   for( const auto& partial_tally : partial_tallies )
+      for( size_t offset = 0; offset < partial_tally.size(); ++offset )
+         _vote_tally_buffer[offset] += partial_tally[offset];
+}
+
 void database::perform_chain_maintenance(const signed_block& next_block)
 {
    const auto& gpo = get_global_properties();
@@ -1193,9 +1231,11 @@ void database::perform_chain_maintenance(const signed_block& next_block)
    struct vote_tally_helper {
       database& d;
       const global_property_object& props;
+      vector<std::pair<const account_object*, uint64_t>>& voters;
 
-      vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
+      vote_tally_helper(database& d, const global_property_object& gpo,
+                        vector<std::pair<const account_object*, uint64_t>>& voters)
+         : d(d), props(gpo), voters(voters)
       {
          d._vote_tally_buffer.resize(props.next_available_vote_id);
          d._witness_count_histogram_buffer.resize(props.parameters.maximum_witness_count / 2 + 1);
@@ -1219,13 +1259,11 @@ void database::perform_chain_maintenance(const signed_block& next_block)
                   + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
                   + stats.core_in_balance.value;
 
-            for( vote_id_type id : opinion_account.options.votes )
-            {
-               uint32_t offset = id.instance();
-               // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake;
-            }
+            if( d._parallel_vote_tally )
+               // the votes are tallied after all accounts have been visited, see tally_votes()
+               voters.emplace_back( &opinion_account, voting_stake );
+            else
+               add_votes( opinion_account, voting_stake, d._vote_tally_buffer );
 
             if( opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
             {
@@ -1255,9 +1293,14 @@ void database::perform_chain_maintenance(const signed_block& next_block)
       }
    };
    
-   vote_tally_helper tally_helper(*this, gpo);
+   vector<std::pair<const account_object*, uint64_t>> voters;
+   if( _parallel_vote_tally )
+      voters.reserve( get_index_type<account_index>().indices().size() );
+   vote_tally_helper tally_helper(*this, gpo, voters);
 
    perform_account_maintenance( tally_helper );
+   if( _parallel_vote_tally )
+      tally_votes( voters );
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -35,9 +35,9 @@
 
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
-#include <queue>
-#include <tuple>
+#include <sstream>
 
 namespace graphene { namespace chain {
 
@@ -62,6 +62,12 @@ void database::reindex( fc::path data_dir )
    }
    if( last_block->block_num() <= head_block_num()) return;
 
+   const uint32_t first_retained = _block_id_to_block.first_retained_block_num();
+   FC_ASSERT( head_block_num() + 1 >= first_retained,
+              "The block log has been pruned, blocks before ${first} are not available to replay from block ${next}. "
+              "Resync from scratch or restore an object database that is at least at block ${last}",
+              ("first",first_retained)("next",head_block_num() + 1)("last",first_retained - 1) );
+
    ilog( "reindexing blockchain" );
    auto start = fc::time_point::now();
    const auto last_block_num = last_block->block_num();
@@ -76,69 +82,92 @@ void database::reindex( fc::path data_dir )
    else
       _undo_db.disable();
 
-   uint32_t skip = node_properties().skip_flags;
+   // Blocks up to the last checkpoint are applied without checks by apply_block(), which only compares the
+   // checkpointed blocks themselves. With a trusted replay, only the merkle roots of these blocks are computed
+   // ahead, and each one is checked to link to the previous one and to match its merkle root right before it is
+   // applied. Duplicate checks are skipped for them as well, so their transactions that have not expired at the
+   // last of them are recorded.
+   uint32_t trusted_end = 0;
+   if( _trusted_replay && !_checkpoints.empty() && _checkpoints.rbegin()->second != block_id_type()
+         && _checkpoints.rbegin()->first > head_block_num() )
+   {
+      trusted_end = std::min( _checkpoints.rbegin()->first, last_block_num );
+      const auto trusted_last = _block_id_to_block.fetch_shared_by_number( trusted_end );
+      _dedupe_history_start = trusted_last ? trusted_last->timestamp : fc::time_point_sec();
+   }
+
+   const uint32_t skip = node_properties().skip_flags;
+   // transactions that may not have expired yet are checked for duplicates
+   const fc::time_point_sec dupe_check_start = last_block->timestamp
+                                               - get_global_properties().parameters.maximum_time_until_expiration;
+   auto block_skip = [skip,dupe_check_start]( const signed_block& block ) {
+      return block.timestamp >= dupe_check_start ? ( skip & (uint32_t)(~skip_transaction_dupe_check) ) : skip;
+   };
+   auto format = []( double value ) {
+      std::stringstream ss;
+      ss << std::fixed << std::setprecision(1) << value;
+      return ss.str();
+   };
 
-   size_t total_block_size = _block_id_to_block.total_block_size();
-   const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
-   uint32_t next_block_num = head_block_num() + 1;
-   uint32_t i = next_block_num;
-   while( next_block_num <= last_block_num || !blocks.empty() )
+   // Blocks are read and decoded by the threads of the pipeline, the main thread only applies them
+   const uint32_t next_block_num = head_block_num() + 1;
+   uint32_t gap = 0;
+   replay_stage_stats read_total;
+   fc::microseconds wait_total;
    {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+      block_replay_pipeline pipeline( _block_id_to_block, next_block_num, last_block_num, _replay_queue_depth,
+                                      _replay_decode_threads,
+                                      [this,&block_skip,trusted_end]( const signed_block& block ) {
+                                         if( block.block_num() <= trusted_end )
+                                            precompute_block( block, ~skip_merkle_check );
+                                         else
+                                            precompute_block( block, block_skip( block ) );
+                                      } );
+      ilog( "Reading ahead up to ${d} blocks, decoding on ${t} threads",
+            ("d",_replay_queue_depth)("t",pipeline.decode_threads()) );
+
+      fc::time_point report_time = start;
+      uint32_t report_block_num = head_block_num();
+      replay_stage_stats last_read;
+      replay_stage_stats last_decode;
+      fc::microseconds last_wait;
+      fc::time_point trusted_done = start;
+      for( uint32_t i = next_block_num; i <= last_block_num; ++i )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num );
-         ++next_block_num;
-         if( block.valid() )
-         {
-            if( block->timestamp >= (last_block->timestamp - gpo.parameters.maximum_time_until_expiration) )
-               skip &= (uint32_t)(~skip_transaction_dupe_check);
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
-         }
-         else
+         const optional<signed_block> block = pipeline.next();
+         if( !block.valid() )
          {
-            wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-            uint32_t dropped_count = 0;
-            while( true )
-            {
-               fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-               // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-               // OR
-               // we've caught up to the gap
-               if( !last_id.valid() || block_header::num_from_id( *last_id ) <= i )
-                  break;
-               _block_id_to_block.remove( *last_id );
-               ++dropped_count;
-            }
-            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-            next_block_num = last_block_num + 1; // don't load more blocks
+            gap = i;
+            break;
          }
-      }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
 
          if( i % 10000 == 0 )
          {
-            std::stringstream bysize;
-            std::stringstream bynum;
-            size_t current_pos = std::get<0>(blocks.front());
-            if( current_pos > total_block_size )
-               total_block_size = current_pos;
-            bysize << std::fixed << std::setprecision(5) << (100 * double(current_pos) / total_block_size);
-            bynum << std::fixed << std::setprecision(5) << (100 * double(i) / last_block_num);
+            const fc::time_point now = fc::time_point::now();
+            const double elapsed_us = std::max<double>( (now - report_time).count(), 1 );
+            const replay_stage_stats read = pipeline.read_stats();
+            const replay_stage_stats decode = pipeline.decode_stats();
+            const fc::microseconds wait = pipeline.wait_time();
             ilog(
-               "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]",
-               ("size", bysize.str())
-               ("processed", current_pos)
-               ("total", total_block_size)
-               ("num", bynum.str())
+               "   [${num}%   ${i} of ${last}]   read: ${read} blocks/s, ${mib} MiB/s, ${read_busy}% busy   "
+               "decode: ${decode} blocks/s, ${decode_busy}% busy   apply: ${apply} blocks/s, ${apply_wait}% waiting",
+               ("num", format(100 * double(i) / last_block_num))
                ("i", i)
                ("last", last_block_num)
+               ("read", format(1000000 * double(read.blocks - last_read.blocks) / elapsed_us))
+               ("mib", format(1000000 * double(read.bytes - last_read.bytes) / elapsed_us / (1024 * 1024)))
+               ("read_busy", format(100 * double((read.busy - last_read.busy).count()) / elapsed_us))
+               ("decode", format(1000000 * double(decode.blocks - last_decode.blocks) / elapsed_us))
+               ("decode_busy", format(100 * double((decode.busy - last_decode.busy).count())
+                                          / elapsed_us / pipeline.decode_threads()))
+               ("apply", format(1000000 * double(i - report_block_num) / elapsed_us))
+               ("apply_wait", format(100 * double((wait - last_wait).count()) / elapsed_us))
             );
+            report_time = now;
+            report_block_num = i;
+            last_read = read;
+            last_decode = decode;
+            last_wait = wait;
          }
          if( i == undo_point )
          {
@@ -146,22 +175,81 @@ void database::reindex( fc::path data_dir )
             flush();
             ilog( "Done writing object database to disk" );
          }
+         if( i <= trusted_end )
+         {
+            FC_ASSERT( block->previous == head_block_id(),
+                       "Block ${i} in the block log does not link to the previous block", ("i", i) );
+            FC_ASSERT( block->calculate_merkle_root() == block->transaction_merkle_root,
+                       "Block ${i} in the block log does not match its merkle root", ("i", i) );
+         }
          if( i < undo_point )
-            apply_block( block, skip );
+            apply_block( *block, block_skip( *block ) );
          else
          {
             _undo_db.enable();
-            push_block( block, skip );
+            push_block( *block, block_skip( *block ) );
+         }
+         if( i == trusted_end )
+         {
+            _dedupe_history_start.reset();
+            trusted_done = fc::time_point::now();
          }
-         blocks.pop();
-         ++i;
       }
+      read_total = pipeline.read_stats();
+      wait_total = pipeline.wait_time();
+
+      if( trusted_end > 0 && gap == 0 )
+      {
+         const uint32_t trusted_count = trusted_end - ( next_block_num - 1 );
+         const double trusted_rate = 1000000 * double(trusted_count)
+                                     / std::max<double>( (trusted_done - start).count(), 1 );
+         ilog( "Trusted replay of ${n} blocks took ${t} sec, ${r} blocks/s",
+               ("n",trusted_count)("t",double((trusted_done - start).count())/1000000.0)("r",format(trusted_rate)) );
+         if( trusted_end < last_block_num )
+         {
+            const double checked_rate = 1000000 * double(last_block_num - trusted_end)
+                                        / std::max<double>( (fc::time_point::now() - trusted_done).count(), 1 );
+            ilog( "Replay of the remaining ${n} blocks with the configured checks ran at ${r} blocks/s, "
+                  "the trusted replay was ${x} times as fast",
+                  ("n",last_block_num - trusted_end)("r",format(checked_rate))
+                  ("x",format(trusted_rate / checked_rate)) );
+         }
+      }
+   }
+   _dedupe_history_start.reset();
+
+   if( gap > 0 )
+   {
+      wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", gap) );
+      uint32_t dropped_count = 0;
+      while( true )
+      {
+         fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+         // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+         // OR
+         // we've caught up to the gap
+         if( !last_id.valid() || block_header::num_from_id( *last_id ) < gap )
+            break;
+         _block_id_to_block.remove( *last_id );
+         ++dropped_count;
+      }
+      wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
    }
    _undo_db.enable();
    auto end = fc::time_point::now();
-   ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+   ilog( "Done reindexing, elapsed time: ${t} sec, read ${mib} MiB, waited ${w} sec for blocks to be decoded",
+         ("t",double((end-start).count())/1000000.0)
+         ("mib",format(double(read_total.bytes) / (1024 * 1024)))
+         ("w",double(wait_total.count())/1000000.0) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) } // GCOVR_EXCL_LINE
 
+void database::set_replay_pipeline( uint32_t queue_depth, uint32_t decode_threads )
+{
+   FC_ASSERT( queue_depth > 0, "The replay queue depth must be positive" );
+   _replay_queue_depth = queue_depth;
+   _replay_decode_threads = decode_threads;
+}
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
@@ -267,6 +355,7 @@ void database::close(bool rewinding)
    ilog( "Done writing object database to disk" );
 
    object_database::close();
+   _authority_cache.clear();
 
    if( _block_id_to_block.is_open() )
       _block_id_to_block.close();
@@ -355,7 +355,7 @@ bool database::apply_order_before_hardfork_625(const limit_order_object& new_ord
    if( called_some && !find_object(order_id) ) // then we were filled by call order
       return true;
 
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
+   const limit_order_book_index& limit_price_idx = *_limit_order_books;
 
    // TODO: it should be possible to simply check the NEXT/PREV iterator after new_order_object to
    // determine whether or not this order has "changed the book" in a way that requires us to
@@ -400,18 +400,13 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
    asset_id_type recv_asset_id = new_order_object.receive_asset_id();
 
    // We only need to check if the new order will match with others if it is at the front of the book
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
-   auto limit_itr = limit_price_idx.lower_bound( boost::make_tuple( new_order_object.sell_price, order_id ) );
-   if( limit_itr != limit_price_idx.begin() )
-   {
-      --limit_itr;
-      if( limit_itr->sell_asset_id() == sell_asset_id && limit_itr->receive_asset_id() == recv_asset_id )
-         return false;
-   }
+   const limit_order_book_index& limit_price_idx = *_limit_order_books;
+   if( limit_price_idx.begin( sell_asset_id, recv_asset_id )->id != order_id )
+      return false;
 
    // this is the opposite side (on the book)
    auto max_price = ~new_order_object.sell_price;
-   limit_itr = limit_price_idx.lower_bound( max_price.max() );
+   auto limit_itr = limit_price_idx.lower_bound( max_price.max() );
    auto limit_end = limit_price_idx.upper_bound( max_price );
 
    // Order matching should be in favor of the taker.
@@ -486,7 +481,7 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
       {
          // check if there are margin calls
          const auto& call_collateral_idx = get_index_type<call_order_index>().indices().get<by_collateral>();
-         auto call_min = price::min( recv_asset_id, sell_asset_id );
+         const price_sort_key call_min( price::min( recv_asset_id, sell_asset_id ) );
          while( !finished )
          {
             // hard fork core-343 and core-625 took place at same time,
@@ -513,7 +508,7 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
       {
          // check if there are margin calls
          const auto& call_price_idx = get_index_type<call_order_index>().indices().get<by_price>();
-         auto call_min = price::min( recv_asset_id, sell_asset_id );
+         const price_sort_key call_min( price::min( recv_asset_id, sell_asset_id ) );
          while( !finished )
          {
             // assume hard fork core-343 and core-625 will take place at same time, always check call order with least call_price
@@ -1003,14 +998,24 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
 
     const asset_bitasset_data_object& bitasset = ( bitasset_ptr ? *bitasset_ptr : mia.bitasset_data(*this) );
 
+    // nothing that margin calls depend on changed since a check found nothing to do
+    if( _margin_call_watcher.is_quiet( bitasset.asset_id, maint_time, head_block_time() ) )
+       return false;
+
     if( check_for_blackswan( mia, enable_black_swan, &bitasset ) )
        return false;
 
-    if( bitasset.is_prediction_market ) return false;
-    if( bitasset.current_feed.settlement_price.is_null() ) return false;
+    // Returns false when nothing was called and nothing changed, which is the case at every return below while
+    // margin_called is false. Until the best orders or the feed change, checks of the market can be skipped.
+    auto quiet = [this,&bitasset]() {
+       _margin_call_watcher.set_quiet( *this, bitasset );
+       return false;
+    };
+
+    if( bitasset.is_prediction_market ) return quiet();
+    if( bitasset.current_feed.settlement_price.is_null() ) return quiet();
 
-    const limit_order_index& limit_index = get_index_type<limit_order_index>();
-    const auto& limit_price_index = limit_index.indices().get<by_price>();
+    const limit_order_book_index& limit_price_index = *_limit_order_books;
 
     bool before_core_hardfork_1270 = ( maint_time <= HARDFORK_CORE_1270_TIME ); // call price caching issue
 
@@ -1025,14 +1030,14 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
     auto limit_end = limit_price_index.upper_bound( min_price );
 
     if( limit_itr == limit_end )
-       return false;
+       return quiet();
 
     const call_order_index& call_index = get_index_type<call_order_index>();
     const auto& call_price_index = call_index.indices().get<by_price>();
     const auto& call_collateral_index = call_index.indices().get<by_collateral>();
 
-    auto call_min = price::min( bitasset.options.short_backing_asset, bitasset.asset_id );
-    auto call_max = price::max( bitasset.options.short_backing_asset, bitasset.asset_id );
+    const price_sort_key call_min( price::min( bitasset.options.short_backing_asset, bitasset.asset_id ) );
+    const price_sort_key call_max( price::max( bitasset.options.short_backing_asset, bitasset.asset_id ) );
 
     auto call_price_itr = call_price_index.begin();
     auto call_price_end = call_price_itr;
@@ -1079,7 +1084,7 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
        if( ( !before_core_hardfork_1270 && bitasset.current_maintenance_collateralization < call_order.collateralization() )
              || ( before_core_hardfork_1270
                    && after_hardfork_436 && bitasset.current_feed.settlement_price > ~call_order.call_price ) )
-          return margin_called;
+          return margin_called || quiet();
 
        const limit_order_object& limit_order = *limit_itr;
        price match_price  = limit_order.sell_price;
@@ -1087,7 +1092,7 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
 
        // Old rule: margin calls can only buy high https://github.com/bitshares/bitshares-core/issues/606
        if( before_core_hardfork_606 && match_price > ~call_order.call_price )
-          return margin_called;
+          return margin_called || quiet();
 
        margin_called = true;
 
@@ -1194,7 +1199,7 @@ bool database::check_call_orders( const asset_object& mia, bool enable_black_swa
 
     } // while call_itr != call_end
 
-    return margin_called;
+    return margin_called || quiet();
 } FC_CAPTURE_AND_RETHROW() } // GCOVR_EXCL_LINE
 
 void database::pay_order( const account_object& receiver, const asset& receives, const asset& pays )
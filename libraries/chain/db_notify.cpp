@@ -301,7 +301,7 @@ void transaction_get_impacted_accounts( const transaction& tx, flat_set<account_
     operation_get_impacted_accounts( op, result );
 }
 
-static void get_relevant_accounts( const object* obj, flat_set<account_id_type>& accounts )
+static void get_relevant_accounts( const database& db, const object* obj, flat_set<account_id_type>& accounts )
 {
    FC_ASSERT( obj != nullptr, "Internal error: get_relevant_accounts called with nullptr" ); // This should not happen
    if( obj->id.space() == protocol_ids )
@@ -411,7 +411,10 @@ static void get_relevant_accounts( const object* obj, flat_set<account_id_type>&
            } case impl_transaction_history_object_type:{
               const auto& aobj = dynamic_cast<const transaction_history_object*>(obj);
               FC_ASSERT( aobj != nullptr );
-              transaction_get_impacted_accounts( aobj->trx, accounts );
+              // the object only refers to the transaction, which is kept in the pending pool or in a block
+              const optional<signed_transaction> trx = db.find_recorded_transaction( *aobj );
+              if( trx.valid() )
+                 transaction_get_impacted_accounts( *trx, accounts );
               break;
            } case impl_blinded_balance_object_type:{
               const auto& aobj = dynamic_cast<const blinded_balance_object*>(obj);
@@ -446,7 +449,7 @@ static void get_relevant_accounts( const object* obj, flat_set<account_id_type>&
            }
       }
    }
-} // end get_relevant_accounts( const object* obj, flat_set<account_id_type>& accounts )
+} // end get_relevant_accounts( const database& db, const object* obj, flat_set<account_id_type>& accounts )
 
 void database::notify_applied_block( const signed_block& block )
 {
@@ -475,7 +478,7 @@ void database::notify_changed_objects()
           new_ids.push_back(item);
           auto obj = find_object(item);
           if(obj != nullptr)
-            get_relevant_accounts(obj, new_accounts_impacted);
+            get_relevant_accounts(*this, obj, new_accounts_impacted);
         }
 
         if( !new_ids.empty() )
@@ -491,7 +494,9 @@ void database::notify_changed_objects()
         for( const auto& item : head_undo.old_values )
         {
           changed_ids.push_back(item.first);
-          get_relevant_accounts(item.second.get(), changed_accounts_impacted);
+          // the undo state keeps a packed image of the old value
+          const std::unique_ptr<object> old_value = _undo_db.unpack_image( item.first, item.second );
+          get_relevant_accounts(*this, old_value.get(), changed_accounts_impacted);
         }
 
         if( !changed_ids.empty() )
@@ -511,7 +516,7 @@ void database::notify_changed_objects()
           removed_ids.emplace_back( item.first );
           auto obj = item.second.get();
           removed.emplace_back( obj );
-          get_relevant_accounts(obj, removed_accounts_impacted);
+          get_relevant_accounts(*this, obj, removed_accounts_impacted);
         }
 
         if( !removed_ids.empty() )
@@ -143,19 +143,19 @@ void database::clear_expired_transactions()
 { try {
    //Look for expired transactions in the deduplication list, and remove them.
    //Transactions must have expired by at least two forking windows in order to be removed.
-   auto& transaction_idx = static_cast<transaction_index&>(get_mutable_index(implementation_ids,
-                                                                             impl_transaction_history_object_type));
-   const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->trx.expiration) )
-      transaction_idx.remove(*dedupe_index.begin());
+   if( head_block_time() == fc::time_point_sec() )
+      return;
+   // transactions are removed once the head block time is past their expiration
+   const fc::time_point_sec last_expiration( head_block_time().sec_since_epoch() - 1 );
+   while( auto trx_id = _expiration_scheduler.next_due( transaction_history_id_type::space_type, last_expiration ) )
+      remove( get( transaction_history_id_type( *trx_id ) ) );
 } FC_CAPTURE_AND_RETHROW() } // GCOVR_EXCL_LINE
 
 void database::clear_expired_proposals()
 {
-   const auto& proposal_expiration_index = get_index_type<proposal_index>().indices().get<by_expiration>();
-   while( !proposal_expiration_index.empty() && proposal_expiration_index.begin()->expiration_time <= head_block_time() )
+   while( auto proposal_id = _expiration_scheduler.next_due( proposal_id_type::space_type, head_block_time() ) )
    {
-      const proposal_object& proposal = *proposal_expiration_index.begin();
+      const proposal_object& proposal = get( proposal_id_type( *proposal_id ) );
       processed_transaction result;
       try {
          if( proposal.is_authorized_to_execute(*this) )
@@ -194,7 +194,7 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
     const call_order_object* call_ptr = nullptr; // place holder for the call order with least collateral ratio
 
     asset_id_type debt_asset_id = bitasset.asset_id;
-    auto call_min = price::min( bitasset.options.short_backing_asset, debt_asset_id );
+    const price_sort_key call_min( price::min( bitasset.options.short_backing_asset, debt_asset_id ) );
 
     auto maint_time = get_dynamic_global_properties().next_maintenance_time;
     bool before_core_hardfork_1270 = ( maint_time <= HARDFORK_CORE_1270_TIME ); // call price caching issue
@@ -226,8 +226,7 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
        // due to #338, we won't check for black swan on incoming limit order, so need to check with MSSP here
        highest = bitasset.current_feed.max_short_squeeze_price_before_hf_1270();
 
-    const limit_order_index& limit_index = get_index_type<limit_order_index>();
-    const auto& limit_price_index = limit_index.indices().get<by_price>();
+    const limit_order_book_index& limit_price_index = *_limit_order_books;
 
     // looking for limit orders selling the most USD for the least CORE
     auto highest_possible_bid = price::max( bitasset.asset_id, bitasset.options.short_backing_asset );
@@ -278,10 +277,9 @@ void database::clear_expired_orders()
 
          bool before_core_hardfork_606 = ( maint_time <= HARDFORK_CORE_606_TIME ); // feed always trigger call
 
-         auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
-         while( !limit_index.empty() && limit_index.begin()->expiration <= head_time )
+         while( auto order_id = _expiration_scheduler.next_due( limit_order_id_type::space_type, head_time ) )
          {
-            const limit_order_object& order = *limit_index.begin();
+            const limit_order_object& order = get( limit_order_id_type( *order_id ) );
             auto base_asset = order.sell_price.base.asset_id;
             auto quote_asset = order.sell_price.quote.asset_id;
             cancel_limit_order( order );
@@ -594,18 +592,16 @@ void database::update_maintenance_flag( bool new_maintenance_flag )
 
 void database::update_withdraw_permissions()
 {
-   auto& permit_index = get_index_type<withdraw_permission_index>().indices().get<by_expiration>();
-   while( !permit_index.empty() && permit_index.begin()->expiration <= head_block_time() )
-      remove(*permit_index.begin());
+   while( auto permit_id = _expiration_scheduler.next_due( withdraw_permission_id_type::space_type,
+                                                          head_block_time() ) )
+      remove( get( withdraw_permission_id_type( *permit_id ) ) );
 }
 
 void database::clear_expired_htlcs()
 {
-   const auto& htlc_idx = get_index_type<htlc_index>().indices().get<by_expiration>();
-   while ( htlc_idx.begin() != htlc_idx.end()
-         && htlc_idx.begin()->conditions.time_lock.expiration <= head_block_time() )
+   while( auto htlc_id = _expiration_scheduler.next_due( htlc_id_type::space_type, head_block_time() ) )
    {
-      const htlc_object& obj = *htlc_idx.begin();
+      const htlc_object& obj = get( htlc_id_type( *htlc_id ) );
       const auto amount = asset(obj.transfer.amount, obj.transfer.asset_id);
       adjust_balance( obj.transfer.from, amount );
       // notify related parties
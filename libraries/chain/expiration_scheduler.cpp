@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/expiration_scheduler.hpp>
+
+namespace graphene { namespace chain {
+
+void expiration_scheduler::schedule( object_id_type id, fc::time_point_sec deadline )
+{
+   const uint32_t seconds = deadline.sec_since_epoch();
+   auto itr = _deadlines.find( id );
+   if( itr != _deadlines.end() )
+   {
+      if( itr->second.deadline == seconds )
+         return;
+      cancel( id );
+   }
+   // objects that expire at the maximum time never expire
+   if( deadline == fc::time_point_sec::maximum() )
+      return;
+   place( id, _deadlines.emplace( id, schedule_entry( seconds ) ).first->second );
+}
+
+void expiration_scheduler::cancel( object_id_type id )
+{
+   auto itr = _deadlines.find( id );
+   if( itr == _deadlines.end() )
+      return;
+   const schedule_entry e = itr->second;
+   _deadlines.erase( itr );
+   if( e.deadline <= _now )
+      _due.erase( due_item( id.space_type(), e.deadline, id ) );
+   else if( e.slot == no_slot )
+      _overflow.erase( item( e.deadline, id ) );
+   else
+      remove_from_slot( e );
+}
+
+fc::optional<object_id_type> expiration_scheduler::next_due( uint16_t space_type, fc::time_point_sec now )
+{
+   const uint32_t seconds = now.sec_since_epoch();
+   advance( seconds );
+   auto itr = _due.lower_bound( due_item( space_type, 0, object_id_type() ) );
+   if( itr == _due.end() || std::get<0>( *itr ) != space_type || std::get<1>( *itr ) > seconds )
+      return fc::optional<object_id_type>();
+   return std::get<2>( *itr );
+}
+
+void expiration_scheduler::clear()
+{
+   _now = 0;
+   for( auto& level : _slots )
+      for( auto& slot : level )
+         slot.clear();
+   _overflow.clear();
+   _due.clear();
+   _deadlines.clear();
+}
+
+void expiration_scheduler::place( object_id_type id, schedule_entry& e )
+{
+   const uint32_t deadline = e.deadline;
+   e.slot = no_slot;
+   if( deadline <= _now )
+   {
+      _due.emplace( id.space_type(), deadline, id );
+      return;
+   }
+   // the level is given by the highest bit in which the deadline differs from the current time
+   uint32_t level = 0;
+   for( uint32_t diff = ( deadline ^ _now ) >> slot_bits; diff != 0; diff >>= slot_bits )
+      ++level;
+   if( level >= levels )
+   {
+      _overflow.insert( item( deadline, id ) );
+      return;
+   }
+   const uint32_t index = ( deadline >> ( level * slot_bits ) ) & ( ( 1 << slot_bits ) - 1 );
+   std::vector<item>& slot = _slots[level][index];
+   e.slot = ( level << slot_bits ) | index;
+   e.position = slot.size();
+   slot.push_back( item( deadline, id ) );
+}
+
+void expiration_scheduler::drain( std::vector<item>& slot )
+{
+   // the items of an emptied slot are placed in other slots or among the due items, cancelled ones have been
+   // removed already
+   std::vector<item> items;
+   items.swap( slot );
+   for( const item& i : items )
+      place( i.second, _deadlines.find( i.second )->second );
+}
+
+void expiration_scheduler::remove_from_slot( const schedule_entry& e )
+{
+   std::vector<item>& slot = _slots[e.slot >> slot_bits][e.slot & ( ( 1 << slot_bits ) - 1 )];
+   if( e.position + 1 < slot.size() )
+   {
+      slot[e.position] = slot.back();
+      _deadlines.find( slot[e.position].second )->second.position = e.position;
+   }
+   slot.pop_back();
+}
+
+void expiration_scheduler::advance( uint32_t now )
+{
+   if( now <= _now )
+      return;
+   const uint32_t before = _now;
+   _now = now;
+   const uint32_t mask = ( 1 << slot_bits ) - 1;
+   // A slot of level k holds the deadlines that agree with the time of the wheel above the bits of the level and
+   // are later in the bits of the level. Slots passed by the new time are emptied, from the lowest level up to the
+   // first one whose next higher bits did not change.
+   for( uint32_t level = 0; level < levels; ++level )
+   {
+      const uint32_t shift = level * slot_bits;
+      const uint32_t first = ( ( before >> shift ) & mask ) + 1;
+      const uint32_t window_shift = shift + slot_bits;
+      const bool same_window = ( uint64_t(now) >> window_shift ) == ( uint64_t(before) >> window_shift );
+      const uint32_t last = same_window ? ( ( now >> shift ) & mask ) : mask;
+      for( uint32_t s = first; s <= last; ++s )
+         drain( _slots[level][s] );
+      if( same_window )
+         return;
+   }
+   // the overflow items that are now within reach of the top level
+   const uint32_t top_shift = levels * slot_bits;
+   while( !_overflow.empty() && ( uint64_t(_overflow.begin()->first) >> top_shift ) <= ( uint64_t(now) >> top_shift ) )
+   {
+      const object_id_type id = _overflow.begin()->second;
+      _overflow.erase( _overflow.begin() );
+      place( id, _deadlines.find( id )->second );
+   }
+}
+
+} } // graphene::chain
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/chain/types.hpp>
+#include <graphene/db/dense_index.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <graphene/protocol/account.hpp>
 
@@ -408,7 +409,17 @@ namespace graphene { namespace chain {
    /**
     * @ingroup object_index
     */
-   typedef generic_index<account_object, account_multi_index_type> account_index;
+   typedef multi_index_container<
+      account_object*,
+      indexed_by<
+         ordered_unique< tag<by_name>, member<account_object, string, &account_object::name> >
+      >
+   > account_view_multi_index_type;
+
+   /**
+    * @ingroup object_index
+    */
+   typedef dense_index<account_object, account_view_multi_index_type> account_index;
 
    struct by_maintenance_seq;
 
@@ -416,9 +427,8 @@ namespace graphene { namespace chain {
     * @ingroup object_index
     */
    typedef multi_index_container<
-      account_statistics_object,
+      account_statistics_object*,
       indexed_by<
-         ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          ordered_unique< tag<by_maintenance_seq>,
             composite_key<
                account_statistics_object,
@@ -427,12 +437,12 @@ namespace graphene { namespace chain {
             >
          >
       >
-   > account_stats_multi_index_type;
+   > account_stats_view_multi_index_type;
 
    /**
     * @ingroup object_index
     */
-   typedef generic_index<account_statistics_object, account_stats_multi_index_type> account_stats_index;
+   typedef dense_index<account_statistics_object, account_stats_view_multi_index_type> account_stats_index;
 
 }}
 
@@ -22,12 +22,16 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <graphene/chain/median_feed_tracker.hpp>
 #include <graphene/chain/types.hpp>
+#include <graphene/db/dense_index.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <graphene/protocol/asset_ops.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <memory>
+
 /**
  * @defgroup prediction_market Prediction Market
  *
@@ -183,6 +187,8 @@ namespace graphene { namespace chain {
          /// Feeds published for this asset. If issuer is not committee, the keys in this map are the feed publishing
          /// accounts; otherwise, the feed publishers are the currently active committee_members and witnesses and this map
          /// should be treated as an implementation detail. The timestamp on each feed is the time it was published.
+         /// Feeds should be published with @ref set_feed, which keeps the ordered live feeds up to date, other
+         /// changes make the next update rebuild them.
          flat_map<account_id_type, pair<time_point_sec,price_feed>> feeds;
          /// This is the currently active price feed, calculated as the median of values from the currently active
          /// feeds.
@@ -255,6 +261,31 @@ namespace graphene { namespace chain {
           * @param next_maintenance_time the next chain maintenance time
           */
          void update_median_feeds(time_point_sec current_time, time_point_sec next_maintenance_time);
+
+         /// Stores the feed @p feed published by @p publisher at @p published
+         void set_feed( account_id_type publisher, time_point_sec published, const price_feed& feed )
+         {
+            auto& f = feeds[publisher];
+            f = make_pair( published, feed );
+            if( tracks_median_feeds() )
+            {
+               _median_feeds->set_feed( publisher, f );
+               _median_feeds_stamp = _median_feeds->restamp();
+            }
+         }
+
+         /// @return the live feeds of @ref feeds ordered by their fields, or nullptr if they are not tracked
+         const median_feed_tracker* median_feeds()const
+         { return tracks_median_feeds() ? _median_feeds.get() : nullptr; }
+
+      private:
+         bool tracks_median_feeds()const
+         { return _median_feeds_stamp != 0 && _median_feeds && _median_feeds->stamp() == _median_feeds_stamp; }
+
+         /// The live feeds of @ref feeds ordered by their fields, not serialized, may be shared with copies
+         std::shared_ptr<median_feed_tracker> _median_feeds;
+         /// Stamp of the tracker state that matches @ref feeds, 0 if there is none
+         uint64_t _median_feeds_stamp = 0;
    };
 
    // key extractor for short backing asset
@@ -293,9 +324,8 @@ namespace graphene { namespace chain {
    struct by_type;
    struct by_issuer;
    typedef multi_index_container<
-      asset_object,
+      asset_object*,
       indexed_by<
-         ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          ordered_unique< tag<by_symbol>, member<asset_object, string, &asset_object::symbol> >,
          ordered_unique< tag<by_type>,
             composite_key< asset_object,
@@ -310,8 +340,13 @@ namespace graphene { namespace chain {
             >
          >
       >
-   > asset_object_multi_index_type;
-   typedef generic_index<asset_object, asset_object_multi_index_type> asset_index;
+   > asset_object_view_multi_index_type;
+   typedef dense_index<asset_object, asset_object_view_multi_index_type> asset_index;
+
+   /**
+    * @ingroup object_index
+    */
+   typedef dense_index<asset_dynamic_data_object> asset_dynamic_data_index;
 
 } } // graphene::chain
 
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/account_object.hpp>
+#include <graphene/protocol/transaction.hpp>
+
+#include <graphene/db/index.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /**
+    *  @brief This secondary index on accounts counts changes of their owner and active authorities.
+    *
+    *  Every change of an authority, including those done when undoing, advances the version and records it as the
+    *  last change of the account. Creating an account is no change: nothing can have been verified against an
+    *  account that does not exist, and removing one is recorded.
+    */
+   class account_authority_version_index : public secondary_index
+   {
+      public:
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         uint64_t current_version()const { return _version; }
+
+         /// @return true if none of @p accounts changed its authorities after @p version
+         bool unchanged_since( const flat_set<account_id_type>& accounts, uint64_t version )const;
+
+      private:
+         void changed( account_id_type account );
+
+         uint64_t                               _version = 0;
+         /// account instance => version of the last change of its authorities
+         std::unordered_map<uint64_t,uint64_t>  _last_change;
+
+         authority                              _before_owner;
+         authority                              _before_active;
+   };
+
+   struct authority_cache_stats
+   {
+      /// Lookups that skipped the verification
+      uint64_t hits = 0;
+      /// Lookups that reused the signature keys, but had to verify since an authority involved has changed
+      uint64_t stale_hits = 0;
+      uint64_t misses = 0;
+      uint64_t size = 0;
+      uint64_t capacity = 0;
+   };
+
+   /**
+    *  @brief Remembers the transactions whose authorities have been verified
+    *
+    *  A transaction is usually verified twice, when it is pushed to the pending state and when it is applied in a
+    *  block. An entry holds the public keys recovered from the signatures of a transaction and the accounts whose
+    *  authorities were looked up when verifying it. As long as none of those accounts changed its authorities, the
+    *  verification would yield the same result and is skipped.
+    *
+    *  The cache is bounded, the oldest entries are dropped first. It is safe to use from several threads.
+    */
+   class authority_cache
+   {
+      public:
+         static constexpr uint32_t default_capacity = 10000;
+
+         struct lookup_result
+         {
+            /// true if verifying the transaction would succeed in the current state
+            bool                                verified = false;
+            /// the keys of the signatures of the transaction, if known
+            optional< flat_set<public_key_type> > keys;
+         };
+
+         explicit authority_cache( size_t capacity = default_capacity ) : _capacity( capacity ) {}
+
+         lookup_result find( const signed_transaction& trx, bool allow_non_immediate_owner, uint32_t max_recursion,
+                             const account_authority_version_index& versions );
+         /// @return true if the signature keys of @p trx are known
+         bool          contains( const signed_transaction& trx )const;
+
+         /**
+          * Records that @p trx was verified with signature @p keys against the authorities of @p accounts, as they
+          * were at @p version
+          */
+         void          insert( const signed_transaction& trx, const flat_set<public_key_type>& keys,
+                               flat_set<account_id_type>&& accounts, uint64_t version,
+                               bool allow_non_immediate_owner, uint32_t max_recursion );
+
+         void          clear();
+         /// Changes the maximum number of entries, 0 disables the cache
+         void          set_capacity( size_t capacity );
+         authority_cache_stats get_stats()const;
+
+      private:
+         struct entry
+         {
+            vector<signature_type>     signatures;
+            flat_set<public_key_type>  keys;
+            flat_set<account_id_type>  accounts;
+            uint64_t                   version = 0;
+            bool                       allow_non_immediate_owner = false;
+            uint32_t                   max_recursion = 0;
+         };
+
+         struct id_hash
+         {
+            size_t operator()( const transaction_id_type& id )const { return id._hash[0].value(); }
+         };
+
+         void evict();
+
+         mutable std::mutex                                          _mutex;
+         size_t                                                      _capacity;
+         std::unordered_map<transaction_id_type, entry, id_hash>     _entries;
+         /// IDs of the entries, oldest first
+         std::deque<transaction_id_type>                             _order;
+         authority_cache_stats                                       _stats;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::authority_cache_stats, (hits)(stale_hits)(misses)(size)(capacity) )
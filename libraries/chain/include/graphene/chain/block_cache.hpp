@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/block.hpp>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   struct block_cache_stats
+   {
+      uint64_t hits     = 0;
+      uint64_t misses   = 0;
+      uint32_t size     = 0;
+      uint32_t capacity = 0;
+   };
+
+   /**
+    *  @class block_cache
+    *  @brief A bounded, thread-safe LRU cache of decoded blocks, keyed by block number.
+    *
+    *  Blocks are immutable once cached and have their ID computed before they are shared, so a hit neither
+    *  deserializes nor hashes anything. A lookup by ID is a lookup by the number encoded in the ID that only
+    *  hits if the cached block has the same ID.
+    */
+   class block_cache
+   {
+      public:
+         using block_ptr = std::shared_ptr<const signed_block>;
+
+         static constexpr uint32_t default_capacity = 2000;
+
+         explicit block_cache( uint32_t capacity = default_capacity ) : _capacity( capacity ) {}
+
+         /// Changes the maximum number of cached blocks, 0 disables the cache
+         void      set_capacity( uint32_t capacity );
+
+         block_ptr get( uint32_t block_num )const;
+         block_ptr get( const block_id_type& id )const;
+
+         /// Caches @p b under @p id, replacing any block with the same number
+         void      put( const block_id_type& id, const signed_block& b );
+         /// Caches the shared block @p b, whose ID must already have been computed
+         void      put( const block_id_type& id, block_ptr b );
+         /// Evicts the block with @p id, if it is cached
+         void      erase( const block_id_type& id );
+         /// Evicts all blocks with a number below @p block_num
+         void      erase_before( uint32_t block_num );
+         void      clear();
+
+         block_cache_stats get_stats()const;
+
+      private:
+         using lru_list = std::list< std::pair< uint32_t, block_ptr > >;
+
+         block_ptr find( uint32_t block_num )const;
+
+         std::atomic<uint32_t>                             _capacity;
+         mutable lru_list                                  _lru; ///< most recently used first
+         std::unordered_map< uint32_t, lru_list::iterator> _by_num;
+         mutable std::mutex                                _mutex;
+         mutable std::atomic<uint64_t>                     _hits{0};
+         mutable std::atomic<uint64_t>                     _misses{0};
+   };
+
+} }
+
+FC_REFLECT( graphene::chain::block_cache_stats, (hits)(misses)(size)(capacity) )
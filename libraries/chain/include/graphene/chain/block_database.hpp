@@ -24,16 +24,64 @@
 #pragma once
 #include <fstream>
 #include <graphene/protocol/block.hpp>
+#include <graphene/chain/block_cache.hpp>
+#include <graphene/chain/config.hpp>
 
 #include <fc/filesystem.hpp>
+#include <fc/thread/future.hpp>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace graphene { namespace chain {
    struct index_entry;
    using namespace graphene::protocol;
 
-   class block_database 
+   namespace detail {
+      class mapped_file;
+      class sealed_segment;
+   }
+
+   /**
+    *  Stores blocks on disk in a segmented block log, with an @c index file of fixed-size entries addressed by
+    *  block number.
+    *
+    *  Each segment holds a fixed range of block numbers. The segment that is currently written to is a plain
+    *  append-only file (@c segments/N.raw). Once the whole range of a segment is older than the seal distance it
+    *  is compressed in the background into @c segments/N.seg, which consists of independently compressed frames
+    *  and a frame offset table, so a single block can be read without inflating the whole segment. Index entries
+    *  store the position of a block within the uncompressed contents of its segment, thus they stay valid when a
+    *  segment is sealed.
+    *
+    *  A block log in the former single-file layout (@c blocks and @c index) is converted on open().
+    *
+    *  Recently stored and fetched blocks are kept decoded in a @ref block_cache.
+    *
+    *  Non-archive nodes may prune() the log, which drops whole segments below a given block number. The index is
+    *  kept in full, so the IDs of pruned blocks can still be looked up, while their contents can no longer be
+    *  fetched and contains() no longer reports them.
+    *
+    *  Writes go through file streams. All reads are served from read-only memory mappings, so lookups do not
+    *  touch any shared stream state and may be performed concurrently from multiple threads. The mappings are
+    *  grown on demand when a reader asks for data beyond the currently mapped size. Readers find the mappings
+    *  through an immutable segment table that writers replace, so they never wait for each other.
+    */
+   class block_database
    {
       public:
+         static constexpr uint32_t default_blocks_per_segment = 100000;
+
+         /**
+          * @param blocks_per_segment number of block numbers covered by each segment, only used when a new block
+          *                           log is created, an existing one keeps its layout
+          * @param seal_distance      a segment is compressed when the stored head is this many blocks past its end
+          */
+         explicit block_database( uint32_t blocks_per_segment = default_blocks_per_segment,
+                                  uint32_t seal_distance = GRAPHENE_MAX_UNDO_HISTORY );
+         ~block_database();
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
@@ -46,14 +94,118 @@ namespace graphene { namespace chain {
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /// Like fetch_optional() and fetch_by_number(), but shares the decoded block instead of copying it
+         ///@{
+         block_cache::block_ptr fetch_shared( const block_id_type& id )const;
+         block_cache::block_ptr fetch_shared_by_number( uint32_t block_num )const;
+         ///@}
+         /**
+          * Reads the serialized form of a block without decoding it and without going through the cache, for
+          * sequential replays that decode blocks elsewhere.
+          * @return false if the block is not stored
+          */
+         bool                   fetch_packed_by_number( uint32_t block_num, block_id_type& id,
+                                                        vector<char>& data )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
+         /// Approximate on-disk position of the most recently read block, for progress reporting
          size_t                 blocks_current_position()const;
+         /// Total on-disk size of all segments
          size_t                 total_block_size()const;
+
+         /** Blocks until the segment that is being compressed in the background, if any, has been sealed */
+         void                   wait_for_sealing();
+
+         /**
+          * Drops all segments that only hold blocks below @p first_block_to_keep, their files are deleted in the
+          * background. The segment holding the head, the one that is written to and one that is being sealed are
+          * never dropped.
+          */
+         void                   prune( uint32_t first_block_to_keep );
+         /// Lowest block number whose contents may still be fetched, 1 unless the log has been pruned
+         uint32_t               first_retained_block_num()const;
+
+         /// Sets the maximum number of decoded blocks to keep in memory, 0 disables caching
+         void                   set_cache_size( uint32_t max_blocks ) { _cache.set_capacity( max_blocks ); }
+         block_cache_stats      get_cache_stats()const { return _cache.get_stats(); }
+         /// Drops a block from the cache without touching the block log
+         void                   evict( const block_id_type& id ) { _cache.erase( id ); }
+
+         /**
+          * Converts a block log in the former single-file layout in @p dbdir to the segmented layout.
+          * The conversion is done in a temporary directory that replaces @p dbdir when complete, an interrupted
+          * conversion is restarted by the next call to open().
+          */
+         static void convert_legacy_log( const fc::path& dbdir,
+                                         uint32_t blocks_per_segment = default_blocks_per_segment,
+                                         uint32_t seal_distance = GRAPHENE_MAX_UNDO_HISTORY );
+
       private:
-         optional<index_entry> last_index_entry()const;
+         using mapped_file_ptr = std::shared_ptr<const detail::mapped_file>;
+         using sealed_segment_ptr = std::shared_ptr<const detail::sealed_segment>;
+
+         /// A segment is either unsealed (mapped on demand) or sealed
+         struct segment_slot
+         {
+            mapped_file_ptr    raw;    ///< grown by readers, only accessed atomically
+            sealed_segment_ptr sealed;
+         };
+         using segment_slot_ptr = std::shared_ptr<segment_slot>;
+         using segment_map = std::map<uint32_t, segment_slot_ptr>;
+         using segment_map_ptr = std::shared_ptr<const segment_map>;
+
+         optional<index_entry>  last_index_entry()const;
+         /// Drops the entries of blocks that are not on file from the end of the index
+         void                   truncate_index();
+         bool                   read_index_entry( uint32_t block_num, index_entry& e )const;
+         block_cache::block_ptr read_block( uint32_t block_num, const index_entry& e )const;
+         /** Looks up the mapping or sealed segment that holds the block described by @p e
+          *  @return false if the block is not on file */
+         bool                   find_block_data( uint32_t block_num, const index_entry& e, mapped_file_ptr& raw,
+                                                 sealed_segment_ptr& sealed )const;
+         /** @return a mapping of @p file that covers at least @p min_size bytes, or an empty pointer */
+         mapped_file_ptr        map_at_least( mapped_file_ptr& current, const fc::path& file, uint64_t min_size )const;
+         void                   reset_index_mapping()const;
+         /// @return the slot of @p segment in the current segment table, or an empty pointer
+         segment_slot_ptr       find_segment( uint32_t segment )const;
+         /// Replaces the segment table by a copy that @p update modifies, readers keep the table they hold
+         template<typename Update>
+         void                   update_segments( Update&& update )const;
+
+         fc::path               raw_segment_file( uint32_t segment )const;
+         fc::path               sealed_segment_file( uint32_t segment )const;
+         uint32_t               segment_of( uint32_t block_num )const { return block_num / _blocks_per_segment; }
+         void                   load_segments();
+         void                   open_segment_for_write( uint32_t segment );
+         void                   unseal_segment( uint32_t segment );
+         void                   seal_segment( uint32_t segment );
+         void                   maybe_seal_segments( uint32_t head_block_num );
+         void                   wait_for_pruning();
+
+         uint32_t _blocks_per_segment;
+         const uint32_t _seal_distance;
+
          fc::path _index_filename;
-         mutable std::fstream _blocks;
+         fc::path _segments_dir;
+         mutable std::fstream _blocks;           ///< the raw segment that is currently written to
          mutable std::fstream _block_num_to_pos;
+         optional<uint32_t>   _write_segment;
+
+         /// Lowest segment that may still need to be sealed
+         uint32_t           _next_unsealed = 0;
+         fc::future<void>   _sealing;
+         optional<uint32_t> _sealing_segment;
+         fc::future<void>   _pruning;
+         /// All segments below this one have been dropped by prune()
+         uint32_t           _pruned_below_segment = 0;
+
+         /// Mappings and the segment table are only accessed atomically, readers never take a lock
+         mutable mapped_file_ptr              _index_map;
+         mutable segment_map_ptr              _segments = std::make_shared<const segment_map>();
+         mutable std::mutex                   _mutex; ///< serializes updates of _segments
+         mutable std::atomic<uint32_t>        _last_read_num{0};
+         mutable std::atomic<uint64_t>        _last_read_end{0};
+
+         mutable block_cache                  _cache;
    };
 } }
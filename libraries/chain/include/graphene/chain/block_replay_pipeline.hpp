@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /// Work done by one stage of a @ref block_replay_pipeline
+   struct replay_stage_stats
+   {
+      uint64_t         blocks = 0;
+      uint64_t         bytes  = 0; ///< serialized size of the blocks
+      fc::microseconds busy;       ///< time spent working, summed over the threads of the stage
+   };
+
+   /**
+    *  @class block_replay_pipeline
+    *  @brief Reads and decodes a range of blocks from a @ref block_database ahead of the thread that applies them.
+    *
+    *  A read-ahead thread reads the serialized blocks sequentially and passes them to a pool of decode threads
+    *  through a bounded lock-free queue. The decode threads unpack the blocks, precompute their IDs, signees
+    *  and other data of their transactions, and put them into a ring of slots addressed by block number, from
+    *  which next() takes them in order. At most @c queue_depth blocks are read but not yet taken at any time.
+    *
+    *  Reading stops at the first block that is not stored, next() returns no block from there on.
+    */
+   class block_replay_pipeline
+   {
+      public:
+         static constexpr uint32_t default_queue_depth = 1024;
+
+         /// Called on a decode thread for each decoded block, exceptions are ignored
+         using precompute_function = std::function< void( const signed_block& ) >;
+
+         /**
+          * @param queue_depth    maximum number of blocks read ahead of the one taken by next()
+          * @param decode_threads number of decode threads, 0 for one per hardware thread
+          */
+         block_replay_pipeline( const block_database& blocks, uint32_t first_block_num, uint32_t last_block_num,
+                                uint32_t queue_depth, uint32_t decode_threads, precompute_function precompute );
+         ~block_replay_pipeline();
+
+         /**
+          * Waits for the next block to be decoded
+          * @return the next block, or an empty optional if it is not stored or can not be decoded
+          */
+         optional<signed_block> next();
+
+         uint32_t           decode_threads()const { return _decoders.size(); }
+         replay_stage_stats read_stats()const;
+         replay_stage_stats decode_stats()const;
+         /// Time next() has spent waiting for blocks
+         fc::microseconds   wait_time()const { return fc::microseconds( _wait_us.load() ); }
+
+      private:
+         struct packed_block;
+         struct packed_queue;
+         struct slot;
+
+         void read_loop();
+         void decode_loop();
+         /// Stops and joins all threads
+         void stop();
+
+         const block_database&         _blocks;
+         const uint32_t                _first_block_num;
+         const uint32_t                _last_block_num;
+         const uint32_t                _queue_depth;
+         const precompute_function     _precompute;
+
+         std::unique_ptr<packed_queue> _packed;
+         std::unique_ptr<slot[]>       _slots;
+         std::atomic<uint32_t>         _next_block_num; ///< the block next() returns next
+         std::atomic<bool>             _reading_done{false};
+         std::atomic<bool>             _stopping{false};
+
+         std::atomic<uint64_t>         _read_blocks{0};
+         std::atomic<uint64_t>         _read_bytes{0};
+         std::atomic<int64_t>          _read_us{0};
+         std::atomic<uint64_t>         _decoded_blocks{0};
+         std::atomic<uint64_t>         _decoded_bytes{0};
+         std::atomic<int64_t>          _decode_us{0};
+         std::atomic<int64_t>          _wait_us{0};
+
+         std::thread                   _reader;
+         std::vector<std::thread>      _decoders;
+   };
+
+} }
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/block.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /// Number and total wall time of the operations of one type evaluated in a block
+   struct operation_trace
+   {
+      int64_t  type    = 0;
+      uint32_t count   = 0;
+      /// Nested operations, e.g. those executed by a proposal, are included in the time of their parent
+      uint64_t time_ns = 0;
+   };
+
+   /// Where the time to apply a block went, all times are wall times in microseconds
+   struct block_trace
+   {
+      uint32_t       block_num      = 0;
+      block_id_type  block_id;
+      uint32_t       transactions   = 0;
+      bool           maintenance    = false;
+
+      /// Precomputation of the block by @ref database::precompute_parallel, if the block went through it
+      uint64_t       precompute_us  = 0;
+      /// Whole @ref database::push_block, including switching forks, 0 for blocks applied otherwise
+      uint64_t       push_us        = 0;
+      /// Whole @ref database::apply_block, the phases below are parts of it
+      uint64_t       apply_us       = 0;
+      /// Size, merkle root and header checks
+      uint64_t       header_us      = 0;
+      uint64_t       transactions_us = 0;
+      /// Updates of missed blocks, global properties, witnesses, the last irreversible block and the schedule
+      uint64_t       updates_us     = 0;
+      uint64_t       maintenance_us = 0;
+      /// Block summary, expired transactions, proposals, orders, settlements and HTLCs, feeds and withdrawals
+      uint64_t       expirations_us = 0;
+      uint64_t       applied_block_us   = 0;
+      uint64_t       changed_objects_us = 0;
+
+      /// Operations evaluated per type, ordered by type
+      std::vector<operation_trace> operations;
+
+      /// Size of the undo session of the block, if undo is enabled
+      uint64_t       undo_new       = 0;
+      uint64_t       undo_modified  = 0;
+      uint64_t       undo_removed   = 0;
+
+      /// Time spent in signal handlers registered with @ref database::traced_handler, by handler name
+      flat_map<std::string,uint64_t> handler_us;
+   };
+
+   /**
+    *  @class block_tracer
+    *  @brief Records a @ref block_trace for each applied block and keeps those of the most recent blocks
+    *
+    *  A trace is active between @ref begin and @ref end, which are called by the database on its own thread. Only
+    *  the ring of finished traces and the precomputation times are shared with other threads.
+    */
+   class block_tracer
+   {
+      public:
+         typedef std::chrono::steady_clock clock;
+
+         static constexpr uint32_t default_capacity = 100;
+         static constexpr uint32_t default_slow_block_ms = 1000;
+
+         /// Measures consecutive phases of work
+         class phase_timer
+         {
+            public:
+               phase_timer() : _start( clock::now() ) {}
+               /// Adds the time since the previous phase ended, or since construction, to @p phase_us
+               void end_phase( uint64_t& phase_us )
+               {
+                  const auto now = clock::now();
+                  phase_us += std::chrono::duration_cast<std::chrono::microseconds>( now - _start ).count();
+                  _start = now;
+               }
+            private:
+               clock::time_point  _start;
+         };
+
+         /// Records the evaluation of one operation in the active trace, if any, and costs nothing otherwise
+         class operation_timer
+         {
+            public:
+               operation_timer( block_tracer& tracer, int64_t type );
+               ~operation_timer() { if( _traced ) record(); }
+            private:
+               void record();
+
+               block_tracer&      _tracer;
+               int64_t            _type;
+               bool               _traced;
+               clock::time_point  _start;
+         };
+
+         /// Records the execution of a signal handler in the active trace, if any, and costs nothing otherwise
+         class handler_timer
+         {
+            public:
+               handler_timer( block_tracer& tracer, const std::string& name );
+               ~handler_timer() { if( _traced ) record(); }
+            private:
+               void record();
+
+               block_tracer&      _tracer;
+               const std::string& _name;
+               bool               _traced;
+               clock::time_point  _start;
+         };
+
+         static uint64_t elapsed_us( clock::time_point start )
+         {
+            return std::chrono::duration_cast<std::chrono::microseconds>( clock::now() - start ).count();
+         }
+
+         /**
+          * @param capacity number of traces to keep, 0 disables tracing
+          * @param slow_block_ms blocks taking at least this long to apply are logged, 0 disables logging
+          */
+         void set_options( uint32_t capacity, uint32_t slow_block_ms );
+         /// Whether traces are kept, see @ref set_options
+         bool enabled()const { return _capacity.load() > 0; }
+
+         /// Starts the trace of @p block, discarding an unfinished one
+         void begin( const signed_block& block );
+         /// The active trace, or nullptr
+         block_trace* current() { return _active ? &_current : nullptr; }
+         /// Keeps the active trace and logs it if the block was slow
+         void end();
+         /// Discards the active trace, if any
+         void abort() { _active = false; }
+
+         /// Records how long the precomputation of block @p id took, it is added to the trace of the block
+         void record_precompute( const block_id_type& id, uint64_t us );
+         /// Records how long the block @p id took to push, if its trace is still kept
+         void record_push( const block_id_type& id, uint64_t us );
+
+         /// @return up to @p limit traces, the most recent first
+         std::vector<block_trace> get_traces( uint32_t limit )const;
+
+      private:
+         bool                              _active = false;
+         block_trace                       _current;
+         /// Operations of the active trace indexed by type
+         std::vector<operation_trace>      _operations;
+
+         std::atomic<uint64_t>             _slow_block_us{ default_slow_block_ms * 1000 };
+         std::atomic<uint32_t>             _capacity{ default_capacity };
+         /// Most recent trace last
+         std::deque<block_trace>           _traces;
+         block_id_type                     _precomputed_id;
+         uint64_t                          _precompute_us = 0;
+         mutable std::mutex                _mutex;
+   };
+
+   inline block_tracer::operation_timer::operation_timer( block_tracer& tracer, int64_t type )
+   : _tracer( tracer ), _type( type ), _traced( tracer._active )
+   {
+      if( _traced )
+         _start = clock::now();
+   }
+
+   inline block_tracer::handler_timer::handler_timer( block_tracer& tracer, const std::string& name )
+   : _tracer( tracer ), _name( name ), _traced( tracer._active )
+   {
+      if( _traced )
+         _start = clock::now();
+   }
+
+} }
+
+FC_REFLECT( graphene::chain::operation_trace, (type)(count)(time_ns) )
+FC_REFLECT( graphene::chain::block_trace,
+            (block_num)(block_id)(transactions)(maintenance)
+            (precompute_us)(push_us)(apply_us)(header_us)(transactions_us)(updates_us)(maintenance_us)
+            (expirations_us)(applied_block_us)(changed_objects_us)
+            (operations)(undo_new)(undo_modified)(undo_removed)(handler_us) )
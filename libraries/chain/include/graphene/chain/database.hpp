@@ -29,9 +29,15 @@
 #include <graphene/chain/node_property_object.hpp>
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/authority_cache.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
+#include <graphene/chain/block_replay_pipeline.hpp>
+#include <graphene/chain/block_tracer.hpp>
+#include <graphene/chain/expiration_scheduler.hpp>
 #include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/margin_call_watcher.hpp>
+#include <graphene/chain/mempool.hpp>
 #include <graphene/chain/evaluator.hpp>
 
 #include <graphene/db/object_database.hpp>
@@ -55,8 +61,10 @@ namespace graphene { namespace chain {
    class witness_object;
    class force_settlement_object;
    class limit_order_object;
+   class limit_order_book_index;
    class collateral_bid_object;
    class call_order_object;
+   class transaction_history_object;
 
    struct budget_record;
    enum class vesting_balance_type;
@@ -114,6 +122,19 @@ namespace graphene { namespace chain {
           */
          void reindex(fc::path data_dir);
 
+         /**
+          * Configures the pipeline that reads and decodes blocks ahead of applying them during a replay
+          * @param queue_depth    maximum number of blocks read ahead
+          * @param decode_threads number of threads decoding blocks, 0 for one per hardware thread
+          */
+         void set_replay_pipeline( uint32_t queue_depth, uint32_t decode_threads );
+
+         /**
+          * Enables trusted replays. Blocks up to the last checkpoint within the block log are then only checked to
+          * link to each other and to match their merkle roots, and their signatures are not recovered.
+          */
+         void set_trusted_replay( bool trust_checkpoints ) { _trusted_replay = trust_checkpoints; }
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param data_dir the path to store the database
@@ -317,6 +338,8 @@ namespace graphene { namespace chain {
 
          bool check_call_orders(const asset_object &mia, bool enable_black_swan = true, bool for_new_limit_order = false,
                                 const asset_bitasset_data_object *bitasset_ptr = nullptr);
+         /// Counters of the checks of call orders, and of those skipped because nothing changed in the market
+         margin_call_stats get_margin_call_stats()const { return _margin_call_watcher.get_stats(); }
 
          // Note: Ideally this should be private.
          //       Now it is public because we use it in a non-member function in db_market.cpp .
@@ -406,9 +429,57 @@ namespace graphene { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
-         const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
+         /// Like fetch_block_by_id() and fetch_block_by_number(), but shares the block instead of copying it
+         ///@{
+         block_cache::block_ptr     fetch_shared_block_by_id( const block_id_type& id )const;
+         block_cache::block_ptr     fetch_shared_block_by_number( uint32_t num )const;
+         ///@}
+         /// Looks up a transaction that has not expired yet in the pending transactions or in the block that includes it
+         signed_transaction         get_recent_transaction( const transaction_id_type& trx_id )const;
+         /// @return the transaction that @p entry refers to, or nothing if it is neither pending nor stored any more
+         optional<signed_transaction> find_recorded_transaction( const transaction_history_object& entry )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
+         /// Sets the maximum number of decoded blocks kept in memory by the block database, 0 disables caching
+         void                       set_block_cache_size( uint32_t max_blocks );
+         block_cache_stats          get_block_cache_stats()const;
+
+         /**
+          * Configures the traces of applied blocks
+          * @param capacity number of most recent traces to keep, 0 disables tracing
+          * @param slow_block_ms blocks taking at least this long to apply are logged, 0 disables logging
+          */
+         void                       set_block_trace_options( uint32_t capacity, uint32_t slow_block_ms )
+                                    { _block_tracer.set_options( capacity, slow_block_ms ); }
+         /// @return up to @p limit traces of the most recently applied blocks, the most recent first
+         vector<block_trace>        get_block_traces( uint32_t limit )const
+                                    { return _block_tracer.get_traces( limit ); }
+
+         /**
+          * Wraps a signal handler so that the time it takes while a block is applied is added to the trace of
+          * the block under @p name, e.g. the name of the plugin that connects it
+          */
+         template<typename Handler>
+         auto traced_handler( std::string name, Handler handler )
+         {
+            return [this,name,handler]( auto&&... args ) {
+               block_tracer::handler_timer timer( _block_tracer, name );
+               handler( std::forward<decltype(args)>(args)... );
+            };
+         }
+
+         /**
+          * Enables pruning of the block log. After each pushed block, the contents of blocks that are older than
+          * both limits and irreversible are dropped, a limit of 0 is ignored. IDs of pruned blocks stay available.
+          * Blocks within the maximum transaction expiration time are always kept, as the transactions that have
+          * not expired yet are looked up in them.
+          * @param keep_blocks number of most recent blocks to keep
+          * @param keep_days   number of days of most recent blocks to keep
+          */
+         void                       set_block_log_pruning( uint32_t keep_blocks, uint32_t keep_days );
+         /// Lowest block number whose contents are still stored, 1 unless the block log has been pruned
+         uint32_t                   first_retained_block_num()const;
+
          void                       add_checkpoints( const flat_map<uint32_t,block_id_type>& checkpts );
          const flat_map<uint32_t,block_id_type> get_checkpoints()const { return _checkpoints; }
          bool before_last_checkpoint()const;
@@ -417,6 +488,24 @@ namespace graphene { namespace chain {
          processed_transaction push_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
       private:
          bool _push_block( const signed_block& b );
+         void prune_block_log();
+         /// @return the fee payer of the first operation of @p trx and the fees of all operations in core asset
+         std::pair<account_id_type,share_type> get_core_fee( const transaction& trx )const;
+         /**
+          * Discards the pending state and applies the pending transactions again, except those at the arrival
+          * positions @p excluded (in ascending order)
+          * @return the IDs of the pending transactions that failed to apply, they are not removed from the pool
+          */
+         std::vector<transaction_id_type> rebuild_pending_state( const std::vector<uint64_t>& excluded = {} );
+         /// Applies the deferred transactions whose first operation is paid by @p payer again
+         void reapply_deferred_transactions_of( account_id_type payer );
+         /// Applies a deferred transaction again unless it is known or expired, counting it in @p expired if it is
+         void reapply_deferred_transaction( const processed_transaction& tx, size_t& expired );
+         /// Starts tracking the pending transactions applied on top of the head block as a candidate block
+         void reset_candidate_block();
+         /// @return true if a block generated with @p skip can consist of the pending transactions without
+         ///         applying them again
+         bool use_candidate_block( uint32_t skip )const;
       public:
          // It is public because it is used in pending_transactions_restorer in db_with.hpp
          processed_transaction _push_transaction( const precomputable_transaction& trx );
@@ -501,6 +590,35 @@ namespace graphene { namespace chain {
           * can be reapplied at the proper time */
          std::deque< precomputable_transaction > _popped_tx;
 
+         /** the transactions applied to the pending state, in the order of their arrival. It is public because
+          * it is used in pending_transactions_restorer in db_with.hpp */
+         mempool                                 _pending_tx;
+
+         /** pending transactions that have not been applied again since the last pushed block, in the order of
+          * their arrival. They are applied before a new transaction paid by the same account and before a block is
+          * generated. */
+         std::deque< processed_transaction >     _deferred_tx;
+
+         /// Limits the pending transactions in total size and per fee paying account, 0 means unlimited
+         void          set_mempool_limits( uint64_t max_bytes, uint32_t max_per_account )
+                       { _pending_tx.set_limits( max_bytes, max_per_account ); }
+         mempool_stats get_mempool_stats()const;
+
+         /**
+          * Limits the number of pending transactions that are applied again while a block is pushed, the others
+          * are deferred until @ref reapply_deferred_transactions is called. Deferred transactions are not included
+          * in generated blocks. 0 means unlimited.
+          */
+         void          set_pending_reapply_limit( uint32_t limit ) { _pending_reapply_limit = limit; }
+         uint32_t      get_pending_reapply_limit()const { return _pending_reapply_limit; }
+         /**
+          * Applies deferred pending transactions again, dropping those that have been included in a block, expired
+          * or became invalid
+          * @param max_count the maximum number of transactions to process, 0 to process all
+          * @return the number of transactions that are still deferred
+          */
+         size_t        reapply_deferred_transactions( size_t max_count = 0 );
+
          /**
           * @}
           */
@@ -527,6 +645,8 @@ namespace graphene { namespace chain {
       private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
+         /// Performs the precomputations of @ref precompute_parallel on the calling thread
+         void precompute_block( const signed_block& block, const uint32_t skip )const;
 
       protected:
          // Mark pop_undo() as protected -- we do not want outside calling pop_undo(),
@@ -535,6 +655,15 @@ namespace graphene { namespace chain {
 
       private:
          optional<undo_database::session>       _pending_tx_session;
+
+         /// Whether _pending_tx_session is the result of applying all pending transactions in the order of
+         /// their arrival on top of block _candidate_head
+         bool                                   _candidate_valid = false;
+         block_id_type                          _candidate_head;
+         /// Packed size of the pending transactions in a block, tracked as they are applied
+         uint64_t                               _candidate_size = 0;
+         /// Skip flags the pending transactions have been applied with
+         uint32_t                               _candidate_skip = 0;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
 
          template<class Index>
@@ -549,7 +678,18 @@ namespace graphene { namespace chain {
 
       private:
          void                  _apply_block( const signed_block& next_block );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         /// @param prechecked true if @p trx has been validated and its authorities verified against this state
+         /// @param in_block whether @p trx is a transaction of the block being applied, as opposed to a pending one
+         processed_transaction _apply_transaction( const signed_transaction& trx, bool prechecked = false,
+                                                   bool in_block = false );
+         void                  verify_transaction_authority( const signed_transaction& trx )const;
+         /**
+          * Validates and verifies the authorities of @p count transactions, none of which changes authorities
+          * before the last one, in parallel. A transaction whose checks pass gets its flag in @p prechecked set,
+          * failed checks are left to be repeated, and reported, when the transaction is applied.
+          */
+         void                  precheck_transactions( const processed_transaction* trxs, char* prechecked,
+                                                      size_t count, uint32_t skip )const;
 
          ///Steps involved in applying a new block
          ///@{
@@ -591,6 +731,13 @@ namespace graphene { namespace chain {
          void process_budget();
          void pay_workers( share_type& budget );
          void perform_chain_maintenance(const signed_block& next_block);
+         /**
+          * Adds the voting stakes of @p voters to the votes of the objects they vote for, used when enabled by
+          * @ref enable_parallel_vote_tally. Chunks of voters are tallied in parallel into partial tallies, which are
+          * added in a fixed order.
+          * @param voters the accounts specifying the opinions and the stakes voting with them
+          */
+         void tally_votes( const vector<std::pair<const account_object*, uint64_t>>& voters );
          void update_active_witnesses();
          void update_active_committee_members();
          void update_worker_votes();
@@ -602,7 +749,6 @@ namespace graphene { namespace chain {
          ///@}
          ///@}
 
-         vector< processed_transaction >        _pending_tx;
          fork_database                          _fork_db;
 
          /**
@@ -639,12 +785,57 @@ namespace graphene { namespace chain {
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
+         /// Whether blocks covered by a checkpoint are replayed with only their links and merkle roots checked
+         bool                              _trusted_replay = false;
+         /// Transactions expiring at or after this time are recorded for duplicate checks even if the checks are
+         /// skipped, set during a trusted replay
+         optional<fc::time_point_sec>      _dedupe_history_start;
+
          node_property_object              _node_property_object;
 
          /// Whether to update votes of standby witnesses and committee members when performing chain maintenance.
          /// Set it to true to provide accurate data to API clients, set to false to have better performance.
          bool                              _track_standby_votes = true;
 
+         /// Maximum number of pending transactions applied again while pushing a block, 0 means unlimited
+         uint32_t                          _pending_reapply_limit = 0;
+
+         /// Whether to check the transactions of a block in parallel, in runs that end at changes of authorities
+         bool                              _parallel_transaction_checks = false;
+
+         /// Whether to tally the votes in chain maintenance in parallel
+         bool                              _parallel_vote_tally = false;
+         /// Minimum number of voters tallied by one thread
+         static const size_t               min_voters_per_tally_chunk = 256;
+
+         /// Transactions whose authorities have been verified, shared by the pending state and applied blocks
+         mutable authority_cache                        _authority_cache;
+         const account_authority_version_index*         _authority_versions = nullptr;
+
+         /// Expiration times of transactions, proposals, limit orders, withdraw permissions and HTLCs
+         expiration_scheduler                           _expiration_scheduler;
+
+         /// Limit orders grouped by market side and price level, used for matching
+         const limit_order_book_index*                  _limit_order_books = nullptr;
+
+         /// Markets of market issued assets known to need no margin call, see @ref check_call_orders
+         margin_call_watcher                            _margin_call_watcher;
+
+         /// Traces of the most recently applied blocks, mutable to record precomputations
+         mutable block_tracer                           _block_tracer;
+
+         /// Replay pipeline settings, see @ref set_replay_pipeline
+         ///@{
+         uint32_t                          _replay_queue_depth = block_replay_pipeline::default_queue_depth;
+         uint32_t                          _replay_decode_threads = 0;
+         ///@}
+
+         /// Block log pruning limits, 0 means unlimited
+         ///@{
+         uint32_t                          _prune_keep_blocks = 0;
+         uint32_t                          _prune_keep_days   = 0;
+         ///@}
+
          /**
           * Whether database is successfully opened or not.
           *
@@ -673,6 +864,13 @@ namespace graphene { namespace chain {
       public:
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
+         /// Enable or disable parallel validation and authority checks of the transactions of applied blocks
+         inline void enable_parallel_transaction_checks(bool enable)  { _parallel_transaction_checks = enable; }
+         /// Enable or disable tallying the votes in chain maintenance in parallel, the results do not change
+         inline void enable_parallel_vote_tally(bool enable)  { _parallel_vote_tally = enable; }
+         /// Set the maximum number of transactions remembered as verified, 0 disables the cache
+         inline void set_authority_cache_size(size_t size)  { _authority_cache.set_capacity( size ); }
+         inline authority_cache_stats get_authority_cache_stats()const  { return _authority_cache.get_stats(); }
    };
 
    namespace detail
@@ -69,38 +69,54 @@ struct skip_flags_restorer
 struct pending_transactions_restorer
 {
    pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+      : _db(db), _deferred_transactions( std::move(db._deferred_tx) ),
+        _pending_transactions( std::move(pending_transactions) )
    {
       _db.clear_pending();
    }
 
+   /**
+    * Transactions included in the new block are dropped by a lookup of their IDs. The others are applied again,
+    * up to the limit set by database::set_pending_reapply_limit(), the rest is deferred.
+    */
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
+      const uint32_t limit = _db.get_pending_reapply_limit();
+      uint32_t applied = 0;
+      size_t expired = 0;
+      const time_point_sec now = _db.head_block_time();
+      auto restore = [this,limit,now,&applied,&expired]( const auto& tx ) {
+         if( _db.is_known_transaction( tx.id() ) )
+            return;
+         if( tx.expiration < now && _db.head_block_num() > 0 )
+         { // would fail to apply
+            ++expired;
+            return;
+         }
+         if( limit > 0 && applied >= limit )
+         {
+            _db._deferred_tx.push_back( tx );
+            return;
+         }
+         ++applied;
          try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
+            _db._push_transaction( tx );
          } catch ( const fc::exception& ) { // ignore invalid transactions
          }
-      }
+      };
+
+      for( const auto& tx : _db._popped_tx )
+         restore( tx );
       _db._popped_tx.clear();
+      for( const processed_transaction& tx : _deferred_transactions )
+         restore( tx );
       for( const processed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const fc::exception& )
-         { // ignore invalid transactions
-         }
-      }
+         restore( tx );
+      _db._pending_tx.record_expired( expired );
    }
 
    database& _db;
+   std::deque< processed_transaction > _deferred_transactions;
    std::vector< processed_transaction > _pending_transactions;
 };
 
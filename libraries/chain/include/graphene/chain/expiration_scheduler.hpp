@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+#include <graphene/protocol/object_id.hpp>
+
+#include <fc/optional.hpp>
+#include <fc/time.hpp>
+
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace chain {
+   using namespace graphene::db;
+
+   /**
+    *  @brief Schedules objects for the time they expire at, in a hierarchical timing wheel
+    *
+    *  The wheel has @ref levels levels of 2^@ref slot_bits slots. A level resolves one group of @ref slot_bits bits
+    *  of the deadlines, in seconds, relative to the current time of the wheel. Deadlines too far ahead for the top
+    *  level wait in an ordered overflow set. As time advances, slots are emptied: their objects either become due
+    *  or are placed again in a lower level. The position of each object in its slot is kept, so that cancelling
+    *  it removes it from the slot right away.
+    *
+    *  Due objects are kept in the order of their deadlines and IDs, separately for each object type. The types are
+    *  processed in a fixed order by the database, so the order of expiration does not depend on the wheel.
+    *
+    *  One scheduler is shared by the secondary indexes of several primary indexes and is not synchronized. This
+    *  relies on objects being inserted from a single thread also while the object database is opened.
+    */
+   class expiration_scheduler
+   {
+      public:
+         static constexpr uint32_t slot_bits = 6;
+         static constexpr uint32_t levels = 5;
+
+         /// Schedules object @p id to expire at @p deadline, replacing the deadline it had before
+         void schedule( object_id_type id, fc::time_point_sec deadline );
+         void cancel( object_id_type id );
+
+         /**
+          * @return the ID of the object of type @p space_type that expires first, if it expires at or before
+          * @p now. The object stays scheduled until it is cancelled or rescheduled.
+          */
+         fc::optional<object_id_type> next_due( uint16_t space_type, fc::time_point_sec now );
+
+         void   clear();
+         /// Number of scheduled objects
+         size_t size()const { return _deadlines.size(); }
+
+      private:
+         typedef std::pair<uint32_t, object_id_type> item;
+         typedef std::tuple<uint16_t, uint32_t, object_id_type> due_item;
+
+         static constexpr uint32_t no_slot = uint32_t(-1);
+
+         struct schedule_entry
+         {
+            explicit schedule_entry( uint32_t d ) : deadline( d ) {}
+
+            uint32_t deadline;
+            /// Slot of the wheel holding the object as level << slot_bits | slot, or no_slot if it is not in one
+            uint32_t slot = no_slot;
+            /// Position of the object in its slot
+            uint32_t position = 0;
+         };
+
+         /// Moves the current time of the wheel forward to @p now
+         void advance( uint32_t now );
+         /// Puts object @p id in the slot for its deadline relative to the current time, or among the due items
+         void place( object_id_type id, schedule_entry& e );
+         void drain( std::vector<item>& slot );
+         /// Removes the object described by @p e from its slot
+         void remove_from_slot( const schedule_entry& e );
+
+         uint32_t                                          _now = 0;
+         std::vector<item>                                 _slots[levels][1 << slot_bits];
+         std::set<item>                                    _overflow;
+         std::set<due_item>                                _due;
+         std::unordered_map<object_id_type,schedule_entry> _deadlines;
+   };
+
+   /**
+    *  @brief This secondary index schedules the objects of a primary index for their expiration
+    *
+    *  Inserted objects, including those restored by undo and those loaded from disk, are scheduled. Removed objects
+    *  are cancelled and modified objects rescheduled.
+    *
+    *  @tparam Object the type of the objects
+    *  @tparam Deadline returns the time an object expires at
+    */
+   template<typename Object, typename Deadline>
+   class expiration_schedule_index : public secondary_index
+   {
+      public:
+         explicit expiration_schedule_index( expiration_scheduler* scheduler ) : _scheduler( scheduler ) {}
+
+         virtual void object_inserted( const object& obj ) override
+         {
+            _scheduler->schedule( obj.id, Deadline()( static_cast<const Object&>(obj) ) );
+         }
+         virtual void object_removed( const object& obj ) override
+         {
+            _scheduler->cancel( obj.id );
+         }
+         virtual void object_modified( const object& after ) override
+         {
+            _scheduler->schedule( after.id, Deadline()( static_cast<const Object&>(after) ) );
+         }
+
+      private:
+         expiration_scheduler* _scheduler;
+   };
+
+} } // graphene::chain
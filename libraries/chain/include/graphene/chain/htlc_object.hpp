@@ -89,18 +89,12 @@ namespace graphene { namespace chain {
    };
 
    struct by_from_id;
-   struct by_expiration;
    struct by_to_id;
    using htlc_object_multi_index_type = multi_index_container<
          htlc_object,
          indexed_by<
             ordered_unique< tag< by_id >, member< object, object_id_type, &object::id > >,
 
-            ordered_unique< tag< by_expiration >, 
-                  composite_key< htlc_object,
-                  htlc_object::timelock_extractor,
-                  member< object, object_id_type, &object::id > > >,
-
             ordered_unique< tag< by_from_id >,
                   composite_key< htlc_object, 
                   htlc_object::from_extractor,
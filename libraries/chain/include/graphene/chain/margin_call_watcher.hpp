@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/price_sort_key.hpp>
+#include <graphene/db/index.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+namespace graphene { namespace chain {
+   using namespace graphene::db;
+
+   class database;
+   class asset_bitasset_data_object;
+
+   struct margin_call_stats
+   {
+      /// Checks of the call orders of market issued assets
+      uint64_t checks        = 0;
+      /// Checks skipped because nothing changed in the market since a check found nothing to do
+      uint64_t avoided_scans = 0;
+      /// Markets currently known to need no margin call
+      uint64_t quiet_markets = 0;
+      /// Quiet markets woken up by a change of their best orders, feed, settings or hard fork rules
+      uint64_t wakeups       = 0;
+   };
+
+   /**
+    *  @class margin_call_watcher
+    *  @brief Remembers the markets of market issued assets in which no margin call and no global settlement is due
+    *
+    *  When @ref database::check_call_orders finds nothing to do in the market of a debt asset, the market is marked
+    *  quiet together with what the verdict depended on: the best limit order selling the debt asset for the
+    *  collateral, the call orders first by call price and by collateralization, the maintenance time and the
+    *  rules of the hard forks that take effect at a head block time. Later checks of a quiet market are skipped.
+    *  A change of these orders, of the feed or of the settings of the asset wakes the market up. Orders behind the
+    *  best ones do not.
+    *
+    *  The watcher is not part of the undo state, the database clears it whenever changes are undone. It is only
+    *  updated from one thread, also while the object database is opened.
+    */
+   class margin_call_watcher
+   {
+      public:
+         /**
+          * Counts a check of the market of @p debt_asset
+          * @return true if the market is quiet, the maintenance time is still @p maint_time and the hard fork rules
+          *         that depend on the head block time are the same at @p head_time
+          */
+         bool is_quiet( asset_id_type debt_asset, fc::time_point_sec maint_time, fc::time_point_sec head_time );
+         /// Marks the market of the debt asset of @p bitasset quiet in the current state of @p db
+         void set_quiet( const database& db, const asset_bitasset_data_object& bitasset );
+         void wake( asset_id_type debt_asset );
+         void clear();
+
+         /// Wakes the market of the asset sold if the order is at or ahead of its best limit order
+         void on_limit_order_changed( const price_sort_key& sell_price );
+         /// Wakes the market of @p debt_asset if the call order is at or ahead of its first call orders
+         void on_call_order_changed( asset_id_type debt_asset, const price_sort_key& call_price,
+                                     const price_sort_key& collateralization );
+
+         margin_call_stats get_stats()const;
+
+      private:
+         /// Encodes the hard fork rules that check_call_orders selects by the head block time
+         static uint32_t head_time_rules( fc::time_point_sec head_time );
+
+         struct quiet_market
+         {
+            asset_id_type                 collateral_asset;
+            fc::time_point_sec            maint_time;
+            /// Hard fork rules that depend on the head block time, see head_time_rules()
+            uint32_t                      head_rules = 0;
+            /// Sell price of the best limit order selling the debt asset for the collateral
+            fc::optional<price_sort_key>  best_bid;
+            /// Keys of the call orders first by call price and by collateralization
+            fc::optional<price_sort_key>  least_call_price;
+            fc::optional<price_sort_key>  least_collateralization;
+         };
+
+         flat_map<asset_id_type, quiet_market> _quiet;
+         margin_call_stats                     _stats;
+   };
+
+   /// Wakes up the markets of limit orders inserted, removed or moved at or ahead of the best order
+   class margin_call_limit_order_index : public secondary_index
+   {
+      public:
+         explicit margin_call_limit_order_index( margin_call_watcher* watcher ) : _watcher( watcher ) {}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after ) override;
+
+      private:
+         margin_call_watcher* _watcher;
+         price_sort_key       _sell_price_before_modify;
+   };
+
+   /// Wakes up the markets of call orders inserted, removed or changed at or ahead of the first call orders
+   class margin_call_call_order_index : public secondary_index
+   {
+      public:
+         explicit margin_call_call_order_index( margin_call_watcher* watcher ) : _watcher( watcher ) {}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after ) override;
+
+      private:
+         margin_call_watcher* _watcher;
+         price_sort_key       _call_price_before_modify;
+         price_sort_key       _collateralization_before_modify;
+   };
+
+   /// Wakes up the markets of assets whose feed or settings that margin calls depend on change
+   class margin_call_bitasset_index : public secondary_index
+   {
+      public:
+         explicit margin_call_bitasset_index( margin_call_watcher* watcher ) : _watcher( watcher ) {}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after ) override;
+
+      private:
+         margin_call_watcher* _watcher;
+         /// Fields of the asset being modified that margin calls depend on
+         price                _settlement_price_before_modify;
+         uint16_t             _mcr_before_modify = 0;
+         uint16_t             _mssr_before_modify = 0;
+         price                _maintenance_collateralization_before_modify;
+         price                _global_settlement_before_modify;
+         asset_id_type        _backing_asset_before_modify;
+         bool                 _prediction_market_before_modify = false;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::margin_call_stats, (checks)(avoided_scans)(quiet_markets)(wakeups) )
@@ -23,12 +23,17 @@
  */
 #pragma once
 
+#include <graphene/chain/price_sort_key.hpp>
 #include <graphene/chain/types.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <graphene/protocol/asset.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <iterator>
+#include <map>
+#include <set>
+
 namespace graphene { namespace chain {
 
 using namespace graphene::db;
@@ -51,6 +56,15 @@ class limit_order_object : public abstract_object<limit_order_object, protocol_i
       share_type       deferred_fee; ///< fee converted to CORE
       asset            deferred_paid_fee; ///< originally paid fee
 
+      /// Sort key of @ref sell_price, kept up to date by the index
+      price_sort_key   sell_price_key;
+
+      void update_sort_keys()
+      {
+         if( !sell_price_key.matches( sell_price ) )
+            sell_price_key = price_sort_key( sell_price );
+      }
+
       pair<asset_id_type,asset_id_type> get_market()const
       {
          auto tmp = std::make_pair( sell_price.base.asset_id, sell_price.quote.asset_id );
@@ -65,25 +79,18 @@ class limit_order_object : public abstract_object<limit_order_object, protocol_i
 };
 
 struct by_price;
-struct by_expiration;
 struct by_account;
 struct by_account_price;
 typedef multi_index_container<
    limit_order_object,
    indexed_by<
       ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-      ordered_unique< tag<by_expiration>,
-         composite_key< limit_order_object,
-            member< limit_order_object, time_point_sec, &limit_order_object::expiration>,
-            member< object, object_id_type, &object::id>
-         >
-      >,
       ordered_unique< tag<by_price>,
          composite_key< limit_order_object,
-            member< limit_order_object, price, &limit_order_object::sell_price>,
+            member< limit_order_object, price_sort_key, &limit_order_object::sell_price_key >,
             member< object, object_id_type, &object::id>
          >,
-         composite_key_compare< std::greater<price>, std::less<object_id_type> >
+         composite_key_compare< price_sort_key_greater, std::less<object_id_type> >
       >,
       // index used by APIs
       ordered_unique< tag<by_account>,
@@ -96,16 +103,101 @@ typedef multi_index_container<
       ordered_unique< tag<by_account_price>,
          composite_key< limit_order_object,
             member<limit_order_object, account_id_type, &limit_order_object::seller>,
-            member<limit_order_object, price, &limit_order_object::sell_price>,
+            member<limit_order_object, price_sort_key, &limit_order_object::sell_price_key>,
             member<object, object_id_type, &object::id>
          >,
-         composite_key_compare<std::less<account_id_type>, std::greater<price>, std::less<object_id_type>>
+         composite_key_compare<std::less<account_id_type>, price_sort_key_greater, std::less<object_id_type>>
       >
    >
 > limit_order_multi_index_type;
 
 typedef generic_index<limit_order_object, limit_order_multi_index_type> limit_order_index;
 
+/**
+ *  @brief The limit orders of each side of each market, grouped in price levels, used for matching
+ *
+ *  Orders are kept per pair of the asset they sell and the asset they receive. The price levels of a side are
+ *  ordered from the best price to the worst and the orders of a level by their IDs, i.e. first in first out.
+ *  This is the order of the @ref by_price index restricted to one side of a market, so a lookup only compares
+ *  the prices of that side and orders at the same price are only compared by ID.
+ */
+class limit_order_book_index : public secondary_index
+{
+   public:
+      struct id_less
+      {
+         bool operator()( const limit_order_object* a, const limit_order_object* b )const { return a->id < b->id; }
+      };
+      /// Orders at the same price, oldest first
+      typedef std::set< const limit_order_object*, id_less >      price_level;
+      /// Price levels of one side of a market, best price first
+      typedef std::map< price_sort_key, price_level, price_sort_key_greater > order_book;
+
+      /// Iterates over the orders of one side of a market. It stays valid while other orders are removed.
+      class const_iterator
+      {
+         public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef limit_order_object        value_type;
+            typedef std::ptrdiff_t            difference_type;
+            typedef const limit_order_object* pointer;
+            typedef const limit_order_object& reference;
+
+            const_iterator() = default;
+
+            reference operator*()const  { return **_order; }
+            pointer   operator->()const { return *_order; }
+
+            const_iterator& operator++()
+            {
+               if( ++_order == _level->second.end() && ++_level != _book->end() )
+                  _order = _level->second.begin();
+               return *this;
+            }
+            const_iterator operator++(int) { const_iterator tmp = *this; ++*this; return tmp; }
+
+            bool operator==( const const_iterator& other )const
+            { return _level == other._level && ( _level == _book->end() || _order == other._order ); }
+            bool operator!=( const const_iterator& other )const { return !( *this == other ); }
+
+         private:
+            friend class limit_order_book_index;
+            const_iterator( const order_book* book, order_book::const_iterator level )
+            : _book( book ), _level( level )
+            {
+               if( _level != _book->end() )
+                  _order = _level->second.begin();
+            }
+
+            const order_book*            _book = nullptr;
+            order_book::const_iterator   _level;
+            price_level::const_iterator  _order;
+      };
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /// @return the best order selling @p sell for @p receive
+      const_iterator begin( asset_id_type sell, asset_id_type receive )const;
+      const_iterator end( asset_id_type sell, asset_id_type receive )const;
+      /// @return the first order at price @p p or worse, among the orders selling the base asset of @p p for its quote
+      const_iterator lower_bound( const price& p )const;
+      /// @return the first order at a price worse than @p p, among the orders selling the base asset of @p p for its quote
+      const_iterator upper_bound( const price& p )const;
+
+   private:
+      const order_book& get_book( asset_id_type sell, asset_id_type receive )const;
+      void insert( const limit_order_object& o );
+      void erase( const limit_order_object& o, const price_sort_key& sell_price );
+
+      /// Books are never erased, so that the end of an empty book stays valid
+      std::map< std::pair< asset_id_type, asset_id_type >, order_book > _books;
+      /// Price of the order being modified
+      price_sort_key _price_before_modify;
+};
+
 /**
  * @class call_order_object
  * @brief tracks debt and call price information
@@ -130,6 +222,19 @@ class call_order_object : public abstract_object<call_order_object, protocol_ids
 
       optional<uint16_t> target_collateral_ratio; ///< maximum CR to maintain when selling collateral on margin call
 
+      /// Sort keys of @ref call_price and @ref collateralization, kept up to date by the index
+      price_sort_key   call_price_key;
+      price_sort_key   collateralization_key;
+
+      void update_sort_keys()
+      {
+         if( !call_price_key.matches( call_price ) )
+            call_price_key = price_sort_key( call_price );
+         const price current_collateralization( get_collateral(), get_debt() );
+         if( !collateralization_key.matches( current_collateralization ) )
+            collateralization_key = price_sort_key( current_collateralization );
+      }
+
       pair<asset_id_type,asset_id_type> get_market()const
       {
          auto tmp = std::make_pair( call_price.base.asset_id, call_price.quote.asset_id );
@@ -188,6 +293,15 @@ class collateral_bid_object : public abstract_object<collateral_bid_object,
 
       account_id_type  bidder;
       price            inv_swan_price;  // Collateral / Debt
+
+      /// Sort key of @ref inv_swan_price, kept up to date by the index
+      price_sort_key   inv_swan_price_key;
+
+      void update_sort_keys()
+      {
+         if( !inv_swan_price_key.matches( inv_swan_price ) )
+            inv_swan_price_key = price_sort_key( inv_swan_price );
+      }
 };
 
 struct by_collateral;
@@ -200,10 +314,10 @@ typedef multi_index_container<
          member< object, object_id_type, &object::id > >,
       ordered_unique< tag<by_price>,
          composite_key< call_order_object,
-            member< call_order_object, price, &call_order_object::call_price>,
+            member< call_order_object, price_sort_key, &call_order_object::call_price_key >,
             member< object, object_id_type, &object::id>
          >,
-         composite_key_compare< std::less<price>, std::less<object_id_type> >
+         composite_key_compare< price_sort_key_less, std::less<object_id_type> >
       >,
       ordered_unique< tag<by_account>,
          composite_key< call_order_object,
@@ -213,9 +327,10 @@ typedef multi_index_container<
       >,
       ordered_unique< tag<by_collateral>,
          composite_key< call_order_object,
-            const_mem_fun< call_order_object, price, &call_order_object::collateralization >,
+            member< call_order_object, price_sort_key, &call_order_object::collateralization_key >,
             member< object, object_id_type, &object::id >
-         >
+         >,
+         composite_key_compare< price_sort_key_less, std::less<object_id_type> >
       >
    >
 > call_order_multi_index_type;
@@ -255,10 +370,10 @@ typedef multi_index_container<
       ordered_unique< tag<by_price>,
          composite_key< collateral_bid_object,
             const_mem_fun< collateral_bid_object, asset_id_type, &collateral_bid_object::debt_type>,
-            member< collateral_bid_object, price, &collateral_bid_object::inv_swan_price >,
+            member< collateral_bid_object, price_sort_key, &collateral_bid_object::inv_swan_price_key >,
             member< object, object_id_type, &object::id >
          >,
-         composite_key_compare< std::less<asset_id_type>, std::greater<price>, std::less<object_id_type> >
+         composite_key_compare< std::less<asset_id_type>, price_sort_key_greater, std::less<object_id_type> >
       >
    >
 > collateral_bid_object_multi_index_type;
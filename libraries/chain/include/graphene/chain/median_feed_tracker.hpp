@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/asset.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/time.hpp>
+
+#include <boost/container/flat_set.hpp>
+
+#include <cstdint>
+#include <utility>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /**
+    *  @brief The live feeds of a bitasset, ordered by each of their fields to read the median feed
+    *
+    *  The values of each field of the feeds that are alive are kept in sorted vectors. The median of a field is
+    *  read at its position, and publishing or expiring a feed inserts or erases one value per field.
+    *
+    *  The median feed is the same as the one std::nth_element selects among the live feeds, as long as the median
+    *  of each field is unique. Equivalent prices can have different amounts though, and nth_element may return any
+    *  of them. Prices with amounts that are not positive are not ordered consistently. In these cases the tracker
+    *  reports that it has no median, and the caller selects it from the feeds.
+    *
+    *  Republishing a live feed with the same values only updates its publication time, so that the median can be
+    *  kept when the values did not change since it was selected.
+    *
+    *  The tracker is not serialized, and a bitasset holds it out of line so that copies of the object, e.g. the
+    *  ones the undo database keeps of removed objects, only share it. Each change of the tracker gives it a new
+    *  stamp, and the object remembers the stamp of the tracker state that matches its feeds. Copies that did not
+    *  make the last change, objects restored from an undo image and objects loaded from disk do not have a
+    *  matching stamp, their tracker is rebuilt from all the feeds on the next update.
+    */
+   class median_feed_tracker
+   {
+      public:
+         typedef std::pair<time_point_sec, price_feed>             published_feed;
+         typedef flat_map<account_id_type, published_feed>         feed_map;
+
+         /// @return true if the tracker can be updated to @p now, with feeds that live for @p lifetime seconds
+         bool is_valid_for( time_point_sec now, uint32_t lifetime )const
+         { return _valid && _lifetime == lifetime && _now <= now; }
+
+         /// @return true if the feeds among @p feeds that were alive at the last update are the tracked ones
+         bool matches( const feed_map& feeds )const;
+         /// Tracks the feeds among @p feeds that are alive at @p now
+         void rebuild( const feed_map& feeds, time_point_sec now, uint32_t lifetime );
+         /// Tracks the feed @p feed of @p publisher, which replaces its previous feed
+         void set_feed( account_id_type publisher, const published_feed& feed );
+         /// Drops the feeds that are not alive at @p now
+         void expire( time_point_sec now );
+
+         /// Number of live feeds
+         size_t size()const { return _live.size(); }
+         /// Publication time of the oldest live feed, there must be one
+         time_point_sec oldest_publication_time()const { return _by_time.begin()->first; }
+         /// The only live feed, there must be exactly one
+         const price_feed& only_feed()const { return _live.begin()->second.second; }
+
+         /**
+          * Sets each field of @p result to the median of the field among the live feeds, i.e. to the value at
+          * position size()/2 when the values are sorted
+          * @return false if a median price is not unique, then @p result is not set
+          */
+         bool get_median( price_feed& result )const;
+
+         /// @return true if the values of the live feeds did not change since set_median_current( true ) was called
+         bool is_median_current()const { return _median_current; }
+         /// Records whether the median of the live feeds is in use, until their values change
+         void set_median_current( bool current ) { _median_current = current; }
+
+         /// @return the stamp given by the last call to @ref restamp, 0 if there was none
+         uint64_t stamp()const { return _stamp; }
+         /// To be called after each change, gives the tracker a stamp that no tracker had before
+         uint64_t restamp();
+
+      private:
+         bool is_alive( time_point_sec published )const;
+         void insert( account_id_type publisher, const published_feed& feed );
+         void erase( feed_map::iterator itr );
+
+         typedef boost::container::flat_multiset< price >     price_values;
+         typedef boost::container::flat_multiset< uint16_t >  ratio_values;
+
+         bool                    _valid = false;
+         uint64_t                _stamp = 0;
+         bool                    _median_current = false;
+         time_point_sec          _now;
+         uint32_t                _lifetime = 0;
+         /// Copies of the live feeds, whose values are erased from the sorted values below when they expire
+         feed_map                _live;
+         flat_set< std::pair<time_point_sec, account_id_type> > _by_time;
+         price_values            _settlement_prices;
+         ratio_values            _maintenance_collateral_ratios;
+         ratio_values            _maximum_short_squeeze_ratios;
+         price_values            _core_exchange_rates;
+         /// Live feeds with a price that has an amount which is not positive, their prices are not in the sets
+         uint32_t                _irregular_feeds = 0;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/transaction.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   struct mempool_stats
+   {
+      /// Number and total size in a block of the pending transactions
+      uint64_t transactions    = 0;
+      uint64_t bytes           = 0;
+      /// Pending transactions that wait to be applied again after a block, not included above
+      uint64_t deferred        = 0;
+      /// Configured limits, 0 means unlimited
+      uint64_t max_bytes       = 0;
+      uint32_t max_per_account = 0;
+      /// Lowest and highest fee per kilobyte of the pending transactions, in core asset
+      uint64_t min_fee_per_kb  = 0;
+      uint64_t max_fee_per_kb  = 0;
+      /// Counters since startup
+      uint64_t accepted        = 0;
+      uint64_t rejected        = 0;
+      uint64_t evicted         = 0;
+      uint64_t expired         = 0;
+   };
+
+   /**
+    *  @class mempool
+    *  @brief The pending transactions of a node, ordered by arrival and by the fee they pay per byte
+    *
+    *  The pool can be bounded in total size and in number of transactions per fee paying account. When it is full,
+    *  a new transaction is only admitted if it pays a higher fee per byte than the transactions it evicts.
+    *
+    *  The pool only keeps transactions, the database applies them to its pending state. Whenever transactions are
+    *  evicted, the pending state has to be rebuilt from the remaining ones. To not do that for every admitted
+    *  transaction once the pool is full, evictions free another 1/eviction_batch_divisor of the size limit if
+    *  enough transactions paying less than the new one are pending.
+    */
+   class mempool
+   {
+      public:
+         struct entry
+         {
+            processed_transaction trx;
+            transaction_id_type   id;
+            /// Position in the order of arrival
+            uint64_t              seq = 0;
+            /// Size of @ref trx in a block, i.e. including signatures
+            uint64_t              size = 0;
+            /// Fee paid by the transaction in core asset per 1024 bytes
+            uint64_t              fee_per_kb = 0;
+            /// Fee payer of the first operation
+            account_id_type       payer;
+            time_point_sec        expiration;
+         };
+
+         struct by_arrival;
+         struct by_trx_id;
+         struct by_fee_rate;
+         struct by_expiration;
+         struct by_payer;
+         typedef boost::multi_index_container<
+            entry,
+            boost::multi_index::indexed_by<
+               boost::multi_index::ordered_unique< boost::multi_index::tag<by_arrival>,
+                  boost::multi_index::member< entry, uint64_t, &entry::seq > >,
+               // not unique, transactions are pushed again when duplicate checks are skipped
+               boost::multi_index::hashed_non_unique< boost::multi_index::tag<by_trx_id>,
+                  boost::multi_index::member< entry, transaction_id_type, &entry::id > >,
+               boost::multi_index::ordered_unique< boost::multi_index::tag<by_fee_rate>,
+                  boost::multi_index::composite_key< entry,
+                     boost::multi_index::member< entry, uint64_t, &entry::fee_per_kb >,
+                     boost::multi_index::member< entry, uint64_t, &entry::seq >
+                  >,
+                  boost::multi_index::composite_key_compare< std::greater<uint64_t>, std::less<uint64_t> >
+               >,
+               boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_expiration>,
+                  boost::multi_index::member< entry, time_point_sec, &entry::expiration > >,
+               boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_payer>,
+                  boost::multi_index::member< entry, account_id_type, &entry::payer > >
+            >
+         > entry_index;
+
+         static constexpr uint64_t eviction_batch_divisor = 16;
+
+         /// @return the fee per 1024 bytes of a transaction of @p size bytes paying @p core_fee
+         static uint64_t fee_per_kb( share_type core_fee, uint64_t size );
+
+         /// Sets the limits of the pool, 0 means unlimited. Does not evict anything.
+         void set_limits( uint64_t max_bytes, uint32_t max_per_account );
+
+         /**
+          * Checks whether a transaction can be admitted, throws if it can not. Does not change the pool.
+          * @param payer the fee payer of the transaction
+          * @param size the size of the transaction in a block
+          * @param fee_per_kb the fee rate of the transaction
+          * @return the arrival positions (@ref entry::seq) of the pending transactions paying the lowest fees per
+          *         byte that have to be evicted to admit the transaction, in ascending order
+          */
+         std::vector<uint64_t> check_admission( account_id_type payer, uint64_t size, uint64_t fee_per_kb );
+
+         /// Adds a transaction that has been applied to the pending state
+         void   insert( const processed_transaction& trx, account_id_type payer, uint64_t size, uint64_t fee_per_kb );
+         /// Removes the pending transactions at the arrival positions @p seqs, as returned by check_admission()
+         size_t evict( const std::vector<uint64_t>& seqs );
+
+         /// Removes a transaction with @p id, if one is pending
+         bool   remove( const transaction_id_type& id );
+         /// Removes the transactions that expire before @p now
+         size_t remove_expired( time_point_sec now );
+         /// Counts transactions that have been dropped by expiration while the pool was released
+         void   record_expired( size_t count ) { _stats.expired += count; }
+
+         /**
+          * Selects the transactions to include in a block, those paying the highest fees per byte first, as long as
+          * their total size does not exceed @p max_size.
+          * @return the selected transactions in the order of their arrival
+          */
+         std::vector<const processed_transaction*> select( uint64_t max_size )const;
+
+         /// Removes all transactions and returns them in the order of their arrival
+         std::vector<processed_transaction> release();
+         void clear();
+
+         bool   empty()const { return _entries.empty(); }
+         size_t size()const  { return _entries.size(); }
+         bool   contains( const transaction_id_type& id )const;
+         /// @return the pending transaction with @p id, or nullptr if there is none
+         const processed_transaction* find( const transaction_id_type& id )const;
+         /// All pending transactions, use @ref by_arrival to iterate in the order of their arrival
+         const entry_index& entries()const { return _entries; }
+
+         mempool_stats get_stats()const;
+
+      private:
+         void erase( entry_index::iterator itr );
+
+         entry_index    _entries;
+         uint64_t       _next_seq = 0;
+         uint64_t       _bytes = 0;
+         uint64_t       _max_bytes = 0;
+         uint32_t       _max_per_account = 0;
+         mempool_stats  _stats;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::mempool_stats,
+            (transactions)(bytes)(deferred)(max_bytes)(max_per_account)(min_fee_per_kb)(max_fee_per_kb)
+            (accepted)(rejected)(evicted)(expired) )
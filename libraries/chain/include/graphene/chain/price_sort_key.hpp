@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/asset.hpp>
+
+#include <fc/uint128.hpp>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /**
+    *  @brief A price with a precomputed key that orders it among the prices of its market with integer comparisons
+    *
+    *  Keys are ordered exactly like the prices they are made of by @ref price::operator<, i.e. by base asset, quote
+    *  asset and ratio of the amounts. The ratio is represented by a 64-bit number, the binary logarithm of the
+    *  ratio and its leading bits, which increases with the ratio. Only if the numbers of two keys are equal, the
+    *  amounts are cross-multiplied to compare the exact ratios.
+    */
+   struct price_sort_key
+   {
+      price_sort_key() = default;
+      explicit price_sort_key( const price& p );
+
+      asset_id_type  base_asset;
+      asset_id_type  quote_asset;
+      /// Increases with base_amount / quote_amount, 0 if an amount is not positive
+      uint64_t       ratio = 0;
+      int64_t        base_amount = 0;
+      int64_t        quote_amount = 0;
+
+      /// @return true if the key is made of exactly @p p, i.e. of the same assets and amounts
+      bool matches( const price& p )const
+      {
+         return base_amount == p.base.amount.value && quote_amount == p.quote.amount.value
+                && base_asset == p.base.asset_id && quote_asset == p.quote.asset_id;
+      }
+
+      /// Compares the ratio with that of @p b, both with the same assets, like @ref price::operator<
+      bool ratio_less( const price_sort_key& b )const
+      {
+         if( ratio != b.ratio && ratio != 0 && b.ratio != 0 )
+            return ratio < b.ratio;
+         return fc::uint128_t( b.quote_amount ) * base_amount < fc::uint128_t( quote_amount ) * b.base_amount;
+      }
+      bool ratio_less( const price& b )const
+      {
+         return fc::uint128_t( b.quote.amount.value ) * base_amount
+                < fc::uint128_t( quote_amount ) * b.base.amount.value;
+      }
+      bool ratio_greater( const price& b )const
+      {
+         return fc::uint128_t( quote_amount ) * b.base.amount.value
+                < fc::uint128_t( b.quote.amount.value ) * base_amount;
+      }
+   };
+
+   inline bool operator < ( const price_sort_key& a, const price_sort_key& b )
+   {
+      if( a.base_asset != b.base_asset ) return a.base_asset < b.base_asset;
+      if( a.quote_asset != b.quote_asset ) return a.quote_asset < b.quote_asset;
+      return a.ratio_less( b );
+   }
+   inline bool operator < ( const price_sort_key& a, const price& b )
+   {
+      if( a.base_asset != b.base.asset_id ) return a.base_asset < b.base.asset_id;
+      if( a.quote_asset != b.quote.asset_id ) return a.quote_asset < b.quote.asset_id;
+      return a.ratio_less( b );
+   }
+   inline bool operator < ( const price& a, const price_sort_key& b )
+   {
+      if( a.base.asset_id != b.base_asset ) return a.base.asset_id < b.base_asset;
+      if( a.quote.asset_id != b.quote_asset ) return a.quote.asset_id < b.quote_asset;
+      return b.ratio_greater( a );
+   }
+
+   /// Orders keys, and prices looked up among keys, like prices; std::less and std::greater do not mix the types
+   struct price_sort_key_less
+   {
+      typedef void is_transparent;
+      template<typename A, typename B>
+      bool operator()( const A& a, const B& b )const { return a < b; }
+   };
+   struct price_sort_key_greater
+   {
+      typedef void is_transparent;
+      template<typename A, typename B>
+      bool operator()( const A& a, const B& b )const { return b < a; }
+   };
+
+} } // graphene::chain
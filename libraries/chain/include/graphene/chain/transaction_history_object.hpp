@@ -30,7 +30,6 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/mem_fun.hpp>
 
 namespace graphene { namespace chain {
    using namespace graphene::db;
@@ -40,27 +39,28 @@ namespace graphene { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_history_object is added. At the end of block processing all transaction_history_objects that
     * have expired can be removed from the index.
+    *
+    * The object does not keep a copy of the transaction, only where to find it: the number of the block that includes
+    * it and its position in the block, or block number 0 while the transaction is pending.
     */
    class transaction_history_object : public abstract_object<transaction_history_object,
                                                              implementation_ids, impl_transaction_history_object_type>
    {
       public:
-         signed_transaction  trx;
          transaction_id_type trx_id;
-
-         time_point_sec get_expiration()const { return trx.expiration; }
+         time_point_sec      expiration;
+         /// Number of the block that includes the transaction, 0 if it is pending
+         uint32_t            block_num = 0;
+         uint16_t            trx_in_block = 0;
    };
 
-   struct by_expiration;
    struct by_trx_id;
    typedef multi_index_container<
       transaction_history_object,
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_history_object, transaction_id_type, trx_id),
-                        std::hash<transaction_id_type> >,
-         ordered_non_unique< tag<by_expiration>, const_mem_fun< transaction_history_object, time_point_sec,
-                                                                &transaction_history_object::get_expiration > >
+                        std::hash<transaction_id_type> >
       >
    > transaction_multi_index_type;
 
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/transaction.hpp>
+
+#include <vector>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /// @return true if applying @p trx may change authorities that other transactions are verified against
+   bool changes_authorities( const transaction& trx );
+
+   /**
+    *  Splits transactions into consecutive runs whose checks, validation and the authority checks, only read state
+    *  that no transaction of the run writes before them. A transaction that changes authorities ends its run.
+    *  Transactions of a run may still conflict in what their operations apply, they are applied serially.
+    *
+    *  @return the index of the first transaction of each run
+    */
+   template<typename Trx>
+   std::vector<size_t> schedule_check_runs( const std::vector<Trx>& trxs )
+   {
+      std::vector<size_t> runs;
+      bool run_closed = true;
+      for( size_t i = 0; i < trxs.size(); ++i )
+      {
+         if( run_closed )
+            runs.push_back( i );
+         run_closed = changes_authorities( trxs[i] );
+      }
+      return runs;
+   }
+
+} } // graphene::chain
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/margin_call_watcher.hpp>
+
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/market_object.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+   /// Prices with the same amounts, unlike price::operator== which compares the ratios
+   bool same_price( const price& a, const price& b )
+   {
+      return a.base == b.base && a.quote == b.quote;
+   }
+
+   bool same_market( const price_sort_key& key, asset_id_type base, asset_id_type quote )
+   {
+      return key.base_asset == base && key.quote_asset == quote;
+   }
+}
+
+uint32_t margin_call_watcher::head_time_rules( fc::time_point_sec head_time )
+{
+   // must match the head block time checks in database::check_call_orders
+   return ( head_time > HARDFORK_436_TIME ? 1 : 0 ) | ( head_time < HARDFORK_615_TIME ? 2 : 0 );
+}
+
+bool margin_call_watcher::is_quiet( asset_id_type debt_asset, fc::time_point_sec maint_time,
+                                    fc::time_point_sec head_time )
+{
+   ++_stats.checks;
+   auto itr = _quiet.find( debt_asset );
+   if( itr == _quiet.end() )
+      return false;
+   if( itr->second.maint_time != maint_time || itr->second.head_rules != head_time_rules( head_time ) )
+   {
+      _quiet.erase( itr );
+      ++_stats.wakeups;
+      return false;
+   }
+   ++_stats.avoided_scans;
+   return true;
+}
+
+void margin_call_watcher::set_quiet( const database& db, const asset_bitasset_data_object& bitasset )
+{
+   const asset_id_type debt_asset = bitasset.asset_id;
+   quiet_market& market = _quiet[ debt_asset ];
+   market.collateral_asset = bitasset.options.short_backing_asset;
+   market.maint_time = db.get_dynamic_global_properties().next_maintenance_time;
+   market.head_rules = head_time_rules( db.head_block_time() );
+
+   const auto& limit_price_idx = db.get_index_type<limit_order_index>().indices().get<by_price>();
+   auto limit_itr = limit_price_idx.lower_bound( price_sort_key( price::max( debt_asset, market.collateral_asset ) ) );
+   market.best_bid.reset();
+   if( limit_itr != limit_price_idx.end()
+         && same_market( limit_itr->sell_price_key, debt_asset, market.collateral_asset ) )
+      market.best_bid = limit_itr->sell_price_key;
+
+   const price_sort_key call_min( price::min( market.collateral_asset, debt_asset ) );
+   const auto& call_index = db.get_index_type<call_order_index>().indices();
+   const auto& call_price_idx = call_index.get<by_price>();
+   auto call_price_itr = call_price_idx.lower_bound( call_min );
+   market.least_call_price.reset();
+   if( call_price_itr != call_price_idx.end()
+         && same_market( call_price_itr->call_price_key, market.collateral_asset, debt_asset ) )
+      market.least_call_price = call_price_itr->call_price_key;
+
+   const auto& call_collateral_idx = call_index.get<by_collateral>();
+   auto call_collateral_itr = call_collateral_idx.lower_bound( call_min );
+   market.least_collateralization.reset();
+   if( call_collateral_itr != call_collateral_idx.end()
+         && same_market( call_collateral_itr->collateralization_key, market.collateral_asset, debt_asset ) )
+      market.least_collateralization = call_collateral_itr->collateralization_key;
+}
+
+void margin_call_watcher::wake( asset_id_type debt_asset )
+{
+   if( _quiet.erase( debt_asset ) > 0 )
+      ++_stats.wakeups;
+}
+
+void margin_call_watcher::clear()
+{
+   _quiet.clear();
+}
+
+void margin_call_watcher::on_limit_order_changed( const price_sort_key& sell_price )
+{
+   auto itr = _quiet.find( sell_price.base_asset );
+   if( itr == _quiet.end() || itr->second.collateral_asset != sell_price.quote_asset )
+      return;
+   // limit orders are better at higher prices
+   const auto& best_bid = itr->second.best_bid;
+   if( !best_bid.valid() || !( sell_price < *best_bid ) )
+      wake( sell_price.base_asset );
+}
+
+void margin_call_watcher::on_call_order_changed( asset_id_type debt_asset, const price_sort_key& call_price,
+                                                 const price_sort_key& collateralization )
+{
+   auto itr = _quiet.find( debt_asset );
+   if( itr == _quiet.end() )
+      return;
+   // call orders are called first at lower prices
+   const quiet_market& market = itr->second;
+   if( !market.least_call_price.valid() || !( *market.least_call_price < call_price )
+         || !market.least_collateralization.valid() || !( *market.least_collateralization < collateralization ) )
+      wake( debt_asset );
+}
+
+margin_call_stats margin_call_watcher::get_stats()const
+{
+   margin_call_stats result = _stats;
+   result.quiet_markets = _quiet.size();
+   return result;
+}
+
+void margin_call_limit_order_index::object_inserted( const object& obj )
+{
+   _watcher->on_limit_order_changed( static_cast<const limit_order_object&>( obj ).sell_price_key );
+}
+
+void margin_call_limit_order_index::object_removed( const object& obj )
+{
+   _watcher->on_limit_order_changed( static_cast<const limit_order_object&>( obj ).sell_price_key );
+}
+
+void margin_call_limit_order_index::about_to_modify( const object& before )
+{
+   _sell_price_before_modify = static_cast<const limit_order_object&>( before ).sell_price_key;
+}
+
+void margin_call_limit_order_index::object_modified( const object& after )
+{
+   const auto& o = static_cast<const limit_order_object&>( after );
+   // filling an order does not change its price, and margin calls only depend on the price of the best order
+   if( !( o.sell_price_key < _sell_price_before_modify ) && !( _sell_price_before_modify < o.sell_price_key ) )
+      return;
+   _watcher->on_limit_order_changed( _sell_price_before_modify );
+   _watcher->on_limit_order_changed( o.sell_price_key );
+}
+
+void margin_call_call_order_index::object_inserted( const object& obj )
+{
+   const auto& o = static_cast<const call_order_object&>( obj );
+   _watcher->on_call_order_changed( o.debt_type(), o.call_price_key, o.collateralization_key );
+}
+
+void margin_call_call_order_index::object_removed( const object& obj )
+{
+   const auto& o = static_cast<const call_order_object&>( obj );
+   _watcher->on_call_order_changed( o.debt_type(), o.call_price_key, o.collateralization_key );
+}
+
+void margin_call_call_order_index::about_to_modify( const object& before )
+{
+   const auto& o = static_cast<const call_order_object&>( before );
+   _call_price_before_modify = o.call_price_key;
+   _collateralization_before_modify = o.collateralization_key;
+}
+
+void margin_call_call_order_index::object_modified( const object& after )
+{
+   const auto& o = static_cast<const call_order_object&>( after );
+   _watcher->on_call_order_changed( o.debt_type(), _call_price_before_modify, _collateralization_before_modify );
+   _watcher->on_call_order_changed( o.debt_type(), o.call_price_key, o.collateralization_key );
+}
+
+void margin_call_bitasset_index::object_inserted( const object& obj )
+{
+   _watcher->wake( static_cast<const asset_bitasset_data_object&>( obj ).asset_id );
+}
+
+void margin_call_bitasset_index::object_removed( const object& obj )
+{
+   _watcher->wake( static_cast<const asset_bitasset_data_object&>( obj ).asset_id );
+}
+
+void margin_call_bitasset_index::about_to_modify( const object& before )
+{
+   const auto& o = static_cast<const asset_bitasset_data_object&>( before );
+   _settlement_price_before_modify = o.current_feed.settlement_price;
+   _mcr_before_modify = o.current_feed.maintenance_collateral_ratio;
+   _mssr_before_modify = o.current_feed.maximum_short_squeeze_ratio;
+   _maintenance_collateralization_before_modify = o.current_maintenance_collateralization;
+   _global_settlement_before_modify = o.settlement_price;
+   _backing_asset_before_modify = o.options.short_backing_asset;
+   _prediction_market_before_modify = o.is_prediction_market;
+}
+
+void margin_call_bitasset_index::object_modified( const object& after )
+{
+   const auto& o = static_cast<const asset_bitasset_data_object&>( after );
+   // publishing a feed that does not change the median only changes the list of feeds
+   if( same_price( o.current_feed.settlement_price, _settlement_price_before_modify )
+         && o.current_feed.maintenance_collateral_ratio == _mcr_before_modify
+         && o.current_feed.maximum_short_squeeze_ratio == _mssr_before_modify
+         && same_price( o.current_maintenance_collateralization, _maintenance_collateralization_before_modify )
+         && same_price( o.settlement_price, _global_settlement_before_modify )
+         && o.options.short_backing_asset == _backing_asset_before_modify
+         && o.is_prediction_market == _prediction_market_before_modify )
+      return;
+   _watcher->wake( o.asset_id );
+}
+
+} } // graphene::chain
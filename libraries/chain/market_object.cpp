@@ -303,6 +303,86 @@ share_type call_order_object::get_max_debt_to_cover( price match_price,
 
 } FC_CAPTURE_AND_RETHROW( (*this)(feed_price)(match_price)(maintenance_collateral_ratio) ) } // GCOVR_EXCL_LINE
 
+void limit_order_book_index::insert( const limit_order_object& o )
+{
+   auto& book = _books[ std::make_pair( o.sell_asset_id(), o.receive_asset_id() ) ];
+   book[ o.sell_price_key ].insert( &o );
+}
+
+void limit_order_book_index::erase( const limit_order_object& o, const price_sort_key& sell_price )
+{
+   auto book_itr = _books.find( std::make_pair( sell_price.base_asset, sell_price.quote_asset ) );
+   if( book_itr == _books.end() )
+      return;
+   auto& book = book_itr->second;
+   auto level_itr = book.find( sell_price );
+   if( level_itr == book.end() )
+      return;
+   level_itr->second.erase( &o );
+   if( level_itr->second.empty() )
+      book.erase( level_itr );
+}
+
+void limit_order_book_index::object_inserted( const object& obj )
+{
+   insert( static_cast< const limit_order_object& >( obj ) );
+}
+
+void limit_order_book_index::object_removed( const object& obj )
+{
+   const auto& o = static_cast< const limit_order_object& >( obj );
+   erase( o, o.sell_price_key );
+}
+
+void limit_order_book_index::about_to_modify( const object& before )
+{
+   _price_before_modify = static_cast< const limit_order_object& >( before ).sell_price_key;
+}
+
+void limit_order_book_index::object_modified( const object& after )
+{
+   const auto& o = static_cast< const limit_order_object& >( after );
+   // orders are filled in place, only a change of the price moves an order
+   if( !( o.sell_price_key < _price_before_modify ) && !( _price_before_modify < o.sell_price_key ) )
+      return;
+   erase( o, _price_before_modify );
+   insert( o );
+}
+
+const limit_order_book_index::order_book& limit_order_book_index::get_book( asset_id_type sell,
+                                                                           asset_id_type receive )const
+{
+   static const order_book empty_book;
+   auto itr = _books.find( std::make_pair( sell, receive ) );
+   return itr == _books.end() ? empty_book : itr->second;
+}
+
+limit_order_book_index::const_iterator limit_order_book_index::begin( asset_id_type sell,
+                                                                      asset_id_type receive )const
+{
+   const order_book& book = get_book( sell, receive );
+   return const_iterator( &book, book.begin() );
+}
+
+limit_order_book_index::const_iterator limit_order_book_index::end( asset_id_type sell,
+                                                                    asset_id_type receive )const
+{
+   const order_book& book = get_book( sell, receive );
+   return const_iterator( &book, book.end() );
+}
+
+limit_order_book_index::const_iterator limit_order_book_index::lower_bound( const price& p )const
+{
+   const order_book& book = get_book( p.base.asset_id, p.quote.asset_id );
+   return const_iterator( &book, book.lower_bound( price_sort_key( p ) ) );
+}
+
+limit_order_book_index::const_iterator limit_order_book_index::upper_bound( const price& p )const
+{
+   const order_book& book = get_book( p.base.asset_id, p.quote.asset_id );
+   return const_iterator( &book, book.upper_bound( price_sort_key( p ) ) );
+}
+
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::limit_order_object,
                     (graphene::db::object),
                     (expiration)(seller)(for_sale)(sell_price)(deferred_fee)(deferred_paid_fee)
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/median_feed_tracker.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+   /// Source of tracker stamps, 0 is never handed out
+   std::atomic<uint64_t> next_stamp{ 1 };
+
+   /// Prices with an amount that is not positive are not ordered consistently by operator<
+   bool is_regular( const price& p )
+   {
+      return p.base.amount > 0 && p.quote.amount > 0;
+   }
+
+   /// Erases one value which is identical to @p value, not just equivalent
+   void erase_price( boost::container::flat_multiset< price >& values, const price& value )
+   {
+      auto range = values.equal_range( value );
+      auto itr = std::find_if( range.first, range.second, [&value]( const price& p ) {
+         return p.base == value.base && p.quote == value.quote;
+      });
+      FC_ASSERT( itr != range.second, "Untracked price ${p}", ("p",value) );
+      values.erase( itr );
+   }
+
+   void erase_ratio( boost::container::flat_multiset< uint16_t >& values, uint16_t value )
+   {
+      auto itr = values.find( value );
+      FC_ASSERT( itr != values.end(), "Untracked ratio ${r}", ("r",value) );
+      values.erase( itr );
+   }
+
+   bool is_same_feed( const price_feed& a, const price_feed& b )
+   {
+      return a.settlement_price.base == b.settlement_price.base
+            && a.settlement_price.quote == b.settlement_price.quote
+            && a.maintenance_collateral_ratio == b.maintenance_collateral_ratio
+            && a.maximum_short_squeeze_ratio == b.maximum_short_squeeze_ratio
+            && a.core_exchange_rate.base == b.core_exchange_rate.base
+            && a.core_exchange_rate.quote == b.core_exchange_rate.quote;
+   }
+
+   /// @return false if the values equivalent to @p median are not all identical
+   bool is_unique_median( const boost::container::flat_multiset< price >& values, const price& median )
+   {
+      auto range = values.equal_range( median );
+      return std::all_of( range.first, range.second, [&median]( const price& p ) {
+         return p.base == median.base && p.quote == median.quote;
+      });
+   }
+
+}
+
+bool median_feed_tracker::is_alive( time_point_sec published )const
+{
+   // same condition as the one used to select the feeds in asset_bitasset_data_object::update_median_feeds()
+   return published != time_point_sec() && ( _now - published ).to_seconds() < _lifetime;
+}
+
+bool median_feed_tracker::matches( const feed_map& feeds )const
+{
+   // both maps are ordered by publisher
+   auto live_itr = _live.begin();
+   for( const auto& f : feeds )
+   {
+      if( !is_alive( f.second.first ) )
+         continue;
+      if( live_itr == _live.end() || live_itr->first != f.first || live_itr->second.first != f.second.first
+            || !is_same_feed( live_itr->second.second, f.second.second ) )
+         return false;
+      ++live_itr;
+   }
+   return live_itr == _live.end();
+}
+
+void median_feed_tracker::rebuild( const feed_map& feeds, time_point_sec now, uint32_t lifetime )
+{
+   _live.clear();
+   _by_time.clear();
+   _settlement_prices.clear();
+   _maintenance_collateral_ratios.clear();
+   _maximum_short_squeeze_ratios.clear();
+   _core_exchange_rates.clear();
+   _irregular_feeds = 0;
+   _median_current = false;
+
+   _now = now;
+   _lifetime = lifetime;
+   for( const auto& f : feeds )
+   {
+      if( is_alive( f.second.first ) )
+         insert( f.first, f.second );
+   }
+   _valid = true;
+}
+
+void median_feed_tracker::set_feed( account_id_type publisher, const published_feed& feed )
+{
+   if( !_valid )
+      return;
+   auto itr = _live.find( publisher );
+   const bool alive = is_alive( feed.first );
+   if( itr != _live.end() && alive && is_same_feed( itr->second.second, feed.second ) )
+   {
+      // the values are unchanged, only the publication time is
+      _by_time.erase( std::make_pair( itr->second.first, publisher ) );
+      _by_time.insert( std::make_pair( feed.first, publisher ) );
+      itr->second.first = feed.first;
+      return;
+   }
+   if( itr != _live.end() )
+      erase( itr );
+   if( alive )
+      insert( publisher, feed );
+}
+
+void median_feed_tracker::expire( time_point_sec now )
+{
+   _now = now;
+   // feeds published earlier expire earlier
+   while( !_by_time.empty() && !is_alive( _by_time.begin()->first ) )
+      erase( _live.find( _by_time.begin()->second ) );
+}
+
+void median_feed_tracker::insert( account_id_type publisher, const published_feed& feed )
+{
+   _median_current = false;
+   _live[publisher] = feed;
+   _by_time.insert( std::make_pair( feed.first, publisher ) );
+   const price_feed& f = feed.second;
+   _maintenance_collateral_ratios.insert( f.maintenance_collateral_ratio );
+   _maximum_short_squeeze_ratios.insert( f.maximum_short_squeeze_ratio );
+   if( is_regular( f.settlement_price ) && is_regular( f.core_exchange_rate ) )
+   {
+      _settlement_prices.insert( f.settlement_price );
+      _core_exchange_rates.insert( f.core_exchange_rate );
+   }
+   else
+      ++_irregular_feeds;
+}
+
+void median_feed_tracker::erase( feed_map::iterator itr )
+{
+   _median_current = false;
+   const price_feed& f = itr->second.second;
+   _by_time.erase( std::make_pair( itr->second.first, itr->first ) );
+   erase_ratio( _maintenance_collateral_ratios, f.maintenance_collateral_ratio );
+   erase_ratio( _maximum_short_squeeze_ratios, f.maximum_short_squeeze_ratio );
+   if( is_regular( f.settlement_price ) && is_regular( f.core_exchange_rate ) )
+   {
+      erase_price( _settlement_prices, f.settlement_price );
+      erase_price( _core_exchange_rates, f.core_exchange_rate );
+   }
+   else
+      --_irregular_feeds;
+   _live.erase( itr );
+}
+
+uint64_t median_feed_tracker::restamp()
+{
+   _stamp = next_stamp++;
+   return _stamp;
+}
+
+bool median_feed_tracker::get_median( price_feed& result )const
+{
+   if( _live.empty() || _irregular_feeds > 0 )
+      return false;
+
+   const size_t median_pos = _live.size() / 2;
+   const price& settlement_price = *( _settlement_prices.begin() + median_pos );
+   const price& core_exchange_rate = *( _core_exchange_rates.begin() + median_pos );
+   if( !is_unique_median( _settlement_prices, settlement_price )
+         || !is_unique_median( _core_exchange_rates, core_exchange_rate ) )
+      return false;
+
+   result.settlement_price = settlement_price;
+   result.maintenance_collateral_ratio = *( _maintenance_collateral_ratios.begin() + median_pos );
+   result.maximum_short_squeeze_ratio = *( _maximum_short_squeeze_ratios.begin() + median_pos );
+   result.core_exchange_rate = core_exchange_rate;
+   return true;
+}
+
+} } // graphene::chain
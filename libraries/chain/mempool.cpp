@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/mempool.hpp>
+
+#include <fc/uint128.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace graphene { namespace chain {
+
+uint64_t mempool::fee_per_kb( share_type core_fee, uint64_t size )
+{
+   if( core_fee <= 0 || size == 0 )
+      return 0;
+   fc::uint128_t rate = fc::uint128_t( uint64_t(core_fee.value) ) * 1024 / size;
+   if( rate > std::numeric_limits<uint64_t>::max() )
+      return std::numeric_limits<uint64_t>::max();
+   return static_cast<uint64_t>( rate );
+}
+
+void mempool::set_limits( uint64_t max_bytes, uint32_t max_per_account )
+{
+   _max_bytes = max_bytes;
+   _max_per_account = max_per_account;
+}
+
+std::vector<uint64_t> mempool::check_admission( account_id_type payer, uint64_t size, uint64_t fee_per_kb )
+{
+   if( _max_per_account > 0 && _entries.get<by_payer>().count( payer ) >= _max_per_account )
+   {
+      ++_stats.rejected;
+      FC_THROW( "Account ${a} has too many pending transactions, the limit is ${n}",
+                ("a",payer)("n",_max_per_account) );
+   }
+
+   std::vector<uint64_t> result;
+   if( _max_bytes == 0 || _bytes + size <= _max_bytes )
+      return result;
+
+   // room has to be made by evicting transactions that pay less, some more is freed for the next transactions
+   const uint64_t needed = _bytes + size - _max_bytes;
+   const uint64_t wanted = needed + _max_bytes / eviction_batch_divisor;
+   uint64_t freed = 0;
+   const auto& by_rate = _entries.get<by_fee_rate>();
+   for( auto itr = by_rate.rbegin(); itr != by_rate.rend() && itr->fee_per_kb < fee_per_kb && freed < wanted; ++itr )
+   {
+      freed += itr->size;
+      result.push_back( itr->seq );
+   }
+   if( freed < needed || size > _max_bytes )
+   {
+      ++_stats.rejected;
+      FC_THROW( "Pending transactions are full, a transaction has to pay more than ${f} per kilobyte",
+                ("f", by_rate.empty() ? 0 : by_rate.rbegin()->fee_per_kb) );
+   }
+   std::sort( result.begin(), result.end() );
+   return result;
+}
+
+void mempool::insert( const processed_transaction& trx, account_id_type payer, uint64_t size, uint64_t fee_per_kb )
+{
+   entry e;
+   e.trx = trx;
+   e.id = trx.id();
+   e.seq = _next_seq++;
+   e.size = size;
+   e.fee_per_kb = fee_per_kb;
+   e.payer = payer;
+   e.expiration = trx.expiration;
+   _entries.insert( std::move( e ) );
+   _bytes += size;
+   ++_stats.accepted;
+}
+
+size_t mempool::evict( const std::vector<uint64_t>& seqs )
+{
+   size_t evicted = 0;
+   for( const uint64_t seq : seqs )
+   {
+      auto itr = _entries.find( seq );
+      if( itr == _entries.end() )
+         continue;
+      erase( itr );
+      ++evicted;
+   }
+   _stats.evicted += evicted;
+   return evicted;
+}
+
+bool mempool::remove( const transaction_id_type& id )
+{
+   const auto& by_id = _entries.get<by_trx_id>();
+   auto itr = by_id.find( id );
+   if( itr == by_id.end() )
+      return false;
+   erase( _entries.project<by_arrival>( itr ) );
+   return true;
+}
+
+size_t mempool::remove_expired( time_point_sec now )
+{
+   const auto& by_exp = _entries.get<by_expiration>();
+   size_t count = 0;
+   while( !by_exp.empty() && by_exp.begin()->expiration < now )
+   {
+      erase( _entries.project<by_arrival>( by_exp.begin() ) );
+      ++count;
+   }
+   _stats.expired += count;
+   return count;
+}
+
+std::vector<const processed_transaction*> mempool::select( uint64_t max_size )const
+{
+   std::vector<const processed_transaction*> result;
+   result.reserve( _entries.size() );
+   if( _bytes <= max_size )
+   {
+      for( const entry& e : _entries.get<by_arrival>() )
+         result.push_back( &e.trx );
+      return result;
+   }
+
+   std::vector<const entry*> selected;
+   uint64_t total = 0;
+   for( const entry& e : _entries.get<by_fee_rate>() )
+   {
+      if( total + e.size > max_size )
+         continue;
+      total += e.size;
+      selected.push_back( &e );
+   }
+   std::sort( selected.begin(), selected.end(), []( const entry* a, const entry* b ) { return a->seq < b->seq; } );
+   for( const entry* e : selected )
+      result.push_back( &e->trx );
+   return result;
+}
+
+std::vector<processed_transaction> mempool::release()
+{
+   std::vector<processed_transaction> result;
+   result.reserve( _entries.size() );
+   for( const entry& e : _entries.get<by_arrival>() )
+      result.push_back( std::move( const_cast<entry&>( e ).trx ) );
+   clear();
+   return result;
+}
+
+void mempool::clear()
+{
+   _entries.clear();
+   _bytes = 0;
+}
+
+bool mempool::contains( const transaction_id_type& id )const
+{
+   return _entries.get<by_trx_id>().count( id ) > 0;
+}
+
+const processed_transaction* mempool::find( const transaction_id_type& id )const
+{
+   const auto& by_id = _entries.get<by_trx_id>();
+   auto itr = by_id.find( id );
+   return itr != by_id.end() ? &itr->trx : nullptr;
+}
+
+mempool_stats mempool::get_stats()const
+{
+   mempool_stats result = _stats;
+   result.transactions = _entries.size();
+   result.bytes = _bytes;
+   result.max_bytes = _max_bytes;
+   result.max_per_account = _max_per_account;
+   const auto& by_rate = _entries.get<by_fee_rate>();
+   if( !by_rate.empty() )
+   {
+      result.max_fee_per_kb = by_rate.begin()->fee_per_kb;
+      result.min_fee_per_kb = by_rate.rbegin()->fee_per_kb;
+   }
+   return result;
+}
+
+void mempool::erase( entry_index::iterator itr )
+{
+   _bytes -= itr->size;
+   _entries.erase( itr );
+}
+
+} } // graphene::chain
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/price_sort_key.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+   /// Number of significant bits of @p v
+   uint32_t bit_length( uint64_t v )
+   {
+      uint32_t result = 0;
+      for( uint32_t step = 32; step > 0; step >>= 1 )
+      {
+         if( v >> step )
+         {
+            v >>= step;
+            result += step;
+         }
+      }
+      return result + uint32_t( v );
+   }
+
+   constexpr uint32_t mantissa_bits = 57;
+}
+
+price_sort_key::price_sort_key( const price& p )
+: base_asset( p.base.asset_id ), quote_asset( p.quote.asset_id ),
+  base_amount( p.base.amount.value ), quote_amount( p.quote.amount.value )
+{
+   if( base_amount <= 0 || quote_amount <= 0 )
+      return;
+
+   // base_amount / quote_amount in fixed point with 64 fractional bits, at least 2 and below 2^127
+   const fc::uint128_t fixed = ( fc::uint128_t( base_amount ) << 64 ) / fc::uint128_t( quote_amount );
+   const uint64_t high = static_cast<uint64_t>( fixed >> 64 );
+   const uint64_t low  = static_cast<uint64_t>( fixed & fc::uint128_t( ~uint64_t(0) ) );
+   const uint32_t length = high != 0 ? 64 + bit_length( high ) : bit_length( low );
+   // the length takes the 7 upper bits, the leading bits of the ratio the others
+   const uint64_t mantissa = length > mantissa_bits ? static_cast<uint64_t>( fixed >> ( length - mantissa_bits ) )
+                                                    : low;
+   ratio = ( uint64_t( length ) << mantissa_bits ) | mantissa;
+}
+
+} } // graphene::chain
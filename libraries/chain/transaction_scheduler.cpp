@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/transaction_scheduler.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+struct authority_change_visitor
+{
+   typedef bool result_type;
+
+   bool operator()( const account_update_operation& op )const
+   {
+      return op.owner.valid() || op.active.valid();
+   }
+   // may execute a proposed account update
+   bool operator()( const proposal_update_operation& )const { return true; }
+
+   template<typename Op>
+   bool operator()( const Op& )const { return false; }
+};
+
+} // anonymous namespace
+
+bool changes_authorities( const transaction& trx )
+{
+   const authority_change_visitor visitor;
+   for( const auto& op : trx.operations )
+   {
+      if( op.visit( visitor ) )
+         return true;
+   }
+   return false;
+}
+
+} } // graphene::chain
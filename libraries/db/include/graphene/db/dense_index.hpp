@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/generic_index.hpp>
+
+#include <boost/iterator/indirect_iterator.hpp>
+#include <boost/mpl/size.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace graphene { namespace db {
+
+   /// Views type of a dense_index that is only accessed by ID
+   struct no_dense_views {};
+
+   namespace detail {
+
+      /**
+       *  Presents an index of a multi_index_container of object pointers like an index of objects, so that code
+       *  written against a generic_index keeps working.
+       */
+      template<typename Index>
+      class dense_view
+      {
+            using object_type = const typename std::remove_pointer< typename Index::value_type >::type;
+
+         public:
+            using iterator               = boost::indirect_iterator< typename Index::const_iterator, object_type >;
+            using const_iterator         = iterator;
+            using reverse_iterator       = boost::indirect_iterator< typename Index::const_reverse_iterator,
+                                                                     object_type >;
+            using const_reverse_iterator = reverse_iterator;
+            using size_type              = typename Index::size_type;
+
+            explicit dense_view( const Index& index ) : _index( index ) {}
+
+            iterator         begin()const  { return iterator( _index.begin() ); }
+            iterator         end()const    { return iterator( _index.end() ); }
+            reverse_iterator rbegin()const { return reverse_iterator( _index.rbegin() ); }
+            reverse_iterator rend()const   { return reverse_iterator( _index.rend() ); }
+            size_type        size()const   { return _index.size(); }
+            bool             empty()const  { return _index.empty(); }
+
+            template<typename Key>
+            iterator  find( const Key& key )const        { return iterator( _index.find( key ) ); }
+            template<typename Key>
+            iterator  lower_bound( const Key& key )const { return iterator( _index.lower_bound( key ) ); }
+            template<typename Key>
+            iterator  upper_bound( const Key& key )const { return iterator( _index.upper_bound( key ) ); }
+            template<typename Key>
+            size_type count( const Key& key )const       { return _index.count( key ); }
+            template<typename Key>
+            std::pair<iterator,iterator> equal_range( const Key& key )const
+            {
+               auto range = _index.equal_range( key );
+               return std::make_pair( iterator( range.first ), iterator( range.second ) );
+            }
+
+         private:
+            const Index& _index;
+      };
+
+      template<typename Views, typename Sequence>
+      struct dense_view_tuple;
+
+      template<typename Views, size_t... N>
+      struct dense_view_tuple< Views, std::index_sequence<N...> >
+      {
+         using type = std::tuple< dense_view< typename boost::multi_index::nth_index<Views,N>::type >... >;
+
+         static type make( const Views& views )
+         {
+            return type( dense_view< typename boost::multi_index::nth_index<Views,N>::type >(
+                                views.template get<N>() )... );
+         }
+      };
+
+      /// Ordered views of the objects of a dense_index, kept as a multi_index_container of object pointers
+      template<typename Object, typename Views>
+      class dense_view_set
+      {
+         static constexpr size_t view_count = boost::mpl::size< typename Views::index_type_list >::value;
+         using view_tuple = dense_view_tuple< Views, std::make_index_sequence<view_count> >;
+
+         public:
+            using handle = typename Views::iterator;
+
+            dense_view_set() : _adaptors( view_tuple::make( _views ) ) {}
+
+            /// @return the position of @p obj in the views, or nothing if a uniqueness constraint was violated
+            std::pair<handle,bool> insert( Object* obj ) { return _views.insert( obj ); }
+            void                   erase( handle h )           { _views.erase( h ); }
+            void                   clear()                     { _views.clear(); }
+
+            /// Calls @p m and re-sorts the object, if this returns false the object was dropped from the views
+            template<typename Modifier>
+            bool modify( handle h, Modifier&& m ) { return _views.modify( h, [&m]( Object*& ){ m(); } ); }
+
+            template<typename Tag>
+            const auto& get()const
+            {
+               return std::get< dense_view< typename boost::multi_index::index<Views,Tag>::type > >( _adaptors );
+            }
+
+         private:
+            Views                       _views;
+            typename view_tuple::type   _adaptors;
+      };
+
+      template<typename Object>
+      class dense_view_set< Object, no_dense_views >
+      {
+         public:
+            struct handle {};
+
+            std::pair<handle,bool> insert( Object* ) { return std::make_pair( handle(), true ); }
+            void                   erase( handle ) {}
+            void                   clear() {}
+
+            template<typename Modifier>
+            bool modify( handle, Modifier&& m ) { m(); return true; }
+      };
+
+   } // namespace detail
+
+   /**
+    *  @class dense_index
+    *  @brief An index that stores objects by value in ID order
+    *
+    *  Objects live in fixed size chunks of 2^ChunkBits slots, so a lookup by ID is an array access and object
+    *  addresses are stable. Secondary orders are provided by @p Views, a multi_index_container of non-const
+    *  object pointers (as required by the key extractors of Boost.MultiIndex), whose indices are presented through
+    *  indices().get<Tag>() like those of a generic_index. indices() itself, and indices().get<by_id>(), iterate
+    *  the objects in ID order and support find() and lower_bound() by ID.
+    *
+    *  This index is meant for object types that are rarely removed, because removed objects leave holes.
+    */
+   template<typename ObjectType, typename Views = no_dense_views, uint8_t ChunkBits = 10>
+   class dense_index : public index
+   {
+      static_assert( ChunkBits > 0 && ChunkBits < 32, "Unreasonable chunk size" );
+      static constexpr uint64_t chunk_size = 1ULL << ChunkBits;
+      static constexpr uint64_t chunk_mask = chunk_size - 1;
+
+      using view_set = detail::dense_view_set< ObjectType, Views >;
+
+      struct slot
+      {
+         typename std::aligned_storage< sizeof(ObjectType), alignof(ObjectType) >::type storage;
+         typename view_set::handle                                                      handle;
+         bool                                                                           used = false;
+
+         ObjectType&       get()       { return *reinterpret_cast<ObjectType*>( &storage ); }
+         const ObjectType& get()const  { return *reinterpret_cast<const ObjectType*>( &storage ); }
+      };
+
+      public:
+         using object_type = ObjectType;
+
+         dense_index() = default;
+         dense_index( const dense_index& ) = delete;
+         dense_index& operator=( const dense_index& ) = delete;
+
+         ~dense_index()
+         {
+            _views.clear();
+            for( uint64_t instance = 0; instance < _end; ++instance )
+            {
+               slot& s = get_slot( instance );
+               if( s.used )
+                  s.get().~ObjectType();
+            }
+         }
+
+         const object& insert( object&& obj )override
+         {
+            assert( nullptr != dynamic_cast<ObjectType*>(&obj) );
+            const uint64_t instance = obj.id.instance();
+            reserve( instance );
+            slot& s = get_slot( instance );
+            FC_ASSERT( !s.used, "Could not insert object, most likely a uniqueness constraint was violated" );
+            new( &s.storage ) ObjectType( std::move( static_cast<ObjectType&>(obj) ) );
+            auto inserted = _views.insert( &s.get() );
+            if( !inserted.second )
+            {
+               s.get().~ObjectType();
+               FC_THROW_EXCEPTION( fc::assert_exception,
+                                   "Could not insert object, most likely a uniqueness constraint was violated" );
+            }
+            s.handle = inserted.first;
+            s.used = true;
+            ++_size;
+            _end = std::max( _end, instance + 1 );
+            return s.get();
+         }
+
+         const object&  create( const std::function<void(object&)>& constructor )override
+         {
+            ObjectType item;
+            item.id = get_next_id();
+            constructor( item );
+            const object& result = insert( std::move(item) );
+            use_next_id();
+            return result;
+         }
+
+         void modify( const object& obj, const std::function<void(object&)>& m )override
+         {
+            assert( nullptr != dynamic_cast<const ObjectType*>(&obj) );
+            const uint64_t instance = obj.id.instance();
+            FC_ASSERT( instance < _end && get_slot( instance ).used && &get_slot( instance ).get() == &obj,
+                       "Modifying an object that is not in the index" );
+            slot& s = get_slot( instance );
+            std::exception_ptr exc;
+            bool ok = _views.modify( s.handle, [&m, &exc, &s]() {
+               try {
+                  m( s.get() );
+               } catch (fc::exception& e) {
+                  exc = std::current_exception();
+                  elog("Exception while modifying object: ${e} -- object may be corrupted", ("e", e));
+               } catch (...) {
+                  exc = std::current_exception();
+                  elog("Unknown exception while modifying object");
+               }
+            } );
+            if( !ok )
+            {
+               // the views dropped the object like a generic_index would, keep the storage consistent with them
+               s.get().~ObjectType();
+               s.used = false;
+               --_size;
+            }
+            if (exc)
+                std::rethrow_exception(exc);
+            FC_ASSERT(ok, "Could not modify object, most likely an index constraint was violated");
+         }
+
+         void remove( const object& obj )override
+         {
+            const uint64_t instance = obj.id.instance();
+            assert( instance < _end && get_slot( instance ).used );
+            slot& s = get_slot( instance );
+            _views.erase( s.handle );
+            s.get().~ObjectType();
+            s.used = false;
+            --_size;
+         }
+
+         const object* find( object_id_type id )const override
+         {
+            const uint64_t instance = id.instance();
+            if( instance >= _end ) return nullptr;
+            const slot& s = get_slot( instance );
+            return s.used ? &s.get() : nullptr;
+         }
+
+         void inspect_all_objects(std::function<void (const object&)> inspector)const override
+         {
+            try {
+               for( const auto& obj : *this )
+                  inspector(obj);
+            } FC_CAPTURE_AND_RETHROW()
+         }
+
+         class const_iterator
+         {
+            public:
+               using iterator_category = std::bidirectional_iterator_tag;
+               using value_type        = ObjectType;
+               using difference_type   = std::ptrdiff_t;
+               using pointer           = const ObjectType*;
+               using reference         = const ObjectType&;
+
+               const_iterator( const dense_index& index, uint64_t instance ) : _index( &index ), _instance( instance ) {}
+
+               friend bool operator==( const const_iterator& a, const const_iterator& b )
+               { return a._instance == b._instance; }
+               friend bool operator!=( const const_iterator& a, const const_iterator& b )
+               { return a._instance != b._instance; }
+
+               reference operator*()const  { return _index->get_slot( _instance ).get(); }
+               pointer   operator->()const { return &_index->get_slot( _instance ).get(); }
+
+               const_iterator& operator++()
+               {
+                  do ++_instance; while( _instance < _index->_end && !_index->get_slot( _instance ).used );
+                  return *this;
+               }
+               const_iterator& operator--()
+               {
+                  do --_instance; while( _instance > 0 && !_index->get_slot( _instance ).used );
+                  return *this;
+               }
+               const_iterator operator++(int) { const_iterator result( *this ); ++(*this); return result; }
+               const_iterator operator--(int) { const_iterator result( *this ); --(*this); return result; }
+
+            private:
+               const dense_index* _index;
+               uint64_t           _instance;
+         };
+         using iterator = const_iterator;
+         using reverse_iterator = std::reverse_iterator<const_iterator>;
+         using const_reverse_iterator = reverse_iterator;
+
+         const_iterator   begin()const  { return const_iterator( *this, first_used( 0 ) ); }
+         const_iterator   end()const    { return const_iterator( *this, _end ); }
+         reverse_iterator rbegin()const { return reverse_iterator( end() ); }
+         reverse_iterator rend()const   { return reverse_iterator( begin() ); }
+         size_t           size()const   { return _size; }
+         bool             empty()const  { return _size == 0; }
+
+         /**
+          *  The objects in ID order, with the lookups of the by_id index of a generic_index. index::find() can not
+          *  be overloaded to return an iterator, so these live in a separate view.
+          */
+         class id_view
+         {
+            public:
+               using iterator               = typename dense_index::const_iterator;
+               using const_iterator         = iterator;
+               using reverse_iterator       = typename dense_index::reverse_iterator;
+               using const_reverse_iterator = reverse_iterator;
+               using size_type              = size_t;
+
+               explicit id_view( const dense_index& index ) : _index( index ) {}
+
+               iterator         begin()const  { return _index.begin(); }
+               iterator         end()const    { return _index.end(); }
+               reverse_iterator rbegin()const { return _index.rbegin(); }
+               reverse_iterator rend()const   { return _index.rend(); }
+               size_type        size()const   { return _index.size(); }
+               bool             empty()const  { return _index.empty(); }
+
+               iterator find( object_id_type id )const
+               {
+                  return _index.find( id ) != nullptr ? iterator( _index, id.instance() ) : end();
+               }
+               iterator lower_bound( object_id_type id )const
+               {
+                  return iterator( _index, _index.first_used( id.instance() ) );
+               }
+               iterator upper_bound( object_id_type id )const
+               {
+                  return id.instance() >= _index._end ? end()
+                                                      : iterator( _index, _index.first_used( id.instance() + 1 ) );
+               }
+               size_type count( object_id_type id )const { return _index.find( id ) != nullptr ? 1 : 0; }
+               std::pair<iterator,iterator> equal_range( object_id_type id )const
+               {
+                  return std::make_pair( lower_bound( id ), upper_bound( id ) );
+               }
+
+               template<typename Tag>
+               const auto& get()const { return _index.template get<Tag>(); }
+
+            private:
+               const dense_index& _index;
+         };
+
+         /// For compatibility with generic_index, indices() and indices().get<by_id>() are the view in ID order
+         const id_view& indices()const { return _id_view; }
+
+         template<typename Tag, typename std::enable_if< std::is_same<Tag,by_id>::value, int >::type = 0>
+         const id_view& get()const { return _id_view; }
+
+         template<typename Tag, typename std::enable_if< !std::is_same<Tag,by_id>::value, int >::type = 0>
+         const auto& get()const
+         {
+            return _views.template get<Tag>();
+         }
+
+      private:
+         /// @return the lowest used instance from @p instance on, or _end
+         uint64_t first_used( uint64_t instance )const
+         {
+            while( instance < _end && !get_slot( instance ).used )
+               ++instance;
+            return std::min( instance, _end );
+         }
+
+         slot&       get_slot( uint64_t instance )       { return _chunks[instance >> ChunkBits][instance & chunk_mask]; }
+         const slot& get_slot( uint64_t instance )const  { return _chunks[instance >> ChunkBits][instance & chunk_mask]; }
+
+         /// Makes sure the chunk holding @p instance exists
+         void reserve( uint64_t instance )
+         {
+            while( _chunks.size() <= ( instance >> ChunkBits ) )
+               _chunks.emplace_back( new slot[chunk_size] );
+         }
+
+         std::vector< std::unique_ptr<slot[]> > _chunks;
+         view_set                               _views;
+         id_view                                _id_view{ *this };
+         uint64_t                               _end = 0;  ///< one past the highest instance ever stored
+         size_t                                 _size = 0;
+   };
+
+} } // graphene::db
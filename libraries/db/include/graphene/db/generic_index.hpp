@@ -49,6 +49,7 @@ namespace graphene { namespace db {
          const object& insert( object&& obj )override
          {
             assert( nullptr != dynamic_cast<ObjectType*>(&obj) );
+            update_sort_keys( static_cast<ObjectType&>(obj), 0 );
             auto insert_result = _indices.insert( std::move( static_cast<ObjectType&>(obj) ) );
             FC_ASSERT( insert_result.second,
                        "Could not insert object, most likely a uniqueness constraint was violated" );
@@ -60,6 +61,7 @@ namespace graphene { namespace db {
             ObjectType item;
             item.id = get_next_id();
             constructor( item );
+            update_sort_keys( item, 0 );
             auto insert_result = _indices.insert( std::move(item) );
             FC_ASSERT( insert_result.second,
                        "Could not create object! Most likely a uniqueness constraint is violated.");
@@ -83,6 +85,7 @@ namespace graphene { namespace db {
                                              exc = std::current_exception();
                                              elog("Unknown exception while modifying object");
                                           }
+                                          update_sort_keys( o, 0 );
                                        }
                       );
             if (exc)
@@ -115,6 +118,12 @@ namespace graphene { namespace db {
          const index_type& indices()const { return _indices; }
 
       private:
+         /// Refreshes the sort keys that objects with an update_sort_keys() method derive from their other fields
+         template<typename T>
+         static auto update_sort_keys( T& o, int ) -> decltype( o.update_sort_keys() ) { o.update_sort_keys(); }
+         template<typename T>
+         static void update_sort_keys( T&, long ) {}
+
          index_type  _indices;
    };
 
@@ -29,7 +29,11 @@
 #include <fc/io/json.hpp>
 #include <fc/crypto/sha256.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <stack>
 
 namespace graphene { namespace db {
@@ -80,6 +84,8 @@ namespace graphene { namespace db {
          virtual void           set_next_id( object_id_type id ) = 0;
 
          virtual const object&  load( const std::vector<char>& data ) = 0;
+         /** Unpacks an object of the type stored in this index, without inserting it */
+         virtual std::unique_ptr<object> unpack_object( const char* data, size_t size )const = 0;
          /**
           *  Polymorphically insert by moving an object into the index.
           *  this should throw if the object is already in the database.
@@ -96,7 +102,20 @@ namespace graphene { namespace db {
           *  Opens the index loading objects from a file
           */
          virtual void open( const fc::path& db ) = 0;
+         /**
+          *  Splits open() into steps, so that the objects of one index can be decoded concurrently.
+          *  @return independent jobs that decode consecutive parts of the file, the objects decoded by each of
+          *          them are inserted by insert_decoded() once it has completed
+          */
+         virtual std::vector< std::function<void()> > prepare_open( const fc::path& db ) = 0;
+         /** Inserts and releases the objects decoded by the job at position @p job of the ones returned from
+          *  prepare_open(), jobs are inserted in order */
+         virtual void insert_decoded( size_t job ) = 0;
+         /** Completes opening, after the objects of all jobs have been inserted */
+         virtual void finish_open() = 0;
          virtual void save( const fc::path& db ) = 0;
+         /** @return false if the index is unchanged since it was last opened from or saved to disk */
+         virtual bool is_dirty()const = 0;
 
 
 
@@ -146,6 +165,35 @@ namespace graphene { namespace db {
          virtual void object_modified( const object& after  ){};
    };
 
+   namespace detail {
+      /**
+       *  Index files end with a table of the file positions of all records, followed by this trailer. Files
+       *  without it are read sequentially.
+       */
+      struct index_file_trailer
+      {
+         static constexpr uint64_t magic_value = 0x3154534f58444947ULL; // "GIDXOST1"
+
+         uint64_t offset_table_pos = 0;
+         uint64_t magic = 0;
+
+         /** Reads the trailer of a file of @p size bytes whose records start at @p records_begin */
+         bool read( const char* data, size_t size, size_t records_begin )
+         {
+            if( size < records_begin + sizeof(*this) )
+               return false;
+            std::memcpy( (char*)this, data + size - sizeof(*this), sizeof(*this) );
+            if( magic != magic_value || offset_table_pos < records_begin
+                  || offset_table_pos > size - sizeof(*this) )
+               return false;
+            return ( size - sizeof(*this) - offset_table_pos ) % sizeof(uint64_t) == 0;
+         }
+      };
+
+      /// Number of records decoded by one job when opening an index
+      constexpr size_t records_per_open_job = 50000;
+   }
+
    /**
     *   Defines the common implementation
     */
@@ -328,8 +376,8 @@ namespace graphene { namespace db {
          { return object_type::type_id; }
 
          object_id_type get_next_id()const override              { return _next_id;    }
-         void           use_next_id()override                    { ++_next_id.number;  }
-         void           set_next_id( object_id_type id )override { _next_id = id;      }
+         void           use_next_id()override                    { ++_next_id.number; _dirty = true; }
+         void           set_next_id( object_id_type id )override { _next_id = id; _dirty = true; }
 
          /** @return the object with id or nullptr if not found */
          const object*  find( object_id_type id )const override
@@ -347,24 +395,98 @@ namespace graphene { namespace db {
 
          void open( const fc::path& db )override
          {
-            if( !fc::exists( db ) ) return;
-            fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
-            fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+            const auto jobs = prepare_open( db );
+            for( size_t job = 0; job < jobs.size(); ++job )
+            {
+               jobs[job]();
+               insert_decoded( job );
+            }
+            finish_open();
+         }
+
+         std::vector< std::function<void()> > prepare_open( const fc::path& db )override
+         {
+            _open_state.reset();
+            std::vector< std::function<void()> > jobs;
+            if( !fc::exists( db ) ) return jobs;
+            auto state = std::make_shared<open_state>( db );
+            fc::datastream<const char*> ds( state->data(), state->size() );
             fc::sha256 open_ver;
 
             fc::raw::unpack(ds, _next_id);
             fc::raw::unpack(ds, open_ver);
             FC_ASSERT( open_ver == get_object_version(),
                        "Incompatible Version, the serialization of objects in this index has changed" );
-            std::vector<char> tmp;
-            while( ds.remaining() > 0 )
+            const size_t records_begin = ds.pos() - state->data();
+
+            detail::index_file_trailer trailer;
+            if( !trailer.read( state->data(), state->size(), records_begin ) )
+            {
+               // written before record offsets were saved, decode sequentially
+               state->chunks.resize( 1 );
+               jobs.emplace_back( [state,records_begin] () {
+                  fc::datastream<const char*> records( state->data() + records_begin,
+                                                       state->size() - records_begin );
+                  while( records.remaining() > 0 )
+                     decode_record( records, state->chunks[0] );
+               } );
+               _open_state = state;
+               return jobs;
+            }
+
+            const size_t table_pos = trailer.offset_table_pos;
+            const size_t record_count = ( state->size() - sizeof(trailer) - table_pos ) / sizeof(uint64_t);
+            const size_t job_count = ( record_count + detail::records_per_open_job - 1 ) / detail::records_per_open_job;
+            state->chunks.resize( job_count );
+            for( size_t job = 0; job < job_count; ++job )
+            {
+               const size_t first = job * detail::records_per_open_job;
+               const size_t last = std::min( first + detail::records_per_open_job, record_count );
+               jobs.emplace_back( [state,table_pos,record_count,first,last,job] () {
+                  auto record_pos = [&state,table_pos,record_count] ( size_t record ) {
+                     if( record == record_count )
+                        return uint64_t( table_pos );
+                     uint64_t pos;
+                     std::memcpy( (char*)&pos, state->data() + table_pos + record * sizeof(pos), sizeof(pos) );
+                     return pos;
+                  };
+                  std::vector<object_type>& objects = state->chunks[job];
+                  objects.reserve( last - first );
+                  uint64_t begin = record_pos( first );
+                  for( size_t record = first; record < last; ++record )
+                  {
+                     const uint64_t end = record_pos( record + 1 );
+                     FC_ASSERT( begin < end && end <= table_pos, "Corrupted record offset table" );
+                     fc::datastream<const char*> ds( state->data() + begin, end - begin );
+                     decode_record( ds, objects );
+                     begin = end;
+                  }
+               } );
+            }
+            _open_state = state;
+            return jobs;
+         }
+
+         void insert_decoded( size_t job )override
+         {
+            FC_ASSERT( _open_state && job < _open_state->chunks.size(), "No decoded objects of job ${j}", ("j",job) );
+            std::vector<object_type> objects = std::move( _open_state->chunks[job] );
+            for( auto& obj : objects )
             {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
+               const auto& result = DerivedIndex::insert( std::move( obj ) );
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
             }
          }
 
+         void finish_open()override
+         {
+            if( !_open_state )
+               return;
+            _open_state.reset();
+            _dirty = false;
+         }
+
          void save( const fc::path& db ) override
          {
             std::ofstream out( db.generic_string(),
@@ -373,15 +495,38 @@ namespace graphene { namespace db {
             auto ver  = get_object_version();
             fc::raw::pack( out, _next_id );
             fc::raw::pack( out, ver );
-            this->inspect_all_objects( [&out]( const object& o ) {
+            uint64_t pos = fc::raw::pack_size( _next_id ) + fc::raw::pack_size( ver );
+            std::vector<uint64_t> offsets;
+            this->inspect_all_objects( [&out,&pos,&offsets]( const object& o ) {
                 auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
                 auto packed_vec = fc::raw::pack( vec );
+                offsets.push_back( pos );
                 out.write( packed_vec.data(), packed_vec.size() );
+                pos += packed_vec.size();
             });
+            detail::index_file_trailer trailer;
+            trailer.offset_table_pos = pos;
+            trailer.magic = detail::index_file_trailer::magic_value;
+            out.write( (const char*)offsets.data(), offsets.size() * sizeof(uint64_t) );
+            out.write( (const char*)&trailer, sizeof(trailer) );
+            out.close();
+            FC_ASSERT( out, "Failed to save index to ${db}", ("db",db) );
+            _dirty = false;
+         }
+
+         bool is_dirty()const override { return _dirty; }
+
+         std::unique_ptr<object> unpack_object( const char* data, size_t size )const override
+         {
+            auto result = std::make_unique<object_type>();
+            fc::datastream<const char*> ds( data, size );
+            fc::raw::unpack( ds, *result );
+            return result;
          }
 
          const object&  load( const std::vector<char>& data )override
          {
+            _dirty = true;
             const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
             for( const auto& item : _sindex )
                item->object_inserted( result );
@@ -391,6 +536,7 @@ namespace graphene { namespace db {
 
          const object&  create(const std::function<void(object&)>& constructor )override
          {
+            _dirty = true;
             const auto& result = DerivedIndex::create( constructor );
             for( const auto& item : _sindex )
                item->object_inserted( result );
@@ -400,6 +546,7 @@ namespace graphene { namespace db {
 
          const object& insert( object&& obj ) override
          {
+            _dirty = true;
             const auto& result = DerivedIndex::insert( std::move( obj ) );
             for( const auto& item : _sindex )
                item->object_inserted( result );
@@ -409,6 +556,7 @@ namespace graphene { namespace db {
 
          void  remove( const object& obj ) override
          {
+            _dirty = true;
             for( const auto& item : _sindex )
                item->object_removed( obj );
             on_remove(obj);
@@ -417,6 +565,7 @@ namespace graphene { namespace db {
 
          void modify( const object& obj, const std::function<void(object&)>& m )override
          {
+            _dirty = true;
             save_undo( obj );
             for( const auto& item : _sindex )
                item->about_to_modify( obj );
@@ -452,6 +601,36 @@ namespace graphene { namespace db {
       private:
          object_id_type                                 _next_id;
          const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
+         /// Set by every change, cleared when the index is opened from or saved to disk
+         bool                                           _dirty = true;
+
+         /// A mapped index file whose records are being decoded by the jobs returned from prepare_open()
+         struct open_state
+         {
+            explicit open_state( const fc::path& db )
+            : mapping( db.generic_string().c_str(), fc::read_only ),
+              region( mapping, fc::read_only, 0, fc::file_size( db ) ) {}
+
+            const char* data()const { return (const char*)region.get_address(); }
+            size_t      size()const { return region.get_size(); }
+
+            fc::file_mapping                       mapping;
+            fc::mapped_region                      region;
+            std::vector< std::vector<object_type> > chunks; ///< decoded objects not inserted yet, one vector per job
+         };
+         std::shared_ptr<open_state>                    _open_state;
+
+         /// Decodes one record, a packed object that is prefixed by its size, straight from the mapped file
+         static void decode_record( fc::datastream<const char*>& ds, std::vector<object_type>& objects )
+         {
+            fc::unsigned_int size;
+            fc::raw::unpack( ds, size );
+            FC_ASSERT( size.value <= ds.remaining(), "Truncated record in index file" );
+            fc::datastream<const char*> record( ds.pos(), size.value );
+            objects.emplace_back();
+            fc::raw::unpack( record, objects.back() );
+            ds.skip( size.value );
+         }
    };
 
 } } // graphene::db
@@ -74,6 +74,9 @@ namespace graphene { namespace db {
          virtual void                    move_from( object& obj ) = 0;
          virtual fc::variant             to_variant()const  = 0;
          virtual std::vector<char>       pack()const = 0;
+         virtual size_t                  packed_size()const = 0;
+         /// Packs the object into @p buffer, which must hold at least packed_size() bytes
+         virtual void                    pack_to( char* buffer, size_t size )const = 0;
          /// @}
    };
 
@@ -101,6 +104,12 @@ namespace graphene { namespace db {
          fc::variant to_variant()const override
          { return fc::variant( static_cast<const DerivedClass&>(*this), MAX_NESTING ); }
          std::vector<char> pack()const override { return fc::raw::pack( static_cast<const DerivedClass&>(*this) ); }
+         size_t packed_size()const override { return fc::raw::pack_size( static_cast<const DerivedClass&>(*this) ); }
+         void   pack_to( char* buffer, size_t size )const override
+         {
+            fc::datastream<char*> ds( buffer, size );
+            fc::raw::pack( ds, static_cast<const DerivedClass&>(*this) );
+         }
    };
 
    template<typename DerivedClass, uint8_t SpaceID, uint8_t TypeID>
@@ -53,7 +53,8 @@ namespace graphene { namespace db {
          void open(const fc::path& data_dir );
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          * Saves the complete state of the object_database to disk. Only indexes that changed since the last
+          * open() or flush() are serialized, the files of all others are hard linked from the previous state.
           */
          void flush();
          void wipe(const fc::path& data_dir); // remove from disk
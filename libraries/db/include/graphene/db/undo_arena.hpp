@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    * @class undo_arena
+    * @brief monotonic memory for a single undo state
+    *
+    * Memory is handed out from large blocks by bumping a pointer and is never returned piecemeal. Everything
+    * allocated from the arena is released at once by release(), which keeps the first block so that a recycled
+    * arena serves the next session without touching the heap.
+    */
+   class undo_arena
+   {
+      public:
+         static constexpr size_t block_size = 64 * 1024;
+
+         void*  allocate( size_t size, size_t alignment );
+         /// Releases everything allocated from the arena, contents must not be accessed afterwards
+         void   release();
+
+         /// Number of bytes reserved from the heap, including unused space at the end of blocks
+         size_t reserved_bytes()const { return _reserved; }
+         size_t block_count()const    { return _blocks.size(); }
+
+      private:
+         struct block
+         {
+            std::unique_ptr<char[]> data;
+            size_t                  size;
+         };
+
+         std::vector<block> _blocks;
+         char*              _next = nullptr;
+         char*              _end = nullptr;
+         size_t             _reserved = 0;
+   };
+
+   /**
+    * Stateful allocator drawing from an undo_arena. Deallocation is a no-op, memory is reclaimed when the arena is
+    * released. The allocator propagates with its container so that swapping or moving containers stays valid.
+    */
+   template<typename T>
+   class undo_allocator
+   {
+      public:
+         using value_type = T;
+         using propagate_on_container_copy_assignment = std::true_type;
+         using propagate_on_container_move_assignment = std::true_type;
+         using propagate_on_container_swap = std::true_type;
+
+         explicit undo_allocator( undo_arena* arena ) : _arena( arena ) {}
+         template<typename U>
+         undo_allocator( const undo_allocator<U>& other ) : _arena( other._arena ) {}
+
+         T*   allocate( size_t n ) { return static_cast<T*>( _arena->allocate( n * sizeof(T), alignof(T) ) ); }
+         void deallocate( T*, size_t ) {}
+
+         template<typename U>
+         bool operator == ( const undo_allocator<U>& other )const { return _arena == other._arena; }
+         template<typename U>
+         bool operator != ( const undo_allocator<U>& other )const { return _arena != other._arena; }
+
+      private:
+         template<typename U> friend class undo_allocator;
+
+         undo_arena* _arena;
+   };
+
+   template<typename Key, typename Value>
+   using undo_map = std::unordered_map< Key, Value, std::hash<Key>, std::equal_to<Key>,
+                                        undo_allocator< std::pair<const Key, Value> > >;
+   template<typename Key>
+   using undo_set = std::unordered_set< Key, std::hash<Key>, std::equal_to<Key>, undo_allocator<Key> >;
+
+} } // graphene::db
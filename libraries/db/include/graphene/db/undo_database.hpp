@@ -23,19 +23,40 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <graphene/db/undo_arena.hpp>
 #include <deque>
+#include <functional>
 #include <fc/exception/exception.hpp>
 
 namespace graphene { namespace db {
 
    class object_database;
 
+   /**
+    * Packed value of an object as it was before its first modification in an undo state. The bytes live in the arena
+    * of the state, so recording an image takes no heap allocation, and the image is only unpacked if the state is
+    * undone.
+    */
+   struct object_image
+   {
+      const char* data = nullptr;
+      size_t      size = 0;
+   };
+
+   /**
+    * All containers of an undo state allocate from the arena of the state, which is released in one step when the
+    * state is committed into its parent, undone or dropped from the stack.
+    */
    struct undo_state
    {
-      std::unordered_map<object_id_type, std::unique_ptr<object> > old_values;
-      std::unordered_map<object_id_type, object_id_type>           old_index_next_ids;
-      std::unordered_set<object_id_type>                           new_ids;
-      std::unordered_map<object_id_type, std::unique_ptr<object> > removed;
+      explicit undo_state( std::unique_ptr<undo_arena> a );
+
+      /// Declared first so that it outlives the containers below
+      std::unique_ptr<undo_arena>                          arena;
+      undo_map<object_id_type, object_image>               old_values;
+      undo_map<object_id_type, object_id_type>             old_index_next_ids;
+      undo_set<object_id_type>                             new_ids;
+      undo_map<object_id_type, std::unique_ptr<object> >   removed;
    };
 
 
@@ -124,16 +145,36 @@ namespace graphene { namespace db {
 
          const undo_state& head()const;
 
+         /// Sets a function that is called before the changes of a state are undone, by a session or by pop_commit()
+         void set_undo_callback( std::function<void()> callback ) { _undo_callback = std::move( callback ); }
+
+         /// Decodes the old value of the object @p id that is recorded in @p image
+         std::unique_ptr<object> unpack_image( const object_id_type& id, const object_image& image )const;
+
       private:
          void undo();
          void merge();
          void commit();
 
+         /// Pushes a new state, reusing a released arena when one is available
+         undo_state& push_state();
+         void        pop_state_back();
+         void        pop_state_front();
+         void        recycle_arena( std::unique_ptr<undo_arena> arena );
+
+         /// Restores the modified object @p id to its value in @p image
+         void                    restore_image( const object_id_type& id, const object_image& image );
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
          std::deque<undo_state>  _stack;
+         /// Released arenas kept for reuse, so that short sessions do not allocate blocks from the heap
+         std::vector< std::unique_ptr<undo_arena> > _spare_arenas;
          object_database&        _db;
          size_t                  _max_size = 256;
+         std::function<void()>   _undo_callback;
+
+         static constexpr size_t max_spare_arenas = 8;
    };
 
 } } // graphene::db
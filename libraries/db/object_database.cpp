@@ -27,8 +27,27 @@
 #include <fc/container/flat.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <algorithm>
+#include <deque>
+#include <thread>
+
 namespace graphene { namespace db {
 
+namespace {
+   /// Hard links an unchanged index file into a new database directory, falls back to copying it
+   void link_or_copy( const fc::path& from, const fc::path& to )
+   {
+      try
+      {
+         fc::create_hard_link( from, to );
+      }
+      catch( const fc::exception& )
+      {
+         fc::copy( from, to );
+      }
+   }
+}
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -90,12 +109,24 @@ void object_database::flush()
    std::vector<fc::future<void>> tasks;
    constexpr size_t max_tasks = 200;
    tasks.reserve(max_tasks);
-
-   auto push_task = [this,&tasks,&tmp_dir]( size_t space, size_t type ) {
-      if( _index[space][type] )
-         tasks.push_back( fc::do_parallel( [this,space,type,&tmp_dir] () {
-            _index[space][type]->save( tmp_dir / fc::to_string(space) / fc::to_string(type) );
-         } ) );
+   size_t unchanged = 0;
+
+   // Only indexes that changed since they were opened or saved are rewritten, the files of all others are
+   // taken over from the current database directory. Files are never modified in place, so the new directory
+   // replaces the current one the same way as when all indexes are rewritten.
+   auto push_task = [this,&tasks,&tmp_dir,&target_dir,&unchanged]( size_t space, size_t type ) {
+      if( !_index[space][type] )
+         return;
+      const fc::path file = fc::path( fc::to_string(space) ) / fc::to_string(type);
+      if( !_index[space][type]->is_dirty() && fc::exists( target_dir / file ) )
+      {
+         link_or_copy( target_dir / file, tmp_dir / file );
+         ++unchanged;
+         return;
+      }
+      tasks.push_back( fc::do_parallel( [this,space,type,&tmp_dir] () {
+         _index[space][type]->save( tmp_dir / fc::to_string(space) / fc::to_string(type) );
+      } ) );
    };
 
    const auto spaces = _index.size();
@@ -108,6 +139,7 @@ void object_database::flush()
    }
    for( auto& task : tasks )
       task.wait();
+   dlog( "Saved ${n} changed object database indexes, kept ${u} unchanged", ("n",tasks.size())("u",unchanged) );
    fc::remove_all( tmp_dir / "lock" );
    if( fc::exists( target_dir ) )
    {
@@ -135,26 +167,50 @@ void object_database::open(const fc::path& data_dir)
        wlog("Ignoring locked object_database");
        return;
    }
-   std::vector<fc::future<void>> tasks;
-   tasks.reserve(200);
-
-   auto push_task = [this,&tasks]( size_t space, size_t type ) {
-      if( _index[space][type] )
-         tasks.push_back( fc::do_parallel( [this,space,type] () {
-            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space) / fc::to_string(type) );
-         } ) );
+   // Opening is pipelined, so that a single large index does not dominate the time it takes: the chunks of all
+   // indexes are decoded concurrently, while this thread inserts each chunk in order as soon as it is decoded.
+   // Decoding runs only a limited number of chunks ahead, so that few decoded objects wait to be inserted.
+   // Inserting from one thread also keeps secondary indexes that are shared by several indexes consistent.
+   struct open_job
+   {
+      index*                idx;
+      size_t                chunk;
+      std::function<void()> decode;
    };
-
+   std::vector<index*> indexes;
+   std::vector<open_job> jobs;
    ilog("Opening object database from ${d} ...", ("d", data_dir));
    const auto spaces = _index.size();
    for( size_t space = 0; space < spaces; ++space )
    {
       const auto types = _index[space].size();
       for( size_t type = 0; type  < types; ++type )
-         push_task( space, type );
+      {
+         if( !_index[space][type] )
+            continue;
+         index* idx = _index[space][type].get();
+         auto index_jobs = idx->prepare_open( _data_dir / "object_database"
+                                              / fc::to_string(space) / fc::to_string(type) );
+         for( size_t chunk = 0; chunk < index_jobs.size(); ++chunk )
+            jobs.push_back( { idx, chunk, std::move( index_jobs[chunk] ) } );
+         indexes.push_back( idx );
+      }
    }
-   for( auto& task : tasks )
-      task.wait();
+
+   const size_t max_decoded_ahead = std::max( 2u, 2 * std::thread::hardware_concurrency() );
+   std::deque<fc::future<void>> tasks;
+   size_t next_decoded = 0;
+   for( open_job& job : jobs )
+   {
+      while( next_decoded < jobs.size() && tasks.size() < max_decoded_ahead )
+         tasks.push_back( fc::do_parallel( jobs[next_decoded++].decode ) );
+      tasks.front().wait();
+      tasks.pop_front();
+      job.decode = std::function<void()>();
+      job.idx->insert_decoded( job.chunk );
+   }
+   for( index* idx : indexes )
+      idx->finish_open();
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) } // GCOVR_EXCL_LINE
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/undo_arena.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace graphene { namespace db {
+
+constexpr size_t undo_arena::block_size;
+
+void* undo_arena::allocate( size_t size, size_t alignment )
+{
+   auto align_up = [alignment]( char* pos ) {
+      auto p = reinterpret_cast<uintptr_t>( pos );
+      return reinterpret_cast<char*>( ( p + alignment - 1 ) & ~uintptr_t( alignment - 1 ) );
+   };
+   char* result = _next == nullptr ? nullptr : align_up( _next );
+   if( result == nullptr || size > size_t( _end - result ) )
+   {
+      // oversized requests get a block of their own
+      const size_t new_size = std::max( block_size, size + alignment );
+      _blocks.push_back( block{ std::unique_ptr<char[]>( new char[new_size] ), new_size } );
+      _reserved += new_size;
+      _next = _blocks.back().data.get();
+      _end = _next + new_size;
+      result = align_up( _next );
+   }
+   _next = result + size;
+   return result;
+}
+
+void undo_arena::release()
+{
+   if( _blocks.empty() )
+      return;
+   _blocks.erase( _blocks.begin() + 1, _blocks.end() );
+   _reserved = _blocks.front().size;
+   _next = _blocks.front().data.get();
+   _end = _next + _blocks.front().size;
+}
+
+} } // graphene::db
@@ -25,8 +25,30 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <cstring>
+
 namespace graphene { namespace db {
 
+namespace {
+
+object_image copy_image( undo_arena& arena, const object_image& image )
+{
+   char* data = static_cast<char*>( arena.allocate( image.size, 1 ) );
+   std::memcpy( data, image.data, image.size );
+   return object_image{ data, image.size };
+}
+
+} // anonymous namespace
+
+undo_state::undo_state( std::unique_ptr<undo_arena> a )
+: arena( std::move(a) ),
+  old_values( undo_allocator<char>( arena.get() ) ),
+  old_index_next_ids( undo_allocator<char>( arena.get() ) ),
+  new_ids( undo_allocator<char>( arena.get() ) ),
+  removed( undo_allocator<char>( arena.get() ) )
+{
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -51,9 +73,9 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
       _disabled = false;
 
    while( size() > max_size() )
-      _stack.pop_front();
+      pop_state_front();
 
-   _stack.emplace_back();
+   push_state();
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
@@ -62,7 +84,7 @@ void undo_database::on_create( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
@@ -75,30 +97,34 @@ void undo_database::on_modify( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   const size_t size = obj.packed_size();
+   char* data = static_cast<char*>( state.arena->allocate( size, 1 ) );
+   obj.pack_to( data, size );
+   state.old_values.emplace( obj.id, object_image{ data, size } );
 }
 void undo_database::on_remove( const object& obj )
 {
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    undo_state& state = _stack.back();
    if( state.new_ids.count(obj.id) > 0 )
    {
       state.new_ids.erase(obj.id);
       return;
    }
-   if( state.old_values.count(obj.id) > 0 )
+   auto itr = state.old_values.find(obj.id);
+   if( itr != state.old_values.end() )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
-      state.old_values.erase(obj.id);
+      state.removed[obj.id] = unpack_image( obj.id, itr->second );
+      state.old_values.erase(itr);
       return;
    }
    if( state.removed.count(obj.id) > 0 ) return;
@@ -109,13 +135,13 @@ void undo_database::undo()
 { try {
    FC_ASSERT( !_disabled );
    FC_ASSERT( _active_sessions > 0 );
+   if( _undo_callback )
+      _undo_callback();
    disable();
 
    auto& state = _stack.back();
    for( auto& item : state.old_values )
-   {
-      _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
-   }
+      restore_image( item.first, item.second );
 
    for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
    {
@@ -130,7 +156,7 @@ void undo_database::undo()
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
 
-   _stack.pop_back();
+   pop_state_back();
    enable();
    --_active_sessions;
 } FC_CAPTURE_AND_RETHROW() } // GCOVR_EXCL_LINE
@@ -140,7 +166,7 @@ void undo_database::merge()
    FC_ASSERT( _active_sessions > 0 );
    if( _active_sessions == 1 && _stack.size() == 1 )
    {
-      _stack.pop_back();
+      pop_state_back();
       --_active_sessions;
       return;
    }
@@ -193,20 +219,21 @@ void undo_database::merge()
    // *+upd
    for( auto& obj : state.old_values )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
       {
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.old_values.find(obj.first) != prev_state.old_values.end() )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
       // del+upd -> N/A
-      assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
+      assert( prev_state.removed.find(obj.first) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      // the image is copied, the arena of state is released below
+      prev_state.old_values.emplace( obj.first, copy_image( *prev_state.arena, obj.second ) );
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
@@ -243,8 +270,8 @@ void undo_database::merge()
       if( it != prev_state.old_values.end() )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         prev_state.removed[obj.second->id] = unpack_image( obj.second->id, it->second );
+         prev_state.old_values.erase(it);
          continue;
       }
       // del + del -> N/A
@@ -252,7 +279,7 @@ void undo_database::merge()
       // nop + del(was=Y) -> del(was=Y)
       prev_state.removed[obj.second->id] = std::move(obj.second);
    }
-   _stack.pop_back();
+   pop_state_back();
    --_active_sessions;
 }
 void undo_database::commit()
@@ -265,15 +292,15 @@ void undo_database::pop_commit()
 {
    FC_ASSERT( _active_sessions == 0 );
    FC_ASSERT( !_stack.empty() );
+   if( _undo_callback )
+      _undo_callback();
 
    disable();
    try {
       auto& state = _stack.back();
 
       for( auto& item : state.old_values )
-      {
-         _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
-      }
+         restore_image( item.first, item.second );
 
       for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
       {
@@ -288,7 +315,7 @@ void undo_database::pop_commit()
       for( auto& item : state.removed )
          _db.insert( std::move(*item.second) );
 
-      _stack.pop_back();
+      pop_state_back();
    }
    catch ( const fc::exception& e )
    {
@@ -298,6 +325,54 @@ void undo_database::pop_commit()
    }
    enable();
 }
+std::unique_ptr<object> undo_database::unpack_image( const object_id_type& id, const object_image& image )const
+{
+   return _db.get_index( id.space(), id.type() ).unpack_object( image.data, image.size );
+}
+
+void undo_database::restore_image( const object_id_type& id, const object_image& image )
+{
+   std::unique_ptr<object> old_value = unpack_image( id, image );
+   _db.modify( _db.get_object( id ), [&old_value]( object& obj ){ obj.move_from( *old_value ); } );
+}
+
+undo_state& undo_database::push_state()
+{
+   std::unique_ptr<undo_arena> arena;
+   if( _spare_arenas.empty() )
+      arena = std::make_unique<undo_arena>();
+   else
+   {
+      arena = std::move( _spare_arenas.back() );
+      _spare_arenas.pop_back();
+   }
+   _stack.emplace_back( std::move(arena) );
+   return _stack.back();
+}
+
+void undo_database::pop_state_back()
+{
+   // keep the arena alive until the containers allocated from it are destroyed
+   std::unique_ptr<undo_arena> arena = std::move( _stack.back().arena );
+   _stack.pop_back();
+   recycle_arena( std::move(arena) );
+}
+
+void undo_database::pop_state_front()
+{
+   std::unique_ptr<undo_arena> arena = std::move( _stack.front().arena );
+   _stack.pop_front();
+   recycle_arena( std::move(arena) );
+}
+
+void undo_database::recycle_arena( std::unique_ptr<undo_arena> arena )
+{
+   if( _spare_arenas.size() >= max_spare_arenas )
+      return;
+   arena->release();
+   _spare_arenas.push_back( std::move(arena) );
+}
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
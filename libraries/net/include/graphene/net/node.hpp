@@ -163,6 +163,12 @@ namespace graphene { namespace net {
          virtual void error_encountered(const std::string& message, const fc::oexception& error) = 0;
          virtual uint8_t get_current_block_interval_in_seconds() const = 0;
 
+         /**
+          * Returns the lowest block number whose contents can be provided to peers,
+          * 1 unless the local block log has been pruned
+          */
+         virtual uint32_t get_first_retained_block_number() const = 0;
+
    };
 
    /**
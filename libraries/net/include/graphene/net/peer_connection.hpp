@@ -268,6 +268,8 @@ namespace graphene { namespace net
       fc::time_point transaction_fetching_inhibited_until;
 
       uint32_t last_known_fork_block_number = 0;
+      /// Lowest block number the peer can provide, advertised by peers with a pruned block log, 0 if unknown
+      uint32_t first_retained_block_number = 0;
 
       fc::future<void> accept_or_connect_task_done;
 
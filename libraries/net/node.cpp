@@ -1484,6 +1484,11 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      // only advertised by nodes with a pruned block log
+      uint32_t first_retained_block_number = _delegate->get_first_retained_block_number();
+      if (first_retained_block_number > 1)
+        user_data["first_retained_block_number"] = first_retained_block_number;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1508,6 +1513,8 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>(1);
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>(1);
+      if (user_data.contains("first_retained_block_number"))
+        originating_peer->first_retained_block_number = user_data["first_retained_block_number"].as<uint32_t>(1);
     }
 
    void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -3659,6 +3666,16 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       peer->ids_of_items_to_get.clear();
       peer->number_of_unfetched_item_ids = 0;
+      // a peer with a pruned block log can not provide the blocks following our head
+      uint32_t head_block_num = _delegate->get_block_number(_delegate->get_head_block_id());
+      if( peer->first_retained_block_number > head_block_num + 1 )
+      {
+        dlog( "sync: not syncing from peer ${peer}, its block log starts at block ${first} and our head is ${head}",
+              ("peer", peer->get_remote_endpoint())("first", peer->first_retained_block_number)
+              ("head", head_block_num) );
+        peer->we_need_sync_items_from_peer = false;
+        return;
+      }
       peer->we_need_sync_items_from_peer = true;
       peer->last_block_delegate_has_seen = item_hash_t();
       peer->last_block_time_delegate_has_seen = _delegate->get_block_time(item_hash_t());
@@ -4830,6 +4847,8 @@ namespace graphene { namespace net { namespace detail {
         peer_details["current_head_block"] = fc::variant( peer->last_block_delegate_has_seen, 1 );
         peer_details["current_head_block_number"] = _delegate->get_block_number(peer->last_block_delegate_has_seen);
         peer_details["current_head_block_time"] = peer->last_block_time_delegate_has_seen;
+        if (peer->first_retained_block_number > 1)
+          peer_details["first_retained_block_number"] = peer->first_retained_block_number;
 
         peer_details["peer_needs_sync_items_from_us"] = peer->peer_needs_sync_items_from_us;
         peer_details["we_need_sync_items_from_peer"] = peer->we_need_sync_items_from_peer;
@@ -5411,6 +5430,11 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_current_block_interval_in_seconds);
     }
 
+    uint32_t statistics_gathering_node_delegate_wrapper::get_first_retained_block_number() const
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_first_retained_block_number);
+    }
+
 #undef INVOKE_AND_COLLECT_STATISTICS
 
   } // end namespace detail
@@ -284,7 +284,8 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
                                (get_head_block_id) \
                                (estimate_last_known_fork_from_git_revision_timestamp) \
                                (error_encountered) \
-                               (get_current_block_interval_in_seconds)
+                               (get_current_block_interval_in_seconds) \
+                               (get_first_retained_block_number)
 
 
 
@@ -387,6 +388,7 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
       uint32_t estimate_last_known_fork_from_git_revision_timestamp(uint32_t unix_timestamp) const override;
       void error_encountered(const std::string& message, const fc::oexception& error) override;
       uint8_t get_current_block_interval_in_seconds() const override;
+      uint32_t get_first_retained_block_number() const override;
 };
 
 /// This specifies configuration info for the local node.  It's stored as JSON
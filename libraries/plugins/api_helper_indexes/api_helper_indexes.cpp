@@ -163,11 +163,11 @@ void api_helper_indexes::plugin_startup()
    next_object_ids_idx = database().add_secondary_index<primary_index<simple_index<chain_property_object>>, next_object_ids_index>();
    refresh_next_ids();
    // connect with no group specified to process after the ones with a group specified
-   database().applied_block.connect([this](const chain::signed_block &)
+   database().applied_block.connect( database().traced_handler( plugin_name(), [this](const chain::signed_block &)
    {
       refresh_next_ids();
       _next_ids_map_initialized = true;
-   });
+   }) );
 }
 
 void api_helper_indexes::refresh_next_ids()
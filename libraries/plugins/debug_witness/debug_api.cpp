@@ -28,6 +28,7 @@ class debug_api_impl
       void debug_update_object( const fc::variant_object& update );
       void debug_stream_json_objects( const std::string& filename );
       void debug_stream_json_objects_flush();
+      graphene::witness_plugin::block_production_stats get_block_production_stats()const;
       std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > get_plugin();
 
       graphene::app::application& app;
@@ -111,6 +112,11 @@ std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > debug_ap
    return app.get_plugin< graphene::debug_witness_plugin::debug_witness_plugin >( "debug_witness" );
 }
 
+graphene::witness_plugin::block_production_stats debug_api_impl::get_block_production_stats()const
+{
+   return app.get_plugin< graphene::witness_plugin::witness_plugin >( "witness" )->get_block_production_stats();
+}
+
 void debug_api_impl::debug_stream_json_objects( const std::string& filename )
 {
    get_plugin()->set_json_object_stream( filename );
@@ -153,5 +159,10 @@ void debug_api::debug_stream_json_objects_flush()
    my->debug_stream_json_objects_flush();
 }
 
+graphene::witness_plugin::block_production_stats debug_api::get_block_production_stats()const
+{
+   return my->get_block_production_stats();
+}
+
 
 } } // graphene::debug_witness
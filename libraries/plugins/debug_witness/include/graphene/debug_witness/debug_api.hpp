@@ -29,6 +29,8 @@
 #include <fc/api.hpp>
 #include <fc/variant_object.hpp>
 
+#include <graphene/witness/witness.hpp>
+
 namespace graphene { namespace app {
 class application;
 } }
@@ -82,6 +84,12 @@ class debug_api
        */
       void debug_stream_json_objects_flush();
 
+      /**
+       * Latency of the blocks produced by this node, from the start of the slot until the block is handed over
+       * for broadcasting. Requires the witness plugin.
+       */
+      graphene::witness_plugin::block_production_stats get_block_production_stats()const;
+
       std::shared_ptr< detail::debug_api_impl > my;
 };
 
@@ -93,4 +101,5 @@ FC_API(graphene::debug_witness::debug_api,
        (debug_update_object)
        (debug_stream_json_objects)
        (debug_stream_json_objects_flush)
+       (get_block_production_stats)
      )
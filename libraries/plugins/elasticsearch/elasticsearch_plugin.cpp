@@ -568,9 +568,9 @@ void elasticsearch_plugin::plugin_initialize(const boost::program_options::varia
    if( my->_options.elasticsearch_mode != mode::only_query )
    {
       // connect with group 0 to process before some special steps (e.g. snapshot or next_object_id)
-      database().applied_block.connect( 0, [this](const signed_block &b) {
+      database().applied_block.connect( 0, database().traced_handler( plugin_name(), [this](const signed_block &b) {
          my->update_account_histories(b);
-      });
+      }) );
    }
 }
 
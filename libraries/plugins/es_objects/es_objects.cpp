@@ -500,18 +500,18 @@ void es_objects_plugin::plugin_initialize(const boost::program_options::variable
 {
    my->init_program_options( options );
 
-   database().new_objects.connect([this]( const vector<object_id_type>& ids,
-         const flat_set<account_id_type>& ) {
+   database().new_objects.connect( database().traced_handler( plugin_name(),
+         [this]( const vector<object_id_type>& ids, const flat_set<account_id_type>& ) {
       my->on_objects_create( ids );
-   });
-   database().changed_objects.connect([this]( const vector<object_id_type>& ids,
-         const flat_set<account_id_type>& ) {
+   }) );
+   database().changed_objects.connect( database().traced_handler( plugin_name(),
+         [this]( const vector<object_id_type>& ids, const flat_set<account_id_type>& ) {
       my->on_objects_update( ids );
-   });
-   database().removed_objects.connect([this](const vector<object_id_type>& ids,
-         const vector<const object*>&, const flat_set<account_id_type>& ) {
+   }) );
+   database().removed_objects.connect( database().traced_handler( plugin_name(),
+         [this]( const vector<object_id_type>& ids, const vector<const object*>&, const flat_set<account_id_type>& ) {
       my->on_objects_delete( ids );
-   });
+   }) );
 
 }
 
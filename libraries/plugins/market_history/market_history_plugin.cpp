@@ -420,7 +420,8 @@ void market_history_plugin::plugin_set_program_options(
 
 void market_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 { try {
-   database().applied_block.connect( [this]( const signed_block& b){ my->update_market_histories(b); } );
+   database().applied_block.connect( database().traced_handler( plugin_name(),
+                                     [this]( const signed_block& b){ my->update_market_histories(b); } ) );
    database().add_index< primary_index< bucket_index  > >();
    database().add_index< primary_index< history_index  > >();
    database().add_index< primary_index< market_ticker_index  > >();
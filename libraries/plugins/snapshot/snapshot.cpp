@@ -73,9 +73,10 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
       if( options.count(OPT_BLOCK_TIME) > 0 )
          snapshot_time = fc::time_point_sec::from_iso_string( options[OPT_BLOCK_TIME].as<std::string>() );
       // connect with no group specified to process after the ones with a group specified
-      database().applied_block.connect( [&]( const graphene::chain::signed_block& b ) {
+      database().applied_block.connect( database().traced_handler( plugin_name(),
+                                        [&]( const graphene::chain::signed_block& b ) {
          check_snapshot( b );
-      });
+      }) );
    }
    else
       ilog("snapshot plugin is not enabled because neither snapshot-at-block nor snapshot-at-time is specified");
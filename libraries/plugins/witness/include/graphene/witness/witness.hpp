@@ -26,6 +26,7 @@
 #include <graphene/app/plugin.hpp>
 #include <graphene/chain/database.hpp>
 
+#include <fc/reflect/reflect.hpp>
 #include <fc/thread/future.hpp>
 
 namespace graphene { namespace witness_plugin {
@@ -47,6 +48,18 @@ namespace block_production_condition
    };
 }
 
+/// Latency of block production, from the start of the slot until the block is handed over for broadcasting
+struct block_production_stats
+{
+   uint64_t         blocks = 0; ///< Number of blocks produced
+   fc::microseconds last_latency;
+   fc::microseconds max_latency;
+   fc::microseconds total_latency;
+
+   fc::microseconds average_latency()const
+   { return blocks == 0 ? fc::microseconds() : fc::microseconds( total_latency.count() / blocks ); }
+};
+
 class witness_plugin : public graphene::app::plugin {
 public:
    using graphene::app::plugin::plugin;
@@ -69,6 +82,8 @@ public:
    inline const fc::flat_map< chain::witness_id_type, fc::optional<chain::public_key_type> >& get_witness_key_cache()
    { return _witness_key_cache; }
 
+   const block_production_stats& get_block_production_stats()const { return _production_stats; }
+
 private:
    void cleanup() { stop_block_production(); }
 
@@ -93,6 +108,10 @@ private:
    /// For tracking signing keys of specified witnesses, only update when applied a block
    fc::flat_map< chain::witness_id_type, fc::optional<chain::public_key_type> > _witness_key_cache;
 
+   block_production_stats _production_stats;
+
 };
 
 } } //graphene::witness_plugin
+
+FC_REFLECT( graphene::witness_plugin::block_production_stats, (blocks)(last_latency)(max_latency)(total_latency) )
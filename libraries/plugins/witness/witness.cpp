@@ -182,10 +182,10 @@ void witness_plugin::plugin_startup()
          _production_skip_flags |= graphene::chain::database::skip_undo_history_check;
       }
       refresh_witness_key_cache();
-      d.applied_block.connect( [this]( const chain::signed_block& b )
+      d.applied_block.connect( d.traced_handler( plugin_name(), [this]( const chain::signed_block& b )
       {
          refresh_witness_key_cache();
-      });
+      }) );
       schedule_production_loop();
    }
    else
@@ -269,7 +269,8 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    switch( result )
    {
       case block_production_condition::produced:
-         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c}", (capture));
+         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c}, "
+              "${l}us after the start of the slot", (capture));
          break;
       case block_production_condition::not_synced:
          ilog("Not producing block because production is disabled until we receive a recent block "
@@ -381,7 +382,13 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
       private_key_itr->second,
       _production_skip_flags
       );
-   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size());
+   const fc::microseconds latency = fc::time_point::now() - fc::time_point( scheduled_time );
+   ++_production_stats.blocks;
+   _production_stats.last_latency = latency;
+   _production_stats.max_latency = std::max( _production_stats.max_latency, latency );
+   _production_stats.total_latency += latency;
+   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size())
+          ("l", latency.count());
    fc::async( [this,block](){ p2p_node()->broadcast(net::block_message(block)); } );
 
    return block_production_condition::produced;
@@ -28,18 +28,39 @@
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/transaction_history_object.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <iostream>
+#include <new>
+#include <random>
 
 using namespace graphene::chain;
 
+namespace {
+   /// Number of calls of the global operator new, for comparing allocation counts in benchmarks
+   std::atomic<uint64_t> allocation_count{0};
+}
+
+void* operator new( std::size_t size )
+{
+   ++allocation_count;
+   if( void* result = std::malloc( size > 0 ? size : 1 ) )
+      return result;
+   throw std::bad_alloc();
+}
+void operator delete( void* ptr ) noexcept { std::free( ptr ); }
+void operator delete( void* ptr, std::size_t ) noexcept { std::free( ptr ); }
+
 BOOST_FIXTURE_TEST_SUITE( performance_tests, database_fixture )
 
 BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
@@ -208,4 +229,339 @@ BOOST_AUTO_TEST_CASE( one_hundred_k_benchmark )
    db._undo_db.enable();
 } FC_LOG_AND_RETHROW() }
 
+// Compares recording the old value of modified objects in undo states as whole-object clones, as it used to be
+// done, with packed images, and measures undo sessions that modify many large objects.
+BOOST_AUTO_TEST_CASE( undo_image_benchmark )
+{ try {
+   const uint32_t account_count = 5000;
+   const uint32_t rounds = 20;
+
+   std::vector<const account_object*> accounts;
+   accounts.reserve( account_count );
+   for( uint32_t i = 0; i < account_count; ++i )
+   {
+      accounts.push_back( &db.create<account_object>( [i]( account_object& a ) {
+         a.name = "bench" + fc::to_string( i );
+         for( uint32_t k = 0; k < 4; ++k )
+         {
+            const public_key_type key = fc::ecc::private_key::regenerate(
+                                              fc::sha256::hash( a.name + fc::to_string( k ) ) ).get_public_key();
+            a.owner.add_authority( key, 1 );
+            a.active.add_authority( key, 1 );
+            a.active.add_authority( account_id_type( k ), 1 );
+         }
+         a.owner.weight_threshold = 1;
+         a.active.weight_threshold = 1;
+         for( uint32_t v = 0; v < 30; ++v )
+            a.options.votes.insert( vote_id_type( vote_id_type::witness, v ) );
+      } ) );
+   }
+
+   auto measure = [&]( const std::string& name, const std::function<void()>& work ) {
+      const uint64_t allocations_before = allocation_count.load();
+      const auto start = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         work();
+      const auto elapsed = fc::time_point::now() - start;
+      const uint64_t allocations = allocation_count.load() - allocations_before;
+      wlog( "Benchmark: ${name}: ${a} allocations and ${t}us per object",
+            ("name",name)("a",double(allocations) / (rounds * account_count))
+            ("t",double(elapsed.count()) / (rounds * account_count)) );
+   };
+
+   measure( "clone", [&accounts]() {
+      for( const account_object* a : accounts )
+         a->clone();
+   } );
+   measure( "packed image", [&accounts]() {
+      for( const account_object* a : accounts )
+         a->pack();
+   } );
+   measure( "modify, merge and undo", [this,&accounts]() {
+      auto outer = db._undo_db.start_undo_session();
+      {
+         auto inner = db._undo_db.start_undo_session();
+         for( const account_object* a : accounts )
+            db.modify( *a, []( account_object& acct ) { acct.referrer_rewards_percentage ^= 1; } );
+         inner.merge();
+      }
+      outer.undo();
+   } );
+   measure( "modify and undo", [this,&accounts]() {
+      auto session = db._undo_db.start_undo_session();
+      for( const account_object* a : accounts )
+         db.modify( *a, []( account_object& acct ) { acct.referrer_rewards_percentage ^= 1; } );
+      session.undo();
+   } );
+
+   for( const account_object* a : accounts )
+      BOOST_CHECK_EQUAL( a->referrer_rewards_percentage, 0 );
+} FC_LOG_AND_RETHROW() }
+
+// Compares lookups by ID in the dense account index with lookups in the ordered by-ID tree that used to hold
+// accounts, and lookups by name through the pointer views of the dense index.
+BOOST_AUTO_TEST_CASE( dense_index_benchmark )
+{ try {
+   const uint32_t account_count = 200000;
+   const uint32_t rounds = 10;
+
+   std::vector< std::pair<account_id_type, std::string> > lookups;
+   lookups.reserve( account_count );
+   for( uint32_t i = 0; i < account_count; ++i )
+   {
+      const std::string name = "bench" + fc::to_string( i );
+      lookups.emplace_back( db.create<account_object>( [&name]( account_object& a ) { a.name = name; } ).get_id(),
+                            name );
+   }
+   std::shuffle( lookups.begin(), lookups.end(), std::mt19937( 42 ) );
+
+   account_multi_index_type tree;
+   for( const account_object& a : db.get_index_type<account_index>().indices() )
+      tree.insert( a );
+
+   auto measure = [&]( const std::string& name, const std::function<uint64_t()>& work ) {
+      uint64_t found = 0;
+      const auto start = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         found += work();
+      const auto elapsed = fc::time_point::now() - start;
+      BOOST_CHECK_EQUAL( found, uint64_t(rounds) * account_count );
+      wlog( "Benchmark: ${name}: ${t}ns per lookup",
+            ("name",name)("t",double(elapsed.count()) * 1000 / (rounds * account_count)) );
+   };
+
+   measure( "ordered tree by ID", [&tree,&lookups]() {
+      uint64_t found = 0;
+      for( const auto& item : lookups )
+         found += ( tree.find( object_id_type( item.first ) ) != tree.end() );
+      return found;
+   } );
+   measure( "dense index by ID", [this,&lookups]() {
+      uint64_t found = 0;
+      for( const auto& item : lookups )
+         found += ( db.find( item.first ) != nullptr );
+      return found;
+   } );
+   measure( "dense index by name", [this,&lookups]() {
+      const auto& by_name_idx = db.get_index_type<account_index>().indices().get<by_name>();
+      uint64_t found = 0;
+      for( const auto& item : lookups )
+         found += ( by_name_idx.find( item.second ) != by_name_idx.end() );
+      return found;
+   } );
+} FC_LOG_AND_RETHROW() }
+
+// Measures applying a block of transfers between distinct accounts with the validation and authority checks of its
+// transactions done serially and in parallel. Signatures are recovered in advance in both cases, as the
+// application does with precompute_parallel(), so only the checks that are done in parallel differ.
+BOOST_AUTO_TEST_CASE( parallel_transaction_checks_benchmark )
+{ try {
+   const uint32_t account_count = 2000;
+   const uint32_t rounds = 10;
+
+   std::vector<fc::ecc::private_key> keys;
+   std::vector<account_id_type> ids;
+   for( uint32_t i = 0; i < account_count; ++i )
+   {
+      keys.push_back( generate_private_key( "parallel" + fc::to_string( i ) ) );
+      ids.push_back( create_account( "parallel" + fc::to_string( i ), keys.back().get_public_key() ).id );
+      transfer( committee_account, ids.back(), asset( 1000000 ) );
+   }
+   generate_block();
+
+   for( uint32_t i = 0; i + 1 < account_count; i += 2 )
+   {
+      signed_transaction trx;
+      set_expiration( db, trx );
+      transfer_operation t;
+      t.from = ids[i];
+      t.to = ids[i + 1];
+      t.amount = asset( 1 );
+      trx.operations.push_back( t );
+      sign( trx, keys[i] );
+      PUSH_TX( db, trx, database::skip_nothing );
+   }
+   const signed_block block = generate_block( database::skip_nothing );
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), account_count / 2 );
+   db.precompute_parallel( block ).wait();
+
+   auto measure = [&]( const std::string& name, bool parallel ) {
+      db.enable_parallel_transaction_checks( parallel );
+      fc::microseconds elapsed;
+      for( uint32_t r = 0; r < rounds; ++r )
+      {
+         db.pop_block();
+         const auto start = fc::time_point::now();
+         db.push_block( block, database::skip_nothing );
+         elapsed += fc::time_point::now() - start;
+      }
+      BOOST_CHECK( db.head_block_id() == block.id() );
+      wlog( "Benchmark: ${name}: ${t}us per transaction",
+            ("name",name)("t",double(elapsed.count()) / (rounds * block.transactions.size())) );
+   };
+
+   measure( "serial transaction checks", false );
+   measure( "parallel transaction checks", true );
+} FC_LOG_AND_RETHROW() }
+
+// Compares inserting limit orders into, and looking up prices in, an index ordered by the price with an index
+// ordered by the precomputed sort key of the price.
+BOOST_AUTO_TEST_CASE( price_sort_key_benchmark )
+{ try {
+   const uint32_t order_count = 200000;
+   const uint32_t rounds = 10;
+
+   std::vector<limit_order_object> orders( order_count );
+   std::mt19937_64 gen( 42 );
+   std::uniform_int_distribution<int64_t> amount_uid( 1, 1000*1000*1000 );
+   for( uint32_t i = 0; i < order_count; ++i )
+   {
+      orders[i].id = limit_order_id_type( i );
+      orders[i].for_sale = amount_uid( gen );
+      orders[i].sell_price = price( asset( amount_uid( gen ) ), asset( amount_uid( gen ), asset_id_type(1) ) );
+   }
+
+   typedef multi_index_container< limit_order_object, indexed_by<
+      ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_price>,
+         composite_key< limit_order_object,
+            member< limit_order_object, price, &limit_order_object::sell_price >,
+            member< object, object_id_type, &object::id >
+         >,
+         composite_key_compare< std::greater<price>, std::less<object_id_type> >
+      >
+   > > price_ordered_index;
+   typedef multi_index_container< limit_order_object, indexed_by<
+      ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_price>,
+         composite_key< limit_order_object,
+            member< limit_order_object, price_sort_key, &limit_order_object::sell_price_key >,
+            member< object, object_id_type, &object::id >
+         >,
+         composite_key_compare< price_sort_key_greater, std::less<object_id_type> >
+      >
+   > > key_ordered_index;
+
+   auto measure = [&]( const std::string& name, const std::function<uint64_t()>& work ) {
+      uint64_t done = 0;
+      const auto start = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         done += work();
+      const auto elapsed = fc::time_point::now() - start;
+      BOOST_CHECK_EQUAL( done, uint64_t(rounds) * order_count );
+      wlog( "Benchmark: ${name}: ${t}ns per order",
+            ("name",name)("t",double(elapsed.count()) * 1000 / (rounds * order_count)) );
+   };
+
+   price_ordered_index by_price_idx;
+   key_ordered_index by_key_idx;
+   measure( "insert ordered by price", [&orders,&by_price_idx]() {
+      by_price_idx.clear();
+      for( const auto& o : orders )
+         by_price_idx.insert( o );
+      return uint64_t( by_price_idx.size() );
+   } );
+   measure( "insert ordered by sort key", [&orders,&by_key_idx]() {
+      by_key_idx.clear();
+      for( limit_order_object o : orders )
+      {
+         o.update_sort_keys();
+         by_key_idx.insert( std::move( o ) );
+      }
+      return uint64_t( by_key_idx.size() );
+   } );
+
+   measure( "price lookup ordered by price", [&orders,&by_price_idx]() {
+      const auto& idx = by_price_idx.get<by_price>();
+      uint64_t found = 0;
+      for( const auto& o : orders )
+         found += ( idx.lower_bound( o.sell_price )->sell_price == o.sell_price );
+      return found;
+   } );
+   measure( "price lookup ordered by sort key", [&orders,&by_key_idx]() {
+      const auto& idx = by_key_idx.get<by_price>();
+      uint64_t found = 0;
+      for( const auto& o : orders )
+         found += ( idx.lower_bound( o.sell_price )->sell_price == o.sell_price );
+      return found;
+   } );
+   measure( "sort key lookup ordered by sort key", [&orders,&by_key_idx]() {
+      const auto& idx = by_key_idx.get<by_price>();
+      uint64_t found = 0;
+      for( const auto& o : orders )
+         found += ( idx.lower_bound( price_sort_key( o.sell_price ) )->sell_price == o.sell_price );
+      return found;
+   } );
+} FC_LOG_AND_RETHROW() }
+
+// Measures the memory taken by the entries of the transaction deduplication index, compared with the copy of the
+// transaction each entry used to keep, and the latency of looking up recent transactions in the blocks.
+BOOST_AUTO_TEST_CASE( recent_transaction_benchmark )
+{ try {
+   const uint32_t block_count = 100;
+   const uint32_t trx_per_block = 200;
+
+   ACTORS( (alice)(bob) );
+   fund( alice, asset(10000000) );
+   generate_block();
+
+   std::vector<transaction_id_type> ids;
+   ids.reserve( block_count * trx_per_block );
+   uint64_t trx_bytes = 0;
+   for( uint32_t b = 0; b < block_count; ++b )
+   {
+      for( uint32_t i = 0; i < trx_per_block; ++i )
+      {
+         signed_transaction tx;
+         test::set_expiration( db, tx );
+         tx.set_expiration( db.head_block_time()
+                            + db.get_global_properties().parameters.maximum_time_until_expiration );
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = bob_id;
+         op.amount = asset( 1 + i ); // blocks refer to different TaPoS blocks, this keeps the IDs unique
+         tx.operations.push_back( op );
+         for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+         tx.sign( alice_private_key, db.get_chain_id() );
+         PUSH_TX( db, tx, database::skip_transaction_signatures );
+         trx_bytes += fc::raw::pack_size( tx );
+         ids.push_back( tx.id() );
+      }
+      generate_block( ~database::skip_transaction_dupe_check );
+   }
+   std::shuffle( ids.begin(), ids.end(), std::mt19937( 42 ) );
+
+   const auto& trx_idx = db.get_index_type<transaction_index>().indices();
+   BOOST_REQUIRE_EQUAL( trx_idx.size(), ids.size() );
+   // the heap content of a transaction takes at least as many bytes as it takes packed
+   wlog( "Benchmark: deduplication entries take ${n} bytes, with a copy of the transaction at least ${o} bytes",
+         ("n",sizeof(transaction_history_object))
+         ("o",sizeof(transaction_history_object) + sizeof(signed_transaction) + trx_bytes / ids.size()) );
+
+   const uint32_t rounds = 5;
+   auto measure = [&]( const std::string& name, const std::function<uint64_t()>& work ) {
+      uint64_t found = 0;
+      const auto start = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         found += work();
+      const auto elapsed = fc::time_point::now() - start;
+      BOOST_CHECK_EQUAL( found, uint64_t(rounds) * ids.size() );
+      wlog( "Benchmark: ${name}: ${t}ns per lookup",
+            ("name",name)("t",double(elapsed.count()) * 1000 / (rounds * ids.size())) );
+   };
+
+   measure( "known transaction", [this,&ids]() {
+      uint64_t found = 0;
+      for( const auto& id : ids )
+         found += db.is_known_transaction( id );
+      return found;
+   } );
+   measure( "recent transaction", [this,&ids]() {
+      uint64_t found = 0;
+      for( const auto& id : ids )
+         found += ( db.get_recent_transaction( id ).id() == id );
+      return found;
+   } );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
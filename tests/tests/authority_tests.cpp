@@ -2273,4 +2273,74 @@ BOOST_AUTO_TEST_CASE( self_deleting_proposal )
    db.get(pid1);
 } FC_LOG_AND_RETHROW() }
 
+/// Verified transactions are remembered until the authorities they were verified against change
+BOOST_AUTO_TEST_CASE( authority_cache_invalidation )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   fund( bob );
+   generate_block();
+
+   transfer_operation to;
+   to.amount = asset( 1 );
+   to.from = alice_id;
+   to.to = bob_id;
+   trx.clear();
+   set_expiration( db, trx );
+   trx.operations.push_back( to );
+   sign( trx, alice_private_key );
+
+   const authority_cache_stats before = db.get_authority_cache_stats();
+   PUSH_TX( db, trx );
+   const authority_cache_stats pushed = db.get_authority_cache_stats();
+   BOOST_CHECK_EQUAL( pushed.misses, before.misses + 1 );
+   BOOST_CHECK_EQUAL( pushed.hits, before.hits );
+
+   // the transaction is not verified again when it is applied in a block
+   generate_block( database::skip_nothing );
+   const authority_cache_stats applied = db.get_authority_cache_stats();
+   BOOST_CHECK_GT( applied.hits, pushed.hits );
+   BOOST_CHECK_EQUAL( applied.misses, pushed.misses );
+
+   to.amount = asset( 2 );
+   trx.clear();
+   set_expiration( db, trx );
+   trx.operations.push_back( to );
+   sign( trx, alice_private_key );
+   const signed_transaction spend = trx;
+   PUSH_TX( db, spend );
+   db.clear_pending();
+
+   // once alice has replaced her keys, the remembered verification does not hold any more
+   const fc::ecc::private_key new_key = generate_private_key( "alice_new" );
+   account_update_operation auo;
+   auo.account = alice_id;
+   auo.owner = authority( 1, public_key_type( new_key.get_public_key() ), 1 );
+   auo.active = auo.owner;
+   trx.clear();
+   set_expiration( db, trx );
+   trx.operations.push_back( auo );
+   sign( trx, alice_private_key );
+   PUSH_TX( db, trx );
+
+   const authority_cache_stats updated = db.get_authority_cache_stats();
+   GRAPHENE_REQUIRE_THROW( PUSH_TX( db, spend ), fc::exception );
+   BOOST_CHECK_EQUAL( db.get_authority_cache_stats().stale_hits, updated.stale_hits + 1 );
+   BOOST_CHECK_EQUAL( db.get_authority_cache_stats().hits, updated.hits );
+
+   // a transaction of bob, whose authorities did not change, is still known to be verified
+   to.from = bob_id;
+   to.to = alice_id;
+   to.amount = asset( 1 );
+   trx.clear();
+   set_expiration( db, trx );
+   trx.operations.push_back( to );
+   sign( trx, bob_private_key );
+   PUSH_TX( db, trx );
+   db.clear_pending();
+   const authority_cache_stats cleared = db.get_authority_cache_stats();
+   PUSH_TX( db, trx );
+   BOOST_CHECK_EQUAL( db.get_authority_cache_stats().hits, cleared.hits + 1 );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
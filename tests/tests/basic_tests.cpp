@@ -29,6 +29,7 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/exceptions.hpp>
+#include <graphene/chain/price_sort_key.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
@@ -351,6 +352,58 @@ BOOST_AUTO_TEST_CASE( price_multiplication_test )
    }
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( price_sort_key_test )
+{ try {
+   std::mt19937_64 gen( time(NULL) );
+   std::uniform_int_distribution<int64_t> amt_uid(1, GRAPHENE_MAX_SHARE_SUPPLY);
+   std::uniform_int_distribution<int64_t> amt_uid2(1, 1000*1000*1000);
+   std::uniform_int_distribution<int64_t> amt_uid4(1, 1000);
+   std::uniform_int_distribution<int64_t> delta_uid(-1, 1);
+   std::uniform_int_distribution<uint32_t> asset_uid(0, 1);
+
+   auto random_amount = [&]( int i ) -> int64_t
+   {
+      switch( i % 5 )
+      {
+         case 0: return amt_uid(gen);
+         case 1: return amt_uid2(gen);
+         case 2: return amt_uid4(gen);
+         case 3: return std::numeric_limits<int64_t>::max() - amt_uid4(gen) + 1;
+         default: return amt_uid4(gen) - 2; // zero and negative amounts are compared like prices too
+      }
+   };
+   auto check_order = []( const price& a, const price& b )
+   {
+      const price_sort_key ka( a );
+      const price_sort_key kb( b );
+      BOOST_CHECK_EQUAL( ka < kb, a < b );
+      BOOST_CHECK_EQUAL( kb < ka, b < a );
+      BOOST_CHECK_EQUAL( ka < b, a < b );
+      BOOST_CHECK_EQUAL( a < kb, a < b );
+      BOOST_CHECK( ka.matches( a ) );
+   };
+
+   check_order( price::min( asset_id_type(0), asset_id_type(1) ), price::max( asset_id_type(0), asset_id_type(1) ) );
+   check_order( price::max( asset_id_type(0), asset_id_type(1) ), price::min( asset_id_type(1), asset_id_type(0) ) );
+   check_order( price( asset(1), asset(3, asset_id_type(1)) ), price( asset(2), asset(6, asset_id_type(1)) ) );
+
+   for( int i = 100*1000; i > 0; --i )
+   {
+      const asset_id_type base( asset_uid(gen) );
+      const price a( asset( random_amount(i), base ), asset( random_amount(i/5), asset_id_type(2) ) );
+      price b;
+      if( i % 3 == 0 ) // equal ratios with other amounts
+         b = price( asset( a.base.amount.value / 2 * 2, base ), asset( a.quote.amount.value / 2 * 2, a.quote.asset_id ) );
+      else if( i % 3 == 1 ) // adjacent ratios
+         b = price( asset( a.base.amount.value / 2 + delta_uid(gen), base ), asset( a.quote.amount.value / 2,
+                                                                                      a.quote.asset_id ) );
+      else
+         b = price( asset( random_amount(i/7), asset_id_type( asset_uid(gen) ) ),
+                    asset( random_amount(i/11), a.quote.asset_id ) );
+      check_order( a, b );
+   }
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( memo_test )
 { try {
    memo_data m;
@@ -607,4 +660,105 @@ BOOST_AUTO_TEST_CASE( bitasset_feed_expiration_test )
    BOOST_CHECK( !o.feed_is_expired( now ) );
 }
 
+BOOST_AUTO_TEST_CASE( median_feed_tracker_test )
+{ try {
+   std::mt19937 gen( time(NULL) );
+   std::uniform_int_distribution<int64_t> amt_uid(1, 5);
+   std::uniform_int_distribution<uint32_t> ratio_uid(1001, 1005);
+   std::uniform_int_distribution<uint32_t> publisher_uid(0, 19);
+   std::uniform_int_distribution<uint32_t> step_uid(0, 9);
+
+   asset_bitasset_data_object o;
+   o.options.feed_lifetime_sec = 100;
+   o.options.minimum_feeds = 1;
+   time_point_sec now( 1000 );
+
+   // the median as selected without the tracker
+   auto expected_median = [&o,&now]( time_point_sec& publication_time )
+   {
+      vector<price_feed> current_feeds;
+      publication_time = now;
+      for( const auto& f : o.feeds )
+      {
+         if( (now - f.second.first).to_seconds() < o.options.feed_lifetime_sec && f.second.first != time_point_sec() )
+         {
+            current_feeds.push_back( f.second.second );
+            publication_time = std::min( publication_time, f.second.first );
+         }
+      }
+      price_feed median_feed;
+      if( current_feeds.empty() )
+      {
+         publication_time = now;
+         return median_feed;
+      }
+      const auto median_itr = current_feeds.begin() + current_feeds.size() / 2;
+#define CALCULATE_MEDIAN_VALUE(r, data, field_name) \
+      std::nth_element( current_feeds.begin(), median_itr, current_feeds.end(), \
+                        [](const price_feed& a, const price_feed& b) { \
+         return a.field_name < b.field_name; \
+      }); \
+      median_feed.field_name = median_itr->field_name;
+      BOOST_PP_SEQ_FOR_EACH( CALCULATE_MEDIAN_VALUE, ~, GRAPHENE_PRICE_FEED_FIELDS )
+#undef CALCULATE_MEDIAN_VALUE
+      return median_feed;
+   };
+   auto same_price = []( const price& a, const price& b )
+   {
+      return a.base == b.base && a.quote == b.quote;
+   };
+
+   for( int i = 0; i < 3000; ++i )
+   {
+      now += step_uid(gen);
+      price_feed feed;
+      // equivalent prices with different amounts are selected the same way as without the tracker
+      const int64_t factor = ( i % 4 == 0 ? amt_uid(gen) : 1 );
+      feed.settlement_price = price( asset( amt_uid(gen) * factor, asset_id_type(1) ),
+                                     asset( amt_uid(gen) * factor ) );
+      if( i % 97 == 0 )
+         feed.settlement_price = price();
+      feed.core_exchange_rate = price( asset( amt_uid(gen), asset_id_type(1) ), asset( amt_uid(gen) ) );
+      feed.maintenance_collateral_ratio = ratio_uid(gen);
+      feed.maximum_short_squeeze_ratio = ratio_uid(gen);
+      const account_id_type publisher( publisher_uid(gen) );
+      auto itr = o.feeds.find( publisher );
+      if( i % 3 == 0 && itr != o.feeds.end() ) // republished unchanged
+         feed = itr->second.second;
+      o.set_feed( publisher, now - step_uid(gen), feed );
+      if( i % 500 == 0 ) // changed without set_feed, e.g. by an evaluator
+         o.feeds[publisher].second.maintenance_collateral_ratio = ratio_uid(gen);
+      if( i % 400 == 0 )
+      {
+         // a copy that changes the shared tracker leaves it to the copy, the original rebuilds its own
+         asset_bitasset_data_object copy = o;
+         copy.set_feed( publisher, now, price_feed() );
+         copy.update_median_feeds( now, now );
+         BOOST_CHECK( o.median_feeds() == nullptr );
+      }
+      if( i % 700 == 0 )
+         o.options.feed_lifetime_sec += 10;
+      if( i % 300 == 0 )
+         o.options.minimum_feeds = ( o.options.minimum_feeds == 1 ? 10 : 1 );
+
+      o.update_median_feeds( now, now );
+      BOOST_REQUIRE( o.median_feeds() != nullptr );
+      if( o.median_feeds()->size() >= o.options.minimum_feeds )
+      {
+         // the median is kept when a feed is republished unchanged
+         o.set_feed( publisher, now, o.feeds[publisher].second );
+         BOOST_CHECK( o.median_feeds()->is_median_current() );
+         o.update_median_feeds( now, now );
+      }
+
+      time_point_sec expected_time;
+      const price_feed expected = expected_median( expected_time );
+      BOOST_CHECK( same_price( o.current_feed.settlement_price, expected.settlement_price ) );
+      BOOST_CHECK( same_price( o.current_feed.core_exchange_rate, expected.core_exchange_rate ) );
+      BOOST_CHECK_EQUAL( o.current_feed.maintenance_collateral_ratio, expected.maintenance_collateral_ratio );
+      BOOST_CHECK_EQUAL( o.current_feed.maximum_short_squeeze_ratio, expected.maximum_short_squeeze_ratio );
+      BOOST_CHECK( o.current_feed_publication_time == expected_time );
+   }
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
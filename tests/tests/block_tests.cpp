@@ -32,6 +32,7 @@
 #include <graphene/chain/committee_member_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/market_object.hpp>
+#include <graphene/chain/transaction_history_object.hpp>
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 #include <graphene/chain/witness_object.hpp>
@@ -40,6 +41,14 @@
 
 #include <fc/crypto/digest.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/endian/buffers.hpp>
+
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
 
 #include "../common/database_fixture.hpp"
 
@@ -133,6 +142,420 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_segments )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path dbdir = data_dir.path() / "blocks";
+      const fc::path segments = dbdir / "segments";
+
+      std::vector<clearable_block> blocks;
+      clearable_block b;
+      for( uint32_t i = 0; i < 50; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         blocks.push_back( b );
+      }
+
+      {
+         // 4 blocks per segment, sealed when the head is 5 blocks past the end of a segment
+         block_database bdb( 4, 5 );
+         bdb.open( dbdir );
+         for( const auto& blk : blocks )
+         {
+            bdb.store( blk.id(), blk );
+            BOOST_REQUIRE( bdb.fetch_by_number( blk.block_num() ).valid() );
+         }
+         bdb.wait_for_sealing();
+         for( const auto& blk : blocks )
+         {
+            auto fetched = bdb.fetch_by_number( blk.block_num() );
+            BOOST_REQUIRE( fetched.valid() );
+            BOOST_CHECK( fetched->id() == blk.id() );
+         }
+         bdb.close();
+      }
+      // segment 0 holds blocks 1-3 and is sealed, the segment holding the head is not
+      BOOST_CHECK( fc::exists( segments / "0.seg" ) );
+      BOOST_CHECK( !fc::exists( segments / "0.raw" ) );
+      BOOST_CHECK( fc::exists( segments / "12.raw" ) );
+
+      {
+         // an existing block log keeps its layout
+         block_database bdb;
+         bdb.open( dbdir );
+         for( const auto& blk : blocks )
+         {
+            BOOST_CHECK( bdb.contains( blk.id() ) );
+            auto fetched = bdb.fetch_optional( blk.id() );
+            BOOST_REQUIRE( fetched.valid() );
+            BOOST_CHECK( fetched->witness == blk.witness );
+         }
+         BOOST_CHECK( bdb.last_id().valid() && *bdb.last_id() == blocks.back().id() );
+
+         // storing into a sealed segment decompresses it
+         bdb.remove( blocks[1].id() );
+         BOOST_CHECK( !bdb.fetch_optional( blocks[1].id() ).valid() );
+         bdb.store( blocks[1].id(), blocks[1] );
+         BOOST_CHECK( bdb.fetch_optional( blocks[1].id() ).valid() );
+         BOOST_CHECK( bdb.fetch_optional( blocks[2].id() ).valid() );
+         bdb.close();
+      }
+      BOOST_CHECK( fc::exists( segments / "0.raw" ) );
+      BOOST_CHECK( !fc::exists( segments / "0.seg" ) );
+
+      {
+         // the segment is sealed again once blocks are written to another segment
+         block_database bdb( 4, 5 );
+         bdb.open( dbdir );
+         bdb.store( blocks.back().id(), blocks.back() );
+         bdb.wait_for_sealing();
+         BOOST_CHECK( bdb.fetch_optional( blocks[1].id() ).valid() );
+         bdb.close();
+      }
+      BOOST_CHECK( fc::exists( segments / "0.seg" ) );
+      BOOST_CHECK( !fc::exists( segments / "0.raw" ) );
+
+      {
+         // a frame table that does not match the size of the segment is rejected
+         std::fstream seg( ( segments / "0.seg" ).generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         const boost::endian::little_uint32_buf_t frame_raw_size( 1 );
+         seg.seekp( 32 ); // raw_size of the first frame entry, after the 24 byte header and the frame position
+         seg.write( (const char*)&frame_raw_size, sizeof(frame_raw_size) );
+      }
+      {
+         block_database bdb( 4, 5 );
+         GRAPHENE_REQUIRE_THROW( bdb.open( dbdir ), fc::exception );
+      }
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_legacy_conversion )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path dbdir = data_dir.path() / "blocks";
+      fc::create_directories( dbdir );
+
+      // write a block log in the former single-file layout
+      std::vector<clearable_block> blocks;
+      {
+         std::ofstream index( ( dbdir / "index" ).generic_string(), std::ios::binary );
+         std::ofstream data( ( dbdir / "blocks" ).generic_string(), std::ios::binary );
+         const std::vector<char> empty_entry( 32, 0 );
+         index.write( empty_entry.data(), empty_entry.size() ); // block 0 does not exist
+         clearable_block b;
+         uint64_t pos = 0;
+         for( uint32_t i = 0; i < 30; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.clear();
+            blocks.push_back( b );
+            const auto packed = fc::raw::pack( static_cast<const signed_block&>( b ) );
+            data.write( packed.data(), packed.size() );
+            boost::endian::little_uint64_buf_t block_pos( pos );
+            boost::endian::little_uint32_buf_t block_size( packed.size() );
+            const block_id_type id = b.id();
+            index.write( (const char*)&block_pos, sizeof(block_pos) );
+            index.write( (const char*)&block_size, sizeof(block_size) );
+            index.write( id.data(), id.data_size() );
+            pos += packed.size();
+         }
+      }
+
+      block_database bdb( 8, 4 );
+      bdb.open( dbdir );
+      BOOST_CHECK( !fc::exists( dbdir / "blocks" ) );
+      BOOST_CHECK( fc::exists( dbdir / "segments" / "0.seg" ) );
+      BOOST_CHECK( fc::exists( dbdir / "segments" / "3.raw" ) );
+      for( const auto& blk : blocks )
+      {
+         BOOST_CHECK( bdb.fetch_block_id( blk.block_num() ) == blk.id() );
+         auto fetched = bdb.fetch_by_number( blk.block_num() );
+         BOOST_REQUIRE( fetched.valid() );
+         BOOST_CHECK( fetched->id() == blk.id() );
+      }
+      BOOST_CHECK( bdb.last()->id() == blocks.back().id() );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_cache )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      bdb.set_cache_size( 3 );
+
+      std::vector<clearable_block> blocks;
+      clearable_block b;
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         blocks.push_back( b );
+         bdb.store( b.id(), b );
+      }
+
+      // only the 3 most recently stored blocks are cached
+      block_cache_stats stats = bdb.get_cache_stats();
+      BOOST_CHECK_EQUAL( stats.size, 3u );
+      BOOST_CHECK_EQUAL( stats.capacity, 3u );
+      BOOST_CHECK( bdb.fetch_by_number( 5 )->id() == blocks[4].id() );
+      BOOST_CHECK( bdb.fetch_optional( blocks[3].id() )->id() == blocks[3].id() );
+      stats = bdb.get_cache_stats();
+      BOOST_CHECK_EQUAL( stats.hits, 2u );
+      BOOST_CHECK_EQUAL( stats.misses, 0u );
+
+      // a miss is read from disk and evicts the least recently used block
+      BOOST_CHECK( bdb.fetch_by_number( 1 )->id() == blocks[0].id() );
+      stats = bdb.get_cache_stats();
+      BOOST_CHECK_EQUAL( stats.misses, 1u );
+      BOOST_CHECK_EQUAL( stats.size, 3u );
+      BOOST_CHECK( bdb.fetch_by_number( 1 )->id() == blocks[0].id() );
+      BOOST_CHECK( bdb.fetch_by_number( 3 )->id() == blocks[2].id() );
+      stats = bdb.get_cache_stats();
+      BOOST_CHECK_EQUAL( stats.hits, 3u );
+      BOOST_CHECK_EQUAL( stats.misses, 2u );
+
+      // removed and evicted blocks are not served from the cache
+      bdb.remove( blocks[4].id() );
+      BOOST_CHECK( !bdb.fetch_by_number( 5 ).valid() );
+      bdb.evict( blocks[0].id() );
+      BOOST_CHECK( bdb.fetch_optional( blocks[0].id() ).valid() );
+      stats = bdb.get_cache_stats();
+      BOOST_CHECK_EQUAL( stats.misses, 4u );
+
+      // hits share the cached block instead of copying it
+      const block_cache::block_ptr shared = bdb.fetch_shared( blocks[0].id() );
+      BOOST_REQUIRE( shared );
+      BOOST_CHECK( bdb.fetch_shared_by_number( 1 ) == shared );
+      BOOST_CHECK_EQUAL( bdb.get_cache_stats().hits, stats.hits + 2 );
+
+      bdb.set_cache_size( 0 );
+      BOOST_CHECK_EQUAL( bdb.get_cache_stats().size, 0u );
+      BOOST_CHECK( bdb.fetch_by_number( 2 )->id() == blocks[1].id() );
+      BOOST_CHECK_EQUAL( bdb.get_cache_stats().size, 0u );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_pruning )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path segments = data_dir.path() / "segments";
+
+      std::vector<clearable_block> blocks;
+      clearable_block b;
+      for( uint32_t i = 0; i < 30; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         blocks.push_back( b );
+      }
+
+      {
+         block_database bdb( 4, 5 );
+         bdb.open( data_dir.path() );
+         for( const auto& blk : blocks )
+            bdb.store( blk.id(), blk );
+         BOOST_CHECK_EQUAL( bdb.first_retained_block_num(), 1u );
+
+         // segments 0-2 hold blocks 1-11 only
+         bdb.wait_for_sealing();
+         bdb.prune( 13 );
+         bdb.close();
+      }
+      BOOST_CHECK( !fc::exists( segments / "0.seg" ) && !fc::exists( segments / "0.raw" ) );
+      BOOST_CHECK( !fc::exists( segments / "2.seg" ) && !fc::exists( segments / "2.raw" ) );
+      BOOST_CHECK( fc::exists( segments / "3.seg" ) || fc::exists( segments / "3.raw" ) );
+
+      block_database bdb( 4, 5 );
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( bdb.first_retained_block_num(), 12u );
+      for( const auto& blk : blocks )
+      {
+         // IDs of pruned blocks are still known
+         BOOST_CHECK( bdb.fetch_block_id( blk.block_num() ) == blk.id() );
+         BOOST_CHECK_EQUAL( bdb.contains( blk.id() ), blk.block_num() >= 12 );
+         BOOST_CHECK_EQUAL( bdb.fetch_by_number( blk.block_num() ).valid(), blk.block_num() >= 12 );
+         BOOST_CHECK_EQUAL( bdb.fetch_optional( blk.id() ).valid(), blk.block_num() >= 12 );
+      }
+
+      // the segment that is written to is never dropped
+      bdb.prune( 100 );
+      BOOST_CHECK_EQUAL( bdb.first_retained_block_num(), 28u );
+      BOOST_CHECK( bdb.last()->id() == blocks.back().id() );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( pruned_blocks_are_not_known )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      {
+         // the database keeps the layout of an existing block log, use small segments so that some are dropped
+         block_database bdb( 4, 5 );
+         bdb.open( data_dir.path() / "database" / "block_num_to_block" );
+         bdb.close();
+      }
+
+      database db;
+      db.open( data_dir.path(), []{
+         genesis_state_type genesis = make_genesis();
+         // blocks within the transaction expiration time are always kept
+         genesis.initial_parameters.maximum_time_until_expiration = 30;
+         return genesis;
+      }, "TEST" );
+      db.set_block_log_pruning( 10, 0 );
+      for( uint32_t i = 0; i < 100; ++i )
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                            database::skip_nothing );
+
+      const uint32_t first_retained = db.first_retained_block_num();
+      BOOST_REQUIRE_GT( first_retained, 1u );
+      for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+      {
+         // only blocks that can be served are advertised as known, pruned ones may still be in the fork database
+         const block_id_type id = db.get_block_id_for_num( num );
+         BOOST_CHECK_EQUAL( db.is_known_block( id ), db.fetch_block_by_number( num ).valid() );
+         if( num >= first_retained )
+            BOOST_CHECK( db.is_known_block( id ) );
+      }
+      BOOST_CHECK( !db.is_known_block( db.get_block_id_for_num( 1 ) ) );
+      BOOST_CHECK( !db.fetch_block_by_number( 1 ).valid() );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_concurrent_reads )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      const uint32_t num_blocks = 200;
+      std::vector<block_id_type> ids;
+      clearable_block b;
+      for( uint32_t i = 0; i < num_blocks; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+         // reads must see a block as soon as it is stored, i.e. the mappings have to grow
+         BOOST_REQUIRE( bdb.fetch_by_number( b.block_num() ).valid() );
+      }
+
+      std::atomic<uint32_t> failures{0};
+      std::vector<std::thread> readers;
+      for( uint32_t t = 0; t < 4; ++t )
+         readers.emplace_back( [&bdb,&ids,&failures,t,num_blocks]() {
+            for( uint32_t i = 0; i < num_blocks; ++i )
+            {
+               const uint32_t num = ( ( i + t * 37 ) % num_blocks ) + 1;
+               auto blk = bdb.fetch_by_number( num );
+               if( !blk.valid() || blk->witness != witness_id_type(num) || !bdb.contains( ids[num-1] )
+                     || !bdb.fetch_optional( ids[num-1] ).valid() )
+                  ++failures;
+            }
+         } );
+      for( auto& reader : readers )
+         reader.join();
+      BOOST_CHECK_EQUAL( failures.load(), 0u );
+
+      bdb.remove( ids.back() );
+      BOOST_CHECK( !bdb.contains( ids.back() ) );
+      BOOST_CHECK( !bdb.fetch_optional( ids.back() ).valid() );
+      BOOST_CHECK( bdb.contains( ids.front() ) );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_replay_pipeline_order )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb( 64, 64 );
+      bdb.open( data_dir.path() );
+
+      const uint32_t num_blocks = 300;
+      std::vector<block_id_type> ids;
+      clearable_block b;
+      for( uint32_t i = 0; i < num_blocks; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      bdb.wait_for_sealing();
+
+      // blocks come out in order whatever the queue depth and number of decode threads
+      for( uint32_t depth : { 1u, 7u, 1024u } )
+      {
+         std::atomic<uint32_t> precomputed{0};
+         block_replay_pipeline pipeline( bdb, 1, num_blocks, depth, 3,
+                                         [&precomputed]( const signed_block& ) { ++precomputed; } );
+         for( uint32_t num = 1; num <= num_blocks; ++num )
+         {
+            const optional<signed_block> blk = pipeline.next();
+            BOOST_REQUIRE( blk.valid() );
+            BOOST_CHECK( blk->id() == ids[num-1] );
+         }
+         BOOST_CHECK_EQUAL( precomputed.load(), num_blocks );
+         BOOST_CHECK_EQUAL( pipeline.read_stats().blocks, num_blocks );
+         BOOST_CHECK_EQUAL( pipeline.decode_stats().blocks, num_blocks );
+      }
+
+      // the pipeline ends at a missing block
+      bdb.remove( ids[199] );
+      block_replay_pipeline pipeline( bdb, 150, num_blocks, 16, 2, []( const signed_block& ) {} );
+      for( uint32_t num = 150; num < 200; ++num )
+         BOOST_REQUIRE( pipeline.next().valid() );
+      BOOST_CHECK( !pipeline.next().valid() );
+      BOOST_CHECK( !pipeline.next().valid() );
+      BOOST_CHECK_LE( pipeline.read_stats().blocks, 51u );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -733,6 +1156,333 @@ BOOST_AUTO_TEST_CASE( duplicate_transactions )
    }
 }
 
+/// Digest of all objects of a database, to compare the states of databases
+static fc::sha256 state_digest( const database& db )
+{
+   fc::sha256::encoder enc;
+   for( uint8_t space : { uint8_t(protocol_ids), uint8_t(implementation_ids) } )
+      for( uint32_t type = 0; type <= 0xff; ++type )
+      {
+         const graphene::db::index* idx = nullptr;
+         try {
+            idx = &db.get_index( space, uint8_t(type) );
+         } catch( const fc::exception& ) {
+            continue;
+         }
+         idx->inspect_all_objects( [&enc]( const graphene::db::object& obj ) {
+            const auto data = obj.pack();
+            enc.write( data.data(), data.size() );
+         } );
+      }
+   return enc.result();
+}
+
+BOOST_AUTO_TEST_CASE( trusted_replay )
+{
+   try {
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      const auto skip_sigs = database::skip_transaction_signatures;
+
+      signed_transaction trx;
+      uint32_t checkpoint_num;
+      block_id_type checkpoint_id;
+      block_id_type wrong_id;
+      uint32_t head_num;
+      {
+         database db;
+         db.open( dir.path(), make_genesis, "TEST" );
+         for( int i = 0; i < 3; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, skip_sigs );
+
+         set_expiration( db, trx );
+         transfer_operation t;
+         t.to = account_id_type(1);
+         t.amount = asset(500);
+         trx.operations.push_back(t);
+         PUSH_TX( db, trx, skip_sigs );
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, skip_sigs );
+         checkpoint_num = db.head_block_num();
+         checkpoint_id = db.head_block_id();
+         wrong_id = db.get_block_id_for_num( 2 );
+
+         // blocks after the checkpoint are replayed with all checks
+         for( int i = 0; i < 2; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, skip_sigs );
+         head_num = db.head_block_num();
+         db.close();
+      }
+      fc::sha256 replayed_digest;
+      {
+         database db;
+         // a different version wipes the object database and replays the block log
+         db.open( dir.path(), make_genesis, "REPLAYED" );
+         BOOST_CHECK_EQUAL( db.head_block_num(), head_num );
+         replayed_digest = state_digest( db );
+         db.close();
+      }
+      {
+         database db;
+         db.add_checkpoints( { { checkpoint_num, checkpoint_id } } );
+         db.set_trusted_replay( true );
+         db.open( dir.path(), make_genesis, "TRUSTED" );
+         BOOST_CHECK_EQUAL( db.head_block_num(), head_num );
+         BOOST_CHECK_EQUAL( db.get_balance( account_id_type(1), asset_id_type() ).amount.value, 500 );
+         // the trusted replay results in the same state as a replay with all checks
+         BOOST_CHECK( state_digest( db ) == replayed_digest );
+         // the transaction has not expired, so it is still known although duplicate checks were skipped
+         BOOST_CHECK( db.is_known_transaction( trx.id() ) );
+         GRAPHENE_CHECK_THROW( PUSH_TX( db, trx, skip_sigs ), fc::exception );
+         db.close();
+      }
+      {
+         database db;
+         db.add_checkpoints( { { checkpoint_num, wrong_id } } );
+         db.set_trusted_replay( true );
+         GRAPHENE_CHECK_THROW( db.open( dir.path(), make_genesis, "MISMATCH" ), fc::exception );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( parallel_transaction_checks )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1.open(dir1.path(), make_genesis, "TEST");
+      db2.open(dir2.path(), make_genesis, "TEST");
+      db2.enable_parallel_transaction_checks( true );
+
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto generate_block = [&]( uint32_t skip ) {
+         return db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, skip );
+      };
+
+      // accounts with keys of their own, the last one is controlled by the first one
+      const uint32_t account_count = 8;
+      std::vector<fc::ecc::private_key> keys;
+      std::vector<account_id_type> ids;
+      {
+         signed_transaction trx;
+         set_expiration( db1, trx );
+         for( uint32_t i = 0; i < account_count; ++i )
+         {
+            keys.push_back( fc::ecc::private_key::regenerate( fc::sha256::hash( "parallel" + fc::to_string(i) ) ) );
+            ids.push_back( account_id_type( db1.get_index_type<account_index>().get_next_id().instance() + i ) );
+            account_create_operation cop;
+            cop.registrar = GRAPHENE_TEMP_ACCOUNT;
+            cop.name = "parallel" + fc::to_string(i);
+            cop.owner = authority( 1, public_key_type( keys.back().get_public_key() ), 1 );
+            cop.active = ( i + 1 < account_count ) ? cop.owner : authority( 1, ids[0], 1 );
+            cop.options.memo_key = keys.back().get_public_key();
+            trx.operations.push_back( cop );
+         }
+         PUSH_TX( db1, trx );
+
+         trx.clear();
+         set_expiration( db1, trx );
+         for( const account_id_type id : ids )
+         {
+            transfer_operation t;
+            t.to = id;
+            t.amount = asset( 1000000 );
+            trx.operations.push_back( t );
+         }
+         // the committee account can only be used in proposals, its transfers are pushed without checking them
+         trx.sign( init_account_priv_key, db1.get_chain_id() );
+         PUSH_TX( db1, trx, database::skip_transaction_signatures );
+         PUSH_BLOCK( db2, generate_block( database::skip_transaction_signatures ),
+                     database::skip_transaction_signatures );
+      }
+      BOOST_CHECK( state_digest( db1 ) == state_digest( db2 ) );
+
+      // blocks mixing transfers between disjoint and overlapping pairs of accounts
+      for( uint32_t round = 0; round < 3; ++round )
+      {
+         for( uint32_t i = 0; i + 1 < account_count; ++i )
+         {
+            const uint32_t from = ( i * ( round + 1 ) ) % ( account_count - 1 );
+            const uint32_t to = ( from + 1 + round ) % ( account_count - 1 );
+            signed_transaction trx;
+            set_expiration( db1, trx );
+            transfer_operation t;
+            t.from = ids[from];
+            t.to = ids[to];
+            t.amount = asset( 1 + i + 10 * round );
+            trx.operations.push_back( t );
+            trx.sign( keys[from], db1.get_chain_id() );
+            PUSH_TX( db1, trx );
+         }
+         PUSH_BLOCK( db2, generate_block( database::skip_nothing ) );
+         BOOST_CHECK( state_digest( db1 ) == state_digest( db2 ) );
+      }
+      BOOST_CHECK( db1.head_block_id() == db2.head_block_id() );
+
+      // A transaction that is only authorized by a key that an earlier transaction of the block has replaced must
+      // be rejected, although the two transactions impact different accounts
+      {
+         const auto new_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string("parallel_new") ) );
+         signed_transaction update;
+         set_expiration( db1, update );
+         account_update_operation uop;
+         uop.account = ids[0];
+         uop.active = authority( 1, public_key_type( new_key.get_public_key() ), 1 );
+         update.operations.push_back( uop );
+         update.sign( keys[0], db1.get_chain_id() );
+         PUSH_TX( db1, update );
+
+         signed_transaction spend;
+         set_expiration( db1, spend );
+         transfer_operation t;
+         t.from = ids[account_count - 1];
+         t.to = ids[1];
+         t.amount = asset( 5 );
+         spend.operations.push_back( t );
+         spend.sign( keys[0], db1.get_chain_id() );
+         PUSH_TX( db1, spend, database::skip_transaction_signatures );
+
+         const signed_block bad = generate_block( database::skip_transaction_signatures );
+         BOOST_REQUIRE_EQUAL( bad.transactions.size(), 2u );
+         const block_id_type head = db2.head_block_id();
+         GRAPHENE_REQUIRE_THROW( PUSH_BLOCK( db2, bad ), fc::exception );
+         BOOST_CHECK( db2.head_block_id() == head );
+      }
+
+      // replaying the chain gives the same state with the checks done serially and in parallel
+      const block_id_type head = db2.head_block_id();
+      db2.close();
+      std::vector<fc::sha256> replayed_digests;
+      for( const bool parallel : { false, true } )
+      {
+         database replayed;
+         replayed.enable_parallel_transaction_checks( parallel );
+         replayed.wipe( dir2.path(), false );
+         replayed.open( dir2.path(), make_genesis, "TEST" );
+         BOOST_CHECK( replayed.head_block_id() == head );
+         replayed_digests.push_back( state_digest( replayed ) );
+         replayed.close();
+      }
+      BOOST_CHECK( replayed_digests[0] == replayed_digests[1] );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( deferred_pending_transactions )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1.open(dir1.path(), make_genesis, "TEST");
+      db2.open(dir2.path(), make_genesis, "TEST");
+
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto generate_block = [&]( uint32_t skip ) {
+         return db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, skip );
+      };
+      const auto skip_sigs = database::skip_transaction_signatures;
+
+      const auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( string("deferred") ) );
+      const account_id_type sender( db1.get_index_type<account_index>().get_next_id() );
+      {
+         signed_transaction trx;
+         set_expiration( db1, trx );
+         account_create_operation cop;
+         cop.registrar = GRAPHENE_TEMP_ACCOUNT;
+         cop.name = "deferred";
+         cop.owner = authority( 1, public_key_type( key.get_public_key() ), 1 );
+         cop.active = cop.owner;
+         cop.options.memo_key = key.get_public_key();
+         trx.operations.push_back( cop );
+         transfer_operation t;
+         t.to = sender;
+         t.amount = asset( 1000000 );
+         trx.operations.push_back( t );
+         PUSH_TX( db1, trx, skip_sigs );
+         PUSH_BLOCK( db2, generate_block( skip_sigs ), skip_sigs );
+      }
+
+      std::vector<signed_transaction> transfers;
+      for( int64_t i = 0; i < 5; ++i )
+      {
+         signed_transaction trx;
+         set_expiration( db2, trx );
+         transfer_operation t;
+         t.from = sender;
+         t.to = account_id_type();
+         t.amount = asset( 1 + i );
+         trx.operations.push_back( t );
+         trx.sign( key, db2.get_chain_id() );
+         PUSH_TX( db2, trx );
+         transfers.push_back( trx );
+      }
+      BOOST_CHECK_EQUAL( db2.get_mempool_stats().transactions, 5u );
+
+      // the first transfer is included in the next block, two of the others are applied again right away
+      PUSH_TX( db1, transfers[0] );
+      db2.set_pending_reapply_limit( 2 );
+      PUSH_BLOCK( db2, generate_block( database::skip_nothing ) );
+      mempool_stats stats = db2.get_mempool_stats();
+      BOOST_CHECK_EQUAL( stats.transactions, 2u );
+      BOOST_CHECK_EQUAL( stats.deferred, 2u );
+      BOOST_CHECK( !db2._pending_tx.contains( transfers[0].id() ) );
+      BOOST_CHECK( db2._pending_tx.contains( transfers[1].id() ) );
+      BOOST_CHECK( db2._pending_tx.contains( transfers[2].id() ) );
+
+      BOOST_CHECK_EQUAL( db2.reapply_deferred_transactions( 1 ), 1u );
+      BOOST_CHECK( db2._pending_tx.contains( transfers[3].id() ) );
+
+      // a new transaction of another fee payer does not wait for the deferred ones
+      {
+         signed_transaction other;
+         set_expiration( db2, other );
+         transfer_operation ot;
+         ot.to = sender;
+         ot.amount = asset( 1 );
+         other.operations.push_back( ot );
+         PUSH_TX( db2, other, skip_sigs );
+      }
+      BOOST_CHECK_EQUAL( db2.get_mempool_stats().deferred, 1u );
+
+      // a new transaction is applied after the deferred ones of its fee payer
+      signed_transaction trx;
+      set_expiration( db2, trx );
+      transfer_operation t;
+      t.from = sender;
+      t.to = account_id_type();
+      t.amount = asset( 100 );
+      trx.operations.push_back( t );
+      trx.sign( key, db2.get_chain_id() );
+      PUSH_TX( db2, trx );
+      stats = db2.get_mempool_stats();
+      BOOST_CHECK_EQUAL( stats.transactions, 6u );
+      BOOST_CHECK_EQUAL( stats.deferred, 0u );
+      const auto& in_arrival_order = db2._pending_tx.entries().get<mempool::by_arrival>();
+      BOOST_CHECK( in_arrival_order.rbegin()->id == trx.id() );
+      BOOST_CHECK( std::prev( in_arrival_order.end(), 2 )->id == transfers[4].id() );
+
+      // a block produced meanwhile contains only the transactions that have been applied again
+      PUSH_BLOCK( db2, generate_block( database::skip_nothing ) );
+      BOOST_CHECK_EQUAL( db2.get_mempool_stats().transactions, 2u );
+      BOOST_CHECK_EQUAL( db2.get_mempool_stats().deferred, 4u );
+      const signed_block produced = db2.generate_block( db2.get_slot_time(1), db2.get_scheduled_witness(1),
+                                                        init_account_priv_key, database::skip_nothing );
+      BOOST_CHECK_EQUAL( produced.transactions.size(), 2u );
+      BOOST_CHECK_EQUAL( db2.get_mempool_stats().deferred, 2u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( tapos )
 {
    try {
@@ -1940,4 +2690,388 @@ BOOST_FIXTURE_TEST_CASE( block_size_test, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( mempool_limits, database_fixture )
+{ try {
+   ACTORS( (alice)(bob)(carol)(dan) );
+   fund( alice );
+   fund( bob );
+   fund( carol );
+   fund( dan );
+   generate_block();
+
+   auto make_transfer = [this]( account_id_type from, const fc::ecc::private_key& key, int64_t extra_fee ) {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      transfer_operation op;
+      op.from = from;
+      op.to = account_id_type();
+      op.amount = asset( 1000 );
+      tx.operations.push_back( op );
+      for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+      tx.operations.back().get<transfer_operation>().fee.amount += extra_fee;
+      tx.sign( key, db.get_chain_id() );
+      return tx;
+   };
+
+   // per account limit
+   db.set_mempool_limits( 0, 2 );
+   PUSH_TX( db, make_transfer( alice_id, alice_private_key, 1 ) );
+   PUSH_TX( db, make_transfer( alice_id, alice_private_key, 2 ) );
+   GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( alice_id, alice_private_key, 3 ) ), fc::exception );
+   PUSH_TX( db, make_transfer( bob_id, bob_private_key, 3 ) );
+   BOOST_CHECK_EQUAL( db.get_mempool_stats().transactions, 3u );
+   BOOST_CHECK_EQUAL( db.get_mempool_stats().rejected, 1u );
+   db.clear_pending();
+
+   // size limit, the cheapest transaction is evicted in favor of one paying more
+   const signed_transaction low = make_transfer( alice_id, alice_private_key, 1 );
+   const signed_transaction mid = make_transfer( bob_id, bob_private_key, 2 );
+   const signed_transaction high = make_transfer( carol_id, carol_private_key, 100 );
+   const uint64_t trx_size = fc::raw::pack_size( low );
+   db.set_mempool_limits( trx_size * 2 + trx_size / 2, 0 );
+   const int64_t alice_balance = get_balance( alice_id, asset_id_type() );
+
+   PUSH_TX( db, low );
+   PUSH_TX( db, mid );
+   BOOST_CHECK_LT( get_balance( alice_id, asset_id_type() ), alice_balance );
+   PUSH_TX( db, high );
+   mempool_stats stats = db.get_mempool_stats();
+   BOOST_CHECK_EQUAL( stats.transactions, 2u );
+   BOOST_CHECK_EQUAL( stats.evicted, 1u );
+   BOOST_CHECK( !db._pending_tx.contains( low.id() ) );
+   BOOST_CHECK( db._pending_tx.contains( mid.id() ) );
+   BOOST_CHECK( db._pending_tx.contains( high.id() ) );
+   // the pending state no longer contains the effects of the evicted transaction
+   BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), alice_balance );
+
+   // a transaction paying less than all pending ones is not admitted
+   GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( dan_id, dan_private_key, 0 ) ), fc::exception );
+   BOOST_CHECK_EQUAL( db.get_mempool_stats().rejected, stats.rejected + 1 );
+
+   // a transaction that pays more but fails to apply evicts nothing
+   signed_transaction overdraft;
+   set_expiration( db, overdraft );
+   transfer_operation op;
+   op.from = dan_id;
+   op.to = account_id_type();
+   op.amount = asset( get_balance( dan_id, asset_id_type() ) + 1 );
+   overdraft.operations.push_back( op );
+   for( auto& o : overdraft.operations ) db.current_fee_schedule().set_fee( o );
+   overdraft.operations.back().get<transfer_operation>().fee.amount += 200;
+   overdraft.sign( dan_private_key, db.get_chain_id() );
+   GRAPHENE_REQUIRE_THROW( PUSH_TX( db, overdraft ), fc::exception );
+   BOOST_CHECK_EQUAL( db.get_mempool_stats().evicted, stats.evicted );
+   BOOST_CHECK( db._pending_tx.contains( mid.id() ) );
+
+   // pending transactions included in a block leave the pool
+   generate_block();
+   BOOST_CHECK_EQUAL( db.get_mempool_stats().transactions, 0u );
+   BOOST_CHECK( db.is_known_transaction( mid.id() ) );
+   BOOST_CHECK( db.is_known_transaction( high.id() ) );
+   BOOST_CHECK( !db.is_known_transaction( low.id() ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( generate_block_from_pending_state, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   fund( bob );
+   generate_block();
+
+   auto make_transfer = [this]( account_id_type from, account_id_type to, int64_t amount ) {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      transfer_operation op;
+      op.from = from;
+      op.to = to;
+      op.amount = asset( amount );
+      tx.operations.push_back( op );
+      for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+      return tx;
+   };
+
+   // the block consists of the pending transactions in the order of their arrival
+   std::vector<transaction_id_type> ids;
+   for( int64_t i = 1; i <= 3; ++i )
+   {
+      signed_transaction tx = make_transfer( alice_id, bob_id, i * 100 );
+      tx.sign( alice_private_key, db.get_chain_id() );
+      ids.push_back( PUSH_TX( db, tx ).id() );
+   }
+   const int64_t bob_balance = get_balance( bob_id, asset_id_type() );
+   signed_block b = generate_block();
+   BOOST_REQUIRE_EQUAL( b.transactions.size(), ids.size() );
+   for( size_t i = 0; i < ids.size(); ++i )
+   {
+      BOOST_CHECK( b.transactions[i].id() == ids[i] );
+      BOOST_CHECK( b.transactions[i].operation_results.empty() );
+   }
+   BOOST_CHECK( b.transaction_merkle_root == b.calculate_merkle_root() );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), bob_balance );
+   BOOST_CHECK_EQUAL( db.get_mempool_stats().transactions, 0u );
+
+   // a transaction applied with checks skipped that the block does not skip is checked again
+   signed_transaction signed_tx = make_transfer( bob_id, alice_id, 100 );
+   signed_tx.sign( bob_private_key, db.get_chain_id() );
+   PUSH_TX( db, signed_tx );
+   const signed_transaction unsigned_tx = make_transfer( alice_id, bob_id, 100 );
+   PUSH_TX( db, unsigned_tx, database::skip_transaction_signatures );
+   b = generate_block( database::skip_nothing, init_account_priv_key );
+   BOOST_REQUIRE_EQUAL( b.transactions.size(), 1u );
+   BOOST_CHECK( b.transactions[0].id() == signed_tx.id() );
+   BOOST_CHECK( !db.is_known_transaction( unsigned_tx.id() ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( recent_transaction_lookup, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   generate_block();
+
+   auto history = [this]( const transaction_id_type& id ) -> const transaction_history_object& {
+      const auto& idx = db.get_index_type<transaction_index>().indices().get<by_trx_id>();
+      auto itr = idx.find( id );
+      BOOST_REQUIRE( itr != idx.end() );
+      return *itr;
+   };
+
+   std::vector<signed_transaction> trxs;
+   for( int64_t i = 1; i <= 3; ++i )
+   {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      tx.set_expiration( db.head_block_time()
+                         + db.get_global_properties().parameters.maximum_time_until_expiration );
+      transfer_operation op;
+      op.from = alice_id;
+      op.to = bob_id;
+      op.amount = asset( i * 100 );
+      tx.operations.push_back( op );
+      for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+      tx.sign( alice_private_key, db.get_chain_id() );
+      PUSH_TX( db, tx );
+      trxs.push_back( tx );
+   }
+
+   // pending transactions are found in the pending pool
+   for( const auto& tx : trxs )
+   {
+      BOOST_CHECK_EQUAL( history( tx.id() ).block_num, 0u );
+      BOOST_CHECK( db.get_recent_transaction( tx.id() ).id() == tx.id() );
+   }
+
+   // included transactions refer to their position in the block
+   const signed_block b = generate_block( ~database::skip_transaction_dupe_check );
+   BOOST_REQUIRE_EQUAL( b.transactions.size(), trxs.size() );
+   for( size_t i = 0; i < trxs.size(); ++i )
+   {
+      const transaction_history_object& h = history( trxs[i].id() );
+      BOOST_CHECK_EQUAL( h.block_num, b.block_num() );
+      BOOST_CHECK_EQUAL( h.trx_in_block, i );
+      BOOST_CHECK( h.expiration == trxs[i].expiration );
+      const signed_transaction found = db.get_recent_transaction( trxs[i].id() );
+      BOOST_CHECK( found.id() == trxs[i].id() );
+      BOOST_CHECK( found.signatures == trxs[i].signatures );
+   }
+
+   generate_blocks( 10 );
+   BOOST_CHECK( db.get_recent_transaction( trxs[1].id() ).id() == trxs[1].id() );
+
+   // expired transactions are forgotten
+   generate_blocks( db.head_block_time() + db.get_global_properties().parameters.maximum_time_until_expiration );
+   BOOST_CHECK( !db.is_known_transaction( trxs[0].id() ) );
+   GRAPHENE_REQUIRE_THROW( db.get_recent_transaction( trxs[0].id() ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( block_traces, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   generate_blocks( 3 );
+
+   uint32_t handler_calls = 0;
+   boost::signals2::scoped_connection connection = db.applied_block.connect( db.traced_handler( "test_handler",
+         [&handler_calls]( const signed_block& ) { ++handler_calls; } ) );
+   db.set_block_trace_options( 3, 0 );
+   BOOST_CHECK_EQUAL( db.get_block_traces( 10 ).size(), 3u );
+
+   transfer( alice, bob, asset( 100 ) );
+   transfer( alice, bob, asset( 200 ) );
+   const signed_block b = generate_block();
+   BOOST_CHECK_EQUAL( handler_calls, 1u );
+
+   vector<block_trace> traces = db.get_block_traces( 10 );
+   BOOST_REQUIRE_EQUAL( traces.size(), 3u );
+   const block_trace& trace = traces.front();
+   BOOST_CHECK( trace.block_id == b.id() );
+   BOOST_CHECK_EQUAL( trace.block_num, b.block_num() );
+   BOOST_CHECK_EQUAL( trace.transactions, 2u );
+   BOOST_CHECK( !trace.maintenance );
+   BOOST_CHECK_GE( trace.push_us, trace.apply_us );
+   BOOST_CHECK_GE( trace.apply_us, trace.transactions_us );
+   BOOST_REQUIRE_EQUAL( trace.operations.size(), 1u );
+   BOOST_CHECK_EQUAL( trace.operations.front().type, operation( transfer_operation() ).which() );
+   BOOST_CHECK_EQUAL( trace.operations.front().count, 2u );
+   BOOST_CHECK( trace.handler_us.find( "test_handler" ) != trace.handler_us.end() );
+   BOOST_CHECK_GT( trace.undo_modified, 0u );
+
+   // the precomputation of a block is added to its trace, once all of its parts are done
+   db.pop_block();
+   const signed_block unverified = fc::raw::unpack<signed_block>( fc::raw::pack( b ) );
+   db.precompute_parallel( unverified ).wait();
+   PUSH_BLOCK( db, unverified );
+   BOOST_CHECK( db.get_block_traces( 1 ).front().block_id == b.id() );
+   BOOST_CHECK_GT( db.get_block_traces( 1 ).front().precompute_us, 0u );
+
+   // the most recent traces are kept, the most recent first
+   generate_blocks( 5 );
+   traces = db.get_block_traces( 2 );
+   BOOST_REQUIRE_EQUAL( traces.size(), 2u );
+   BOOST_CHECK_EQUAL( traces[0].block_num, db.head_block_num() );
+   BOOST_CHECK_EQUAL( traces[1].block_num, db.head_block_num() - 1 );
+   BOOST_CHECK( traces[0].operations.empty() );
+   BOOST_CHECK_EQUAL( db.get_block_traces( 10 ).size(), 3u );
+
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK( db.get_block_traces( 1 ).front().maintenance );
+
+   // tracing can be disabled
+   db.set_block_trace_options( 0, 0 );
+   BOOST_CHECK( db.get_block_traces( 10 ).empty() );
+   generate_block();
+   BOOST_CHECK( db.get_block_traces( 10 ).empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( mempool_selection )
+{
+   mempool pool;
+   std::vector<processed_transaction> trxs( 5 );
+   for( size_t i = 0; i < trxs.size(); ++i )
+   {
+      trxs[i].ref_block_num = i;
+      trxs[i].expiration = fc::time_point_sec( 1000 + i * 10 );
+   }
+   // fee rates 10, 50, 20, 50, 5, all 100 bytes
+   const uint64_t rates[] = { 10, 50, 20, 50, 5 };
+   for( size_t i = 0; i < trxs.size(); ++i )
+      pool.insert( trxs[i], account_id_type( i ), 100, rates[i] );
+
+   // everything fits, in the order of arrival
+   auto selected = pool.select( 500 );
+   BOOST_REQUIRE_EQUAL( selected.size(), 5u );
+   for( size_t i = 0; i < selected.size(); ++i )
+      BOOST_CHECK_EQUAL( selected[i]->ref_block_num, i );
+
+   // the three paying most, still in the order of arrival
+   selected = pool.select( 350 );
+   BOOST_REQUIRE_EQUAL( selected.size(), 3u );
+   BOOST_CHECK_EQUAL( selected[0]->ref_block_num, 1 );
+   BOOST_CHECK_EQUAL( selected[1]->ref_block_num, 2 );
+   BOOST_CHECK_EQUAL( selected[2]->ref_block_num, 3 );
+
+   BOOST_CHECK_EQUAL( pool.remove_expired( fc::time_point_sec( 1015 ) ), 2u );
+   BOOST_CHECK_EQUAL( pool.size(), 3u );
+   BOOST_CHECK( pool.remove( trxs[3].id() ) );
+   BOOST_CHECK( !pool.remove( trxs[3].id() ) );
+   BOOST_CHECK_EQUAL( pool.get_stats().bytes, 200u );
+   BOOST_CHECK_EQUAL( pool.get_stats().max_fee_per_kb, 20u );
+   BOOST_CHECK_EQUAL( pool.get_stats().min_fee_per_kb, 5u );
+
+   const auto released = pool.release();
+   BOOST_REQUIRE_EQUAL( released.size(), 2u );
+   BOOST_CHECK_EQUAL( released[0].ref_block_num, 2 );
+   BOOST_CHECK_EQUAL( released[1].ref_block_num, 4 );
+   BOOST_CHECK( pool.empty() );
+
+   // when full, a transaction paying more evicts the cheapest ones, and some room is freed for the next ones
+   pool.set_limits( 500, 0 );
+   for( size_t i = 0; i < trxs.size(); ++i )
+      pool.insert( trxs[i], account_id_type( i ), 100, rates[i] );
+   BOOST_CHECK_THROW( pool.check_admission( account_id_type( 5 ), 100, 5 ), fc::exception );
+   const auto evicted = pool.check_admission( account_id_type( 5 ), 100, 30 );
+   BOOST_REQUIRE_EQUAL( evicted.size(), 2u );
+   BOOST_CHECK_EQUAL( evicted[0], 5u ); // fee rate 10
+   BOOST_CHECK_EQUAL( evicted[1], 9u ); // fee rate 5
+   BOOST_CHECK_EQUAL( pool.size(), 5u );
+   BOOST_CHECK_EQUAL( pool.evict( evicted ), 2u );
+   BOOST_CHECK_EQUAL( pool.get_stats().min_fee_per_kb, 20u );
+   BOOST_CHECK_EQUAL( pool.get_stats().evicted, 2u );
+}
+
+BOOST_AUTO_TEST_CASE( expiration_scheduler_order )
+{
+   expiration_scheduler scheduler;
+   const uint32_t start = 1600000000;
+   const object_id_type order1( limit_order_id_type( 1 ) );
+   const object_id_type order2( limit_order_id_type( 2 ) );
+   const object_id_type order3( limit_order_id_type( 3 ) );
+   const object_id_type proposal( proposal_id_type( 1 ) );
+   scheduler.schedule( order2, fc::time_point_sec( start + 10 ) );
+   scheduler.schedule( order1, fc::time_point_sec( start + 10 ) );
+   scheduler.schedule( order3, fc::time_point_sec( start + 5 ) );
+   scheduler.schedule( proposal, fc::time_point_sec( start + 1 ) );
+   scheduler.schedule( object_id_type( limit_order_id_type( 4 ) ), fc::time_point_sec::maximum() );
+   BOOST_CHECK_EQUAL( scheduler.size(), 4u );
+
+   const uint16_t orders = limit_order_id_type::space_type;
+   BOOST_CHECK( !scheduler.next_due( orders, fc::time_point_sec( start + 4 ) ).valid() );
+   // objects of other types are due separately
+   BOOST_CHECK( *scheduler.next_due( proposal_id_type::space_type, fc::time_point_sec( start + 4 ) ) == proposal );
+   BOOST_CHECK( *scheduler.next_due( orders, fc::time_point_sec( start + 20 ) ) == order3 );
+   scheduler.cancel( order3 );
+   // equal deadlines are due in the order of the IDs
+   BOOST_CHECK( *scheduler.next_due( orders, fc::time_point_sec( start + 20 ) ) == order1 );
+   // a due object can be rescheduled, also when the time of the wheel is ahead
+   scheduler.schedule( order1, fc::time_point_sec( start + 15 ) );
+   BOOST_CHECK( *scheduler.next_due( orders, fc::time_point_sec( start + 12 ) ) == order2 );
+   scheduler.cancel( order2 );
+   BOOST_CHECK( !scheduler.next_due( orders, fc::time_point_sec( start + 12 ) ).valid() );
+   BOOST_CHECK( *scheduler.next_due( orders, fc::time_point_sec( start + 15 ) ) == order1 );
+
+   scheduler.clear();
+   BOOST_CHECK_EQUAL( scheduler.size(), 0u );
+
+   // compare with an ordered set over random deadlines near and far
+   std::mt19937 rng( 7 );
+   std::map<object_id_type, uint32_t> expected;
+   uint32_t now = start + 20;
+   for( uint32_t step = 0; step < 20000; ++step )
+   {
+      const uint32_t action = rng() % 10;
+      if( action < 4 )
+      {
+         const object_id_type id( limit_order_id_type( rng() % 1000 ) );
+         const uint32_t ranges[] = { 10, 5000, 10000000, 2000000000 };
+         const uint32_t deadline = now - 50 + rng() % ranges[ rng() % 4 ];
+         scheduler.schedule( id, fc::time_point_sec( deadline ) );
+         expected[id] = deadline;
+      }
+      else if( action < 6 )
+      {
+         const object_id_type id( limit_order_id_type( rng() % 1000 ) );
+         scheduler.cancel( id );
+         expected.erase( id );
+      }
+      else
+      {
+         now += rng() % ( action == 9 ? 100000 : 5 );
+         // queries may be behind the wheel, as after popping blocks
+         const uint32_t query = now - rng() % 3;
+         optional<object_id_type> first;
+         for( const auto& item : expected )
+            if( item.second <= query && ( !first.valid() || item.second < expected[*first] ) )
+               first = item.first;
+         const auto due = scheduler.next_due( orders, fc::time_point_sec( query ) );
+         BOOST_REQUIRE_EQUAL( due.valid(), first.valid() );
+         if( due.valid() )
+         {
+            BOOST_REQUIRE( *due == *first );
+            scheduler.cancel( *due );
+            expected.erase( *due );
+         }
+      }
+      BOOST_REQUIRE_EQUAL( scheduler.size(), expected.size() );
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
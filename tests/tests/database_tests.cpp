@@ -27,8 +27,11 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
@@ -138,6 +141,102 @@ BOOST_AUTO_TEST_CASE( merge_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( undo_arena_test )
+{ try {
+   graphene::db::undo_arena arena;
+   char* first = static_cast<char*>( arena.allocate( 3, 1 ) );
+   void* aligned = arena.allocate( sizeof(uint64_t), alignof(uint64_t) );
+   BOOST_CHECK_EQUAL( reinterpret_cast<uintptr_t>(aligned) % alignof(uint64_t), 0u );
+   BOOST_CHECK( static_cast<char*>(aligned) >= first + 3 );
+   BOOST_CHECK_EQUAL( arena.block_count(), 1u );
+   arena.allocate( graphene::db::undo_arena::block_size * 2, 1 );
+   BOOST_CHECK_EQUAL( arena.block_count(), 2u );
+   arena.release();
+   BOOST_CHECK_EQUAL( arena.block_count(), 1u );
+   BOOST_CHECK_EQUAL( arena.reserved_bytes(), graphene::db::undo_arena::block_size );
+   BOOST_CHECK( arena.allocate( 3, 1 ) == first );
+
+   // old values merged into the parent state must survive the release of the arena of the merged state
+   database db;
+   const account_balance_id_type bal_id = db.create<account_balance_object>( []( account_balance_object& obj ){
+      obj.balance = 1;
+   }).get_id();
+   {
+      auto outer = db._undo_db.start_undo_session();
+      for( int i = 0; i < 3; ++i )
+      {
+         auto inner = db._undo_db.start_undo_session();
+         db.modify( bal_id(db), [i]( account_balance_object& obj ){ obj.balance = 10 + i; } );
+         inner.merge();
+      }
+      auto inner = db._undo_db.start_undo_session();
+      db.modify( bal_id(db), []( account_balance_object& obj ){ obj.balance = 100; } );
+      db.remove( bal_id(db) );
+      inner.merge();
+      BOOST_CHECK( db.find( bal_id ) == nullptr );
+      outer.undo();
+   }
+   BOOST_CHECK_EQUAL( bal_id(db).balance.value, 1 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( dense_index_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   const auto& accounts = db.get_index_type<account_index>().indices();
+   const auto& by_name_idx = accounts.get<by_name>();
+
+   BOOST_REQUIRE( by_name_idx.find( "alice" ) != by_name_idx.end() );
+   BOOST_CHECK( by_name_idx.find( "alice" )->get_id() == alice_id );
+   BOOST_CHECK_EQUAL( by_name_idx.size(), accounts.size() );
+   BOOST_CHECK( db.find( alice_id ) == &alice_id(db) );
+
+   // iteration by ID is in ID order
+   account_id_type last;
+   size_t count = 0;
+   for( const account_object& acct : accounts.get<by_id>() )
+   {
+      BOOST_CHECK( count == 0 || last < acct.get_id() );
+      last = acct.get_id();
+      ++count;
+   }
+   BOOST_CHECK_EQUAL( count, accounts.size() );
+   BOOST_CHECK( last == bob_id );
+
+   // lookups by ID work like those of a generic_index
+   const auto& by_id_idx = accounts.get<by_id>();
+   BOOST_REQUIRE( by_id_idx.find( alice_id ) != by_id_idx.end() );
+   BOOST_CHECK( by_id_idx.find( alice_id )->get_id() == alice_id );
+   BOOST_CHECK( by_id_idx.find( account_id_type( bob_id.instance.value + 1 ) ) == by_id_idx.end() );
+   BOOST_CHECK( by_id_idx.lower_bound( alice_id )->get_id() == alice_id );
+   BOOST_CHECK( by_id_idx.upper_bound( alice_id )->get_id() == bob_id );
+   BOOST_CHECK( by_id_idx.upper_bound( bob_id ) == by_id_idx.end() );
+   BOOST_CHECK_EQUAL( by_id_idx.count( bob_id ), 1u );
+
+   // modifications re-sort the views
+   db.modify( alice_id(db), []( account_object& acct ) { acct.name = "zalice"; } );
+   BOOST_CHECK( by_name_idx.find( "alice" ) == by_name_idx.end() );
+   BOOST_CHECK( by_name_idx.find( "zalice" )->get_id() == alice_id );
+   BOOST_CHECK( by_name_idx.rbegin()->get_id() == alice_id );
+
+   // removed and re-inserted by undo
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.remove( bob_id(db) );
+      BOOST_CHECK( db.find( bob_id ) == nullptr );
+      BOOST_CHECK( by_name_idx.find( "bob" ) == by_name_idx.end() );
+      BOOST_CHECK_EQUAL( by_name_idx.size(), accounts.size() );
+   }
+   BOOST_REQUIRE( db.find( bob_id ) != nullptr );
+   BOOST_CHECK( by_name_idx.find( "bob" )->get_id() == bob_id );
+
+   // duplicate keys are rejected
+   account_object dup;
+   dup.id = db.get_index_type<account_index>().get_next_id();
+   dup.name = "bob";
+   BOOST_CHECK_THROW( db.insert( std::move(dup) ), fc::exception );
+   BOOST_CHECK( db.find_object( db.get_index_type<account_index>().get_next_id() ) == nullptr );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( direct_index_test )
 { try {
    try {
@@ -223,6 +322,113 @@ BOOST_AUTO_TEST_CASE( direct_index_test )
    // but the secondary has not updated its representation
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( incremental_flush_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path asset_file = data_dir.path() / "object_database"
+                               / fc::to_string( asset_object::space_id ) / fc::to_string( asset_object::type_id );
+   {
+      database db1;
+      db1.initialize_indexes();
+      graphene::db::object_database& odb = db1;
+      odb.open( data_dir.path() );
+      const auto& accounts = db1.get_index( account_object::space_id, account_object::type_id );
+      const auto& assets = db1.get_index( asset_object::space_id, asset_object::type_id );
+      BOOST_CHECK( accounts.is_dirty() );
+      BOOST_CHECK( assets.is_dirty() );
+
+      const auto& acct = db1.create<account_object>( []( account_object& a ) { a.name = "alice"; } );
+      db1.create<asset_object>( []( asset_object& a ) { a.symbol = "ABC"; } );
+      odb.flush();
+      BOOST_CHECK( !accounts.is_dirty() );
+      BOOST_CHECK( !assets.is_dirty() );
+      BOOST_REQUIRE( fc::exists( asset_file ) );
+      const auto asset_file_size = fc::file_size( asset_file );
+
+      db1.modify( acct, []( account_object& a ) { a.name = "bob"; } );
+      BOOST_CHECK( accounts.is_dirty() );
+      BOOST_CHECK( !assets.is_dirty() );
+      odb.flush();
+      BOOST_CHECK( !accounts.is_dirty() );
+      BOOST_CHECK_EQUAL( asset_file_size, fc::file_size( asset_file ) );
+
+      // changes that have been rolled back still require the index to be saved
+      {
+         auto session = db1._undo_db.start_undo_session();
+         db1.create<asset_object>( []( asset_object& a ) { a.symbol = "XYZ"; } );
+         session.undo();
+      }
+      BOOST_CHECK( assets.is_dirty() );
+      odb.flush();
+   }
+
+   database db2;
+   db2.initialize_indexes();
+   static_cast<graphene::db::object_database&>( db2 ).open( data_dir.path() );
+   BOOST_CHECK( !db2.get_index( account_object::space_id, account_object::type_id ).is_dirty() );
+   BOOST_CHECK_EQUAL( "bob", account_id_type()( db2 ).name );
+   BOOST_CHECK_EQUAL( "ABC", asset_id_type()( db2 ).symbol );
+   BOOST_CHECK( db2.find( asset_id_type(1) ) == nullptr );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( chunked_index_open_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path file = data_dir.path() / "balances";
+   const uint32_t count = graphene::db::detail::records_per_open_job * 2 + 7;
+
+   primary_index< account_balance_index > balances( db );
+   account_balance_object bal;
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      bal.id = account_balance_id_type( i );
+      bal.owner = account_id_type( i );
+      bal.balance = i;
+      balances.load( fc::raw::pack( bal ) );
+   }
+   balances.save( file );
+
+   primary_index< account_balance_index > reloaded( db );
+   auto jobs = reloaded.prepare_open( file );
+   BOOST_REQUIRE_EQUAL( jobs.size(), 3u );
+   // decoding jobs are independent of each other
+   for( auto itr = jobs.rbegin(); itr != jobs.rend(); ++itr )
+      (*itr)();
+   for( size_t job = 0; job < jobs.size(); ++job )
+      reloaded.insert_decoded( job );
+   reloaded.finish_open();
+   BOOST_CHECK( !reloaded.is_dirty() );
+   BOOST_REQUIRE_EQUAL( reloaded.indices().size(), count );
+   for( uint32_t i = 0; i < count; i += 997 )
+   {
+      const auto* obj = dynamic_cast<const account_balance_object*>(
+                              reloaded.find( account_balance_id_type( i ) ) );
+      BOOST_REQUIRE( obj != nullptr );
+      BOOST_CHECK( obj->owner == account_id_type( i ) );
+      BOOST_CHECK_EQUAL( obj->balance.value, int64_t( i ) );
+   }
+
+   // files without a record offset table are still readable
+   const fc::path legacy_file = data_dir.path() / "legacy";
+   {
+      std::ofstream out( legacy_file.generic_string(),
+                         std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      fc::raw::pack( out, object_id_type( account_balance_id_type( 3 ) ) );
+      fc::raw::pack( out, balances.get_object_version() );
+      for( uint32_t i = 0; i < 3; ++i )
+      {
+         bal.id = account_balance_id_type( i );
+         bal.owner = account_id_type( i );
+         fc::raw::pack( out, fc::raw::pack( bal ) );
+      }
+   }
+   primary_index< account_balance_index > legacy( db );
+   BOOST_CHECK_EQUAL( legacy.prepare_open( legacy_file ).size(), 1u );
+   legacy.open( legacy_file );
+   BOOST_CHECK_EQUAL( legacy.indices().size(), 3u );
+   BOOST_CHECK( legacy.get_next_id() == object_id_type( account_balance_id_type( 3 ) ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/bitshares/bitshares-core/issues/1719
 { try {
    ACTORS( (alice)(bob)(charlie)(agnetha)(benny)(carlos) );
@@ -1890,4 +1890,176 @@ BOOST_AUTO_TEST_CASE(target_cr_test_call_limit_after_hf1270)
 } FC_LOG_AND_RETHROW() }
 
 
+/***
+ * The order books used for matching list the orders of each market side in the order of the by_price index
+ */
+BOOST_AUTO_TEST_CASE(limit_order_book_index_test)
+{ try {
+   ACTORS((buyer)(seller));
+
+   const asset_id_type core_id;
+   const asset_id_type abc_id = create_user_issued_asset( "ABC" ).get_id();
+   const asset_id_type xyz_id = create_user_issued_asset( "XYZ" ).get_id();
+   issue_uia( buyer, asset( 1000000, abc_id ) );
+   issue_uia( buyer, asset( 1000000, xyz_id ) );
+   transfer( committee_account, seller_id, asset( 1000000 ) );
+
+   const auto& books = db.get_index_type< primary_index< limit_order_index > >()
+                         .get_secondary_index<limit_order_book_index>();
+   const auto& by_price_idx = db.get_index_type<limit_order_index>().indices().get<by_price>();
+   auto check_books = [&]() {
+      size_t total = 0;
+      for( const auto& side : { std::make_pair( core_id, abc_id ), std::make_pair( abc_id, core_id ),
+                                std::make_pair( core_id, xyz_id ), std::make_pair( xyz_id, core_id ),
+                                std::make_pair( abc_id, xyz_id ) } )
+      {
+         vector<limit_order_id_type> expected;
+         auto end = by_price_idx.upper_bound( price::min( side.first, side.second ) );
+         for( auto itr = by_price_idx.lower_bound( price::max( side.first, side.second ) ); itr != end; ++itr )
+            expected.push_back( itr->get_id() );
+         vector<limit_order_id_type> actual;
+         for( auto itr = books.begin( side.first, side.second ); itr != books.end( side.first, side.second ); ++itr )
+            actual.push_back( itr->get_id() );
+         BOOST_CHECK( actual == expected );
+         total += actual.size();
+      }
+      BOOST_CHECK_EQUAL( total, db.get_index_type<limit_order_index>().indices().size() );
+   };
+
+   // orders at equivalent prices share a level and stay in the order of their creation
+   create_sell_order( seller, asset( 100 ), asset( 200, abc_id ) );
+   create_sell_order( seller, asset( 100 ), asset( 300, abc_id ) );
+   const limit_order_id_type to_cancel = create_sell_order( seller, asset( 200 ), asset( 400, abc_id ) )->get_id();
+   create_sell_order( seller, asset( 100 ), asset( 200, abc_id ) );
+   create_sell_order( seller, asset( 100 ), asset( 150, xyz_id ) );
+   create_sell_order( buyer, asset( 100, abc_id ), asset( 100 ) );
+   create_sell_order( buyer, asset( 150, abc_id ), asset( 100 ) );
+   create_sell_order( buyer, asset( 100, abc_id ), asset( 100 ) );
+   create_sell_order( buyer, asset( 100, xyz_id ), asset( 100 ) );
+   create_sell_order( buyer, asset( 100, abc_id ), asset( 100, xyz_id ) );
+   check_books();
+
+   auto best = books.begin( core_id, abc_id );
+   BOOST_CHECK( best->sell_price == price( asset( 100 ), asset( 200, abc_id ) ) );
+   BOOST_CHECK( std::next( best )->get_id() == to_cancel );
+   BOOST_CHECK( books.lower_bound( price( asset( 1 ), asset( 2, abc_id ) ) ) == best );
+   BOOST_CHECK( books.upper_bound( price( asset( 1 ), asset( 2, abc_id ) ) )->sell_price
+                == price( asset( 100 ), asset( 300, abc_id ) ) );
+   BOOST_CHECK( books.begin( xyz_id, abc_id ) == books.end( xyz_id, abc_id ) );
+
+   generate_block();
+
+   // removing an order keeps the others in place
+   cancel_limit_order( to_cancel( db ) );
+   check_books();
+
+   // a crossing order fills the orders of the best level, the oldest first, and rests with the remainder
+   const limit_order_id_type first = books.begin( core_id, abc_id )->get_id();
+   create_sell_order( buyer, asset( 500, abc_id ), asset( 200 ) );
+   check_books();
+   BOOST_CHECK( !db.find( first ) );
+   BOOST_CHECK( books.begin( core_id, abc_id )->sell_price == price( asset( 100 ), asset( 300, abc_id ) ) );
+
+   generate_block();
+   check_books();
+
+   // undo restores the books
+   db.pop_block();
+   check_books();
+   db.pop_block();
+   check_books();
+} FC_LOG_AND_RETHROW() }
+
+
+/***
+ * Checks of the call orders are skipped while the market is unchanged, and a change of the best orders or of the
+ * feed wakes the market up
+ */
+BOOST_AUTO_TEST_CASE(margin_call_watcher_test)
+{ try {
+   auto mi = db.get_global_properties().parameters.maintenance_interval;
+   generate_blocks(HARDFORK_CORE_1270_TIME - mi);
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   generate_block();
+
+   set_expiration( db, trx );
+
+   ACTORS((seller)(borrower)(borrower2)(feedproducer));
+
+   const auto& bitusd = create_bitasset("USDBIT", feedproducer_id);
+   const auto& core   = asset_id_type()(db);
+
+   int64_t init_balance(1000000);
+
+   transfer(committee_account, seller_id, asset(init_balance));
+   transfer(committee_account, borrower_id, asset(init_balance));
+   transfer(committee_account, borrower2_id, asset(init_balance));
+   update_feed_producers(bitusd, {feedproducer.get_id()});
+
+   price_feed current_feed;
+   current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+   current_feed.maintenance_collateral_ratio = 1750;
+   current_feed.maximum_short_squeeze_ratio  = 1100;
+   publish_feed( bitusd, feedproducer, current_feed );
+
+   const call_order_object& b1 = *borrow( borrower, bitusd.amount(1000), asset(1800));
+   auto b1_id = b1.get_id();
+   const call_order_object& b2 = *borrow( borrower2, bitusd.amount(1000), asset(2000) );
+   auto b2_id = b2.get_id();
+   transfer( borrower2, seller, bitusd.amount(1000) );
+
+   // checks the market, which has no position to call
+   auto check = [this,&bitusd]( bool avoided ) {
+      const margin_call_stats before = db.get_margin_call_stats();
+      BOOST_CHECK( !db.check_call_orders( bitusd ) );
+      const margin_call_stats after = db.get_margin_call_stats();
+      BOOST_CHECK_EQUAL( after.checks, before.checks + 1 );
+      BOOST_CHECK_EQUAL( after.avoided_scans, before.avoided_scans + ( avoided ? 1 : 0 ) );
+      BOOST_CHECK_GE( after.quiet_markets, 1u );
+   };
+   // the check after the first borrow found nothing to do, the second position is behind the first one
+   check( true );
+
+   // a new best order wakes the market up, even if it does not cross, an order behind it does not
+   auto wakeups = db.get_margin_call_stats().wakeups;
+   BOOST_REQUIRE( create_sell_order( borrower, bitusd.amount(100), core.amount(1500) ) );
+   BOOST_CHECK_EQUAL( db.get_margin_call_stats().wakeups, wakeups + 1 );
+   check( false );
+   check( true );
+   BOOST_REQUIRE( create_sell_order( borrower, bitusd.amount(100), core.amount(1600) ) );
+   check( true );
+
+   // an order at the maximum short squeeze price does not call the positions above the maintenance collateral ratio
+   const limit_order_object* crossing = create_sell_order( seller, bitusd.amount(1000), core.amount(1100) );
+   BOOST_REQUIRE( crossing );
+   limit_order_id_type crossing_id = crossing->get_id();
+   check( false );
+   check( true );
+
+   // publishing the same feed again does not change the median
+   wakeups = db.get_margin_call_stats().wakeups;
+   publish_feed( bitusd, feedproducer, current_feed );
+   BOOST_CHECK_EQUAL( db.get_margin_call_stats().wakeups, wakeups );
+   check( true );
+
+   // moving b1 to margin call territory wakes the market up, and the check of the new feed calls b1
+   current_feed.maintenance_collateral_ratio = 2000;
+   publish_feed( bitusd, feedproducer, current_feed );
+   BOOST_CHECK_GT( db.get_margin_call_stats().wakeups, wakeups );
+
+   BOOST_CHECK( !db.find( b1_id ) );
+   BOOST_CHECK( !db.find( crossing_id ) );
+   BOOST_CHECK( db.find( b2_id ) );
+
+   // b2 is in margin call territory too, but no order crosses it
+   check( false );
+   check( true );
+   BOOST_CHECK( db.find( b2_id ) );
+
+   // the verdicts may depend on changes that are undone, so undoing forgets them
+   db.pop_block();
+   BOOST_CHECK_EQUAL( db.get_margin_call_stats().quiet_markets, 0u );
+} FC_LOG_AND_RETHROW() }
+
+
 BOOST_AUTO_TEST_SUITE_END()
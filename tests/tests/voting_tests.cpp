@@ -27,7 +27,9 @@
 #include <graphene/app/database_api.hpp>
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/witness_object.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 #include "../common/database_fixture.hpp"
@@ -578,4 +580,49 @@ BOOST_AUTO_TEST_CASE(last_voting_date_proxy)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(parallel_vote_tally)
+{
+   try
+   {
+      // enough voters to be tallied in several chunks
+      const uint32_t voter_count = 1024;
+      const auto& witnesses = db.get_index_type<witness_index>().indices();
+      vector<vote_id_type> witness_votes;
+      for( const witness_object& wit : witnesses )
+         witness_votes.push_back( wit.vote_id );
+
+      for( uint32_t i = 0; i < voter_count; ++i )
+      {
+         const account_object& voter = create_account( "voter" + fc::to_string( i ) );
+         transfer( committee_account, voter.get_id(), asset( 100 + i ) );
+         db.modify( voter, [&witness_votes,i]( account_object& a ) {
+            a.options.votes.insert( witness_votes[ i % witness_votes.size() ] );
+            a.options.votes.insert( witness_votes[ ( i / 3 ) % witness_votes.size() ] );
+         });
+      }
+
+      auto total_votes = [&witnesses]() {
+         vector<uint64_t> votes;
+         for( const witness_object& wit : witnesses )
+            votes.push_back( wit.total_votes );
+         return votes;
+      };
+
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      const signed_block maintenance_block = *db.fetch_block_by_number( db.head_block_num() );
+      const vector<uint64_t> serial_votes = total_votes();
+      BOOST_CHECK( *std::max_element( serial_votes.begin(), serial_votes.end() ) > 0 );
+
+      // the parallel tally leads to the same votes
+      db.pop_block();
+      db.enable_parallel_vote_tally( true );
+      PUSH_BLOCK( db, maintenance_block, ~0 );
+      BOOST_CHECK( db.head_block_id() == maintenance_block.id() );
+      const vector<uint64_t> parallel_votes = total_votes();
+      BOOST_CHECK( parallel_votes == serial_votes );
+      BOOST_CHECK( db.get_global_properties().active_witnesses.size() > 0 );
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()